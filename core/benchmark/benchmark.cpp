@@ -0,0 +1,380 @@
+// Benchmark of the measurement core on synthetic first-hit-point images.
+//
+// usage: poitoolsbench [--output results.json] [--quick]
+//
+// Writes one JSON document with an entry per benchmark, surface and viewport
+// to stdout or the given file, so runs of different releases can be diffed.
+
+#include "distancematrix.h"
+#include "landmarks.h"
+#include "legacy.h"
+#include "measure.h"
+#include "planecontour.h"
+#include "pointexport.h"
+#include "polyline.h"
+#include "surfacenets.h"
+#include "synthetic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace poitools;
+
+namespace {
+
+struct Result {
+    std::string name;
+    std::string surface;
+    std::string engine;
+    int width;
+    int height;
+    size_t items;           ///< operations per iteration, e.g. number of picks
+    size_t iterations;
+    double meanNs;          ///< per iteration
+    double minNs;
+    double medianNs;
+};
+
+/// Distance engine to compare, see main() for the list.
+struct Engine {
+    std::string name;
+    std::function<float(const FhpBuffer&, const Mat4&, IVec2, IVec2)> distance;
+};
+
+volatile float sink = 0.0f;   ///< keeps the compiler from dropping the measured work
+
+/// Runs f repeatedly for at least minSeconds (and at least minIterations times).
+Result measure(const std::string& name, size_t items, const std::function<float()>& f, double minSeconds, size_t minIterations) {
+    typedef std::chrono::steady_clock Clock;
+    std::vector<double> times;
+
+    sink = sink + f(); // warm up caches
+    Clock::time_point begin = Clock::now();
+    while (times.size() < minIterations || std::chrono::duration<double>(Clock::now() - begin).count() < minSeconds) {
+        Clock::time_point start = Clock::now();
+        sink = sink + f();
+        times.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+
+    Result result;
+    result.name = name;
+    result.width = 0;
+    result.height = 0;
+    result.items = items;
+    result.iterations = times.size();
+    double sum = 0.0;
+    for (size_t i = 0; i < times.size(); ++i)
+        sum += times[i];
+    result.meanNs = sum / times.size();
+    std::sort(times.begin(), times.end());
+    result.minNs = times.front();
+    result.medianNs = times[times.size() / 2];
+    return result;
+}
+
+/// Deterministic pixel positions on the viewport.
+std::vector<IVec2> randomPixels(int width, int height, size_t count) {
+    std::vector<IVec2> pixels;
+    pixels.reserve(count);
+    unsigned int seed = 42u;
+    for (size_t i = 0; i < count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        int x = static_cast<int>((seed >> 8) % static_cast<unsigned int>(width));
+        seed = seed * 1664525u + 1013904223u;
+        int y = static_cast<int>((seed >> 8) % static_cast<unsigned int>(height));
+        pixels.push_back(IVec2(x, y));
+    }
+    return pixels;
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results) {
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"surface\": \"" << r.surface << "\", \"engine\": \"" << r.engine
+            << "\", \"width\": " << r.width << ", \"height\": " << r.height
+            << ", \"items\": " << r.items << ", \"iterations\": " << r.iterations
+            << ", \"mean_ns\": " << r.meanNs << ", \"min_ns\": " << r.minNs << ", \"median_ns\": " << r.medianNs
+            << ", \"ns_per_item\": " << r.medianNs / std::max<size_t>(r.items, 1) << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string output;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--output results.json] [--quick]" << std::endl;
+            return 1;
+        }
+    }
+
+    const double minSeconds = quick ? 0.02 : 0.25;
+    const size_t minIterations = quick ? 3 : 10;
+    std::vector<IVec2> viewports;
+    viewports.push_back(IVec2(512, 512));
+    viewports.push_back(IVec2(1920, 1080));
+    if (!quick)
+        viewports.push_back(IVec2(3840, 2160));
+
+    const SyntheticFhp::Surface surfaces[] = { SyntheticFhp::PLANE, SyntheticFhp::SPHERE, SyntheticFhp::HEAD };
+    const Mat4 textureToWorld;
+    std::vector<Result> results;
+
+    // new implementations are added here and compared against the original dual axis integral
+    PathSampler nearest(false);
+    PathSampler bilinear(true);
+    std::vector<Vec3> legacyPath;
+    std::vector<Engine> engines;
+    Engine entry;
+    entry.name = "dual-axis";
+    entry.distance = [&legacyPath](const FhpBuffer& fhp, const Mat4& m, IVec2 a, IVec2 b) {
+        legacyPath.clear();
+        return legacySurfaceDistance(fhp, m, a, b, legacyPath);
+    };
+    engines.push_back(entry);
+    entry.name = "dda";
+    entry.distance = [&nearest](const FhpBuffer& fhp, const Mat4& m, IVec2 a, IVec2 b) { return nearest.measure(fhp, m, a, b); };
+    engines.push_back(entry);
+    entry.name = "dda-bilinear";
+    entry.distance = [&bilinear](const FhpBuffer& fhp, const Mat4& m, IVec2 a, IVec2 b) { return bilinear.measure(fhp, m, a, b); };
+    engines.push_back(entry);
+
+    for (size_t s = 0; s < 3; ++s) {
+        for (size_t v = 0; v < viewports.size(); ++v) {
+            const SyntheticFhp image(surfaces[s], viewports[v].x, viewports[v].y);
+            const FhpBuffer fhp = image.getBuffer();
+            const int w = image.getWidth();
+            const int h = image.getHeight();
+            std::vector<Result> local;
+
+            // single pixel picks, as done for every click
+            const std::vector<IVec2> picks = randomPixels(w, h, 1000);
+            local.push_back(measure("pick", picks.size(), [&]() {
+                float acc = 0.0f;
+                Vec3 world;
+                for (size_t i = 0; i < picks.size(); ++i)
+                    if (pickSurfacePoint(fhp, textureToWorld, picks[i], world))
+                        acc += world.x;
+                return acc;
+            }, minSeconds, minIterations));
+
+            // point set construction, as handed to the picked points geometry
+            const std::vector<IVec2> cloud = randomPixels(w, h, 10000);
+            local.push_back(measure("point_list", cloud.size(), [&]() {
+                return static_cast<float>(pickSurfacePoints(fhp, textureToWorld, cloud).size());
+            }, minSeconds, minIterations));
+
+            // short drags and segments across most of the object
+            const IVec2 center(w / 2, h / 2);
+            const IVec2 shortEnd(w / 2 + w / 20, h / 2 + h / 40);
+            const IVec2 longStart(w / 5, 3 * h / 10);
+            const IVec2 longEnd(4 * w / 5, 7 * h / 10);
+            for (size_t e = 0; e < engines.size(); ++e) {
+                const Engine& engine = engines[e];
+                Result r = measure("surface_distance_short", 1, [&]() {
+                    return engine.distance(fhp, textureToWorld, center, shortEnd);
+                }, minSeconds, minIterations);
+                r.engine = engine.name;
+                local.push_back(r);
+
+                r = measure("surface_distance_long", 1, [&]() {
+                    return engine.distance(fhp, textureToWorld, longStart, longEnd);
+                }, minSeconds, minIterations);
+                r.engine = engine.name;
+                local.push_back(r);
+            }
+
+            // drag along the major axis, one pixel per mouse event, as measured by the live preview
+            const int dragSteps = w / 4;
+            PathSampler preview;
+            local.push_back(measure("surface_distance_drag", dragSteps, [&]() {
+                float acc = 0.0f;
+                preview.invalidate();
+                for (int i = 1; i <= dragSteps; ++i)
+                    acc += preview.update(fhp, textureToWorld, longStart, IVec2(longStart.x + i, longStart.y + i / 8));
+                return acc;
+            }, minSeconds, minIterations));
+            local.back().engine = "dda-incremental";
+            local.push_back(measure("surface_distance_drag", dragSteps, [&]() {
+                float acc = 0.0f;
+                for (int i = 1; i <= dragSteps; ++i)
+                    acc += nearest.measure(fhp, textureToWorld, longStart, IVec2(longStart.x + i, longStart.y + i / 8));
+                return acc;
+            }, minSeconds, minIterations));
+            local.back().engine = "dda";
+
+            for (size_t i = 0; i < local.size(); ++i) {
+                local[i].surface = SyntheticFhp::getName(surfaces[s]);
+                local[i].width = w;
+                local[i].height = h;
+                results.push_back(local[i]);
+            }
+        }
+    }
+
+    // landmark templates do not depend on the surface
+    std::ostringstream templ;
+    const size_t numLandmarks = 10000;
+    for (size_t i = 0; i < numLandmarks; ++i)
+        templ << "landmark_" << i << "\n\n";
+    const std::string templText = templ.str();
+    Result parse = measure("landmark_parse", numLandmarks, [&]() {
+        std::istringstream in(templText);
+        return static_cast<float>(readLandmarkTemplate(in).size());
+    }, minSeconds, minIterations);
+    parse.surface = "none";
+    parse.width = 0;
+    parse.height = 0;
+    results.push_back(parse);
+
+    // euclidean landmark distance matrix, from scratch and after appending one landmark
+    ThreadPool pool;
+    std::vector<Vec3> landmarks;
+    for (size_t i = 0; i < 500; ++i)
+        landmarks.push_back(Vec3(std::sin(i * 0.37f), std::cos(i * 0.11f), i * 0.01f));
+    std::vector<Vec3> shorter(landmarks.begin(), landmarks.end() - 1);
+    DistanceMatrix matrix;
+    const char* matrixModes[] = { "full", "append" };
+    for (int mode = 0; mode < 2; ++mode) {
+        Result r = measure("distance_matrix", landmarks.size(), [&]() {
+            if (mode == 0)
+                matrix.clear();
+            else
+                matrix.update(shorter, euclideanRows(shorter), pool);
+            matrix.update(landmarks, euclideanRows(landmarks), pool);
+            return matrix.get(0, landmarks.size() - 1);
+        }, minSeconds, minIterations);
+        r.surface = "none";
+        r.engine = matrixModes[mode];
+        r.width = 0;
+        r.height = 0;
+        results.push_back(r);
+    }
+
+    // outline of a sphere in a slice through its center, the field is evaluated like a trilinear lookup
+    PlaneContour contour;
+    const int sliceSize = quick ? 256 : 1024;
+    PlaneContour::Grid grid;
+    grid.origin = Vec3(-1.0f, -1.0f, 0.0f);
+    grid.u = Vec3(2.0f / (sliceSize - 1), 0.0f, 0.0f);
+    grid.v = Vec3(0.0f, 2.0f / (sliceSize - 1), 0.0f);
+    grid.width = sliceSize;
+    grid.height = sliceSize;
+    const PlaneContour::RowSampler sphere = [&grid](int j, size_t, float* values) {
+        for (int i = 0; i < grid.width; ++i)
+            values[i] = 1.0f - length(grid.at(static_cast<float>(i), static_cast<float>(j)));
+    };
+    Result slice = measure("plane_contour", static_cast<size_t>(sliceSize) * sliceSize, [&]() {
+        contour.extract(grid, 0.25f, sphere, pool);
+        return contour.getContours().empty() ? 0.0f : contour.getContours()[0].length;
+    }, minSeconds, minIterations);
+    slice.surface = "sphere";
+    slice.engine = "marching-squares";
+    slice.width = sliceSize;
+    slice.height = sliceSize;
+    results.push_back(slice);
+
+    // transform and length kernel on a long path, for every instruction set the cpu supports
+    PointsSoA points, transformed;
+    const size_t numPoints = quick ? 100000 : 1000000;
+    unsigned int seed = 7u;
+    for (size_t i = 0; i < numPoints; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        points.push_back(Vec3(i * 1e-4f, static_cast<float>(seed >> 8) / 16777216.0f, 0.5f));
+    }
+    const SimdLevel supported = getSupportedSimdLevel();
+    for (int level = SIMD_SCALAR; level <= supported; ++level) {
+        setSimdLevel(static_cast<SimdLevel>(level));
+        Result r = measure("transform_polyline", numPoints, [&]() {
+            return transformPolyline(textureToWorld, points, &transformed);
+        }, minSeconds, minIterations);
+        r.surface = "none";
+        r.engine = getSimdLevelName(static_cast<SimdLevel>(level));
+        r.width = 0;
+        r.height = 0;
+        results.push_back(r);
+    }
+    setSimdLevel(supported);
+
+    // a long measured path streamed to disk in both export formats
+    std::vector<Vec3> exportPath(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        exportPath[i] = points[i];
+    const std::string exportFile = "poitoolsbench_export.tmp";
+    const char* exportFormats[] = { "csv", "binary" };
+    for (int format = 0; format < 2; ++format) {
+        Result r = measure("point_export", exportPath.size(), [&]() {
+            PointExporter exporter;
+            exporter.open(exportFile, format == 0 ? EXPORT_CSV : EXPORT_BINARY);
+            exporter.writePath("path", 1.0f, exportPath);
+            return exporter.close() ? 1.0f : 0.0f;
+        }, minSeconds, minIterations);
+        r.surface = "none";
+        r.engine = exportFormats[format];
+        r.width = 0;
+        r.height = 0;
+        results.push_back(r);
+    }
+    std::remove(exportFile.c_str());
+
+    // a sphere read brick by brick under a tight and a loose memory budget, and with the bricks it does not cross skipped
+    const int volumeSize = quick ? 128 : 384;
+    const IVec3 volumeDims(volumeSize, volumeSize, volumeSize);
+    const BrickReader sphereBricks = [volumeSize](const IVec3& offset, const IVec3& size, float* values) {
+        const float scale = 2.0f / (volumeSize - 1);
+        for (int z = 0; z < size.z; ++z)
+            for (int y = 0; y < size.y; ++y)
+                for (int x = 0; x < size.x; ++x)
+                    *values++ = 1.0f - length(Vec3((offset.x + x) * scale - 1.0f, (offset.y + y) * scale - 1.0f, (offset.z + z) * scale - 1.0f));
+        return true;
+    };
+    const char* extractionModes[] = { "budget-16MiB", "budget-256MiB", "summary" };
+    for (int mode = 0; mode < 3; ++mode) {
+        SurfaceNets::Settings settings;
+        settings.memoryBudget = size_t(mode == 0 ? 16 : 256) << 20;
+        const BrickLayout layout = SurfaceNets::getLayout(volumeDims, settings);
+        BrickSummary summary;
+        if (mode == 2)
+            SurfaceNets::summarize(layout, sphereBricks, summary);
+        SurfaceNets nets;
+        Result r = measure("surface_nets", static_cast<size_t>(volumeSize) * volumeSize * volumeSize, [&]() {
+            nets.extract(layout, sphereBricks, 0.5f, mode == 2 ? &summary : 0);
+            return static_cast<float>(nets.getPositions().size());
+        }, minSeconds, minIterations);
+        r.surface = "sphere";
+        r.engine = extractionModes[mode];
+        r.width = volumeSize;
+        r.height = volumeSize;
+        results.push_back(r);
+    }
+
+    if (output.empty()) {
+        writeJson(std::cout, results);
+    } else {
+        std::ofstream file(output.c_str());
+        if (!file) {
+            std::cerr << "cannot write " << output << std::endl;
+            return 1;
+        }
+        writeJson(file, results);
+    }
+    return 0;
+}
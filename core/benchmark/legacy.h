@@ -0,0 +1,53 @@
+#ifndef POITOOLS_BENCHMARK_LEGACY_H
+#define POITOOLS_BENCHMARK_LEGACY_H
+
+#include "types.h"
+
+#include <vector>
+
+namespace poitools {
+
+/**
+ * The original measureX()/measureY() line integral of SurfaceMeasure, kept as
+ * baseline for the benchmark. It walks the segment once along each screen
+ * axis, allocating a path per axis, and keeps the longer result.
+ */
+inline float legacyIntegrate(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 a, IVec2 b, bool alongX,
+                             std::vector<Vec3>& points)
+{
+    const int u = alongX ? 0 : 1;
+    const int v = alongX ? 1 : 0;
+    IVec2 start = a[u] > b[u] ? b : a;
+    IVec2 end = a[u] > b[u] ? a : b;
+
+    float m = (static_cast<float>(end[v]) - static_cast<float>(start[v])) / (static_cast<float>(end[u]) - static_cast<float>(start[u]));
+    float c = start[v] - m * start[u];
+
+    float dist = 0.0f;
+    for (float i = static_cast<float>(start[u] + 1); i < end[u]; ++i) {
+        IVec2 p0, p1;
+        p0[u] = static_cast<int>(i);
+        p0[v] = static_cast<int>(m * i + c);
+        p1[u] = static_cast<int>(i + 1);
+        p1[v] = static_cast<int>(m * (i + 1) + c);
+        Vec3 w0 = textureToWorld.transform(fhp.at(p0));
+        Vec3 w1 = textureToWorld.transform(fhp.at(p1));
+        points.push_back(w0);
+        dist += distance(w0, w1);
+    }
+    return dist;
+}
+
+inline float legacySurfaceDistance(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 start, IVec2 end,
+                                   std::vector<Vec3>& path)
+{
+    std::vector<Vec3> pathX, pathY;
+    float xval = legacyIntegrate(fhp, textureToWorld, start, end, true, pathX);
+    float yval = legacyIntegrate(fhp, textureToWorld, start, end, false, pathY);
+    path.swap(xval >= yval ? pathX : pathY);
+    return xval >= yval ? xval : yval;
+}
+
+} // namespace poitools
+
+#endif // POITOOLS_BENCHMARK_LEGACY_H
@@ -0,0 +1,59 @@
+#include "synthetic.h"
+
+#include <cmath>
+
+namespace poitools {
+
+SyntheticFhp::SyntheticFhp(Surface surface, int width, int height)
+    : width_(width)
+    , height_(height)
+    , pixels_(static_cast<size_t>(width) * height * 4, 0.0f)
+{
+    unsigned int seed = 12345u;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float u = (x + 0.5f) / width;
+            float v = (y + 0.5f) / height;
+            float depth = -1.0f;
+
+            if (surface == PLANE) {
+                depth = 0.3f + 0.2f * u + 0.1f * v;
+            } else if (surface == SPHERE) {
+                float du = u - 0.5f;
+                float dv = v - 0.5f;
+                float r2 = 0.16f - du * du - dv * dv;
+                if (r2 >= 0.0f)
+                    depth = 0.5f - std::sqrt(r2);
+            } else {
+                // ellipsoid with low frequency bumps (nose, brows) and scanner noise
+                float du = (u - 0.5f) / 0.35f;
+                float dv = (v - 0.5f) / 0.45f;
+                float r2 = 1.0f - du * du - dv * dv;
+                if (r2 >= 0.0f) {
+                    seed = seed * 1664525u + 1013904223u;
+                    float noise = (static_cast<float>(seed >> 8) / 16777216.0f - 0.5f) * 0.002f;
+                    float bumps = 0.02f * std::sin(12.0f * u) * std::cos(9.0f * v);
+                    depth = 0.5f - 0.3f * std::sqrt(r2) + bumps + noise;
+                }
+            }
+
+            if (depth >= 0.0f) {
+                float* p = &pixels_[4 * (static_cast<size_t>(y) * width + x)];
+                p[0] = u;
+                p[1] = v;
+                p[2] = depth;
+                p[3] = 1.0f;
+            }
+        }
+    }
+}
+
+std::string SyntheticFhp::getName(Surface surface) {
+    switch (surface) {
+    case PLANE:  return "plane";
+    case SPHERE: return "sphere";
+    default:     return "head";
+    }
+}
+
+} // namespace poitools
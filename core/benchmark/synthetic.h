@@ -0,0 +1,43 @@
+#ifndef POITOOLS_BENCHMARK_SYNTHETIC_H
+#define POITOOLS_BENCHMARK_SYNTHETIC_H
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+
+namespace poitools {
+
+/**
+ * Synthetic first-hit-point images for the benchmark.
+ *
+ * The surfaces are seen by an orthographic camera looking along +z onto the
+ * unit cube, so pixel (x, y) covers texture coordinates ((x + 0.5) / width,
+ * (y + 0.5) / height) and the first-hit-point holds the depth of the front
+ * most surface there.
+ */
+class SyntheticFhp {
+public:
+    enum Surface {
+        PLANE,      ///< tilted plane covering the whole viewport
+        SPHERE,     ///< sphere with background around it
+        HEAD        ///< bumpy ellipsoid with per-pixel noise
+    };
+
+    SyntheticFhp(Surface surface, int width, int height);
+
+    static std::string getName(Surface surface);
+
+    FhpBuffer getBuffer() const { return FhpBuffer(pixels_.data(), width_, height_); }
+    int getWidth() const  { return width_; }
+    int getHeight() const { return height_; }
+
+private:
+    int width_;
+    int height_;
+    std::vector<float> pixels_;
+};
+
+} // namespace poitools
+
+#endif // POITOOLS_BENCHMARK_SYNTHETIC_H
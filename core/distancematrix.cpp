@@ -0,0 +1,78 @@
+#include "distancematrix.h"
+
+namespace poitools {
+
+DistanceMatrix::DistanceMatrix()
+    : numComputed_(0)
+{
+}
+
+void DistanceMatrix::clear() {
+    points_.clear();
+    values_.clear();
+    numComputed_ = 0;
+}
+
+bool DistanceMatrix::update(const std::vector<Vec3>& points, const RowFunction& row, ThreadPool& pool,
+                            const std::function<bool()>& cancelled)
+{
+    const size_t n = points.size();
+    size_t keep = 0;
+    while (keep < n && keep < points_.size() && points[keep] == points_[keep])
+        ++keep;
+    numComputed_ = 0;
+
+    // new rows are computed into a buffer of their own, the threads never write to shared rows
+    std::vector<float> rows((n - keep) * n);
+    std::vector<char> done(n - keep, 0);
+    pool.parallelFor(n - keep, [&](size_t item, size_t thread) {
+        if (cancelled && cancelled())
+            return;
+        row(keep + item, thread, &rows[item * n]);
+        done[item] = 1;
+    });
+
+    // the kept block is moved to the new row length
+    const size_t oldSize = points_.size();
+    std::vector<float> values(n * n);
+    for (size_t i = 0; i < keep; ++i)
+        for (size_t j = 0; j < keep; ++j)
+            values[i * n + j] = values_[i * oldSize + j];
+
+    // a row function may have been interrupted by the cancellation as well
+    const bool interrupted = cancelled && cancelled();
+    for (size_t i = 0; i < n - keep; ++i) {
+        if (!done[i] || interrupted) {
+            // only the unchanged points remain valid
+            points_.assign(points.begin(), points.begin() + keep);
+            values_.resize(keep * keep);
+            for (size_t r = 0; r < keep; ++r)
+                for (size_t c = 0; c < keep; ++c)
+                    values_[r * keep + c] = values[r * n + c];
+            return false;
+        }
+    }
+
+    // row i also provides column i; for pairs of new points the later row wins, so the matrix stays symmetric
+    for (size_t i = keep; i < n; ++i) {
+        const float* r = &rows[(i - keep) * n];
+        for (size_t j = 0; j <= i; ++j) {
+            values[i * n + j] = r[j];
+            values[j * n + i] = r[j];
+        }
+    }
+
+    points_ = points;
+    values_.swap(values);
+    numComputed_ = n - keep;
+    return true;
+}
+
+DistanceMatrix::RowFunction euclideanRows(const std::vector<Vec3>& points) {
+    return [&points](size_t source, size_t, float* row) {
+        for (size_t j = 0; j < points.size(); ++j)
+            row[j] = distance(points[source], points[j]);
+    };
+}
+
+} // namespace poitools
@@ -0,0 +1,59 @@
+#ifndef POITOOLS_CORE_DISTANCEMATRIX_H
+#define POITOOLS_CORE_DISTANCEMATRIX_H
+
+#include "threadpool.h"
+#include "types.h"
+
+#include <functional>
+#include <vector>
+
+namespace poitools {
+
+/**
+ * Symmetric matrix of the pairwise distances between landmarks.
+ *
+ * update() compares the points with the ones of the previous call and only
+ * computes the rows (and by symmetry the columns) of the points that are new,
+ * i.e. from the first point that differs on. Appending a landmark thus costs
+ * one row, removing the last one nothing. The rows are computed in parallel.
+ */
+class DistanceMatrix {
+public:
+    /**
+     * Computes the distances from points[source] to all points into row, which
+     * has points.size() entries. thread identifies the thread of the pool, e.g.
+     * to select scratch buffers.
+     */
+    typedef std::function<void(size_t source, size_t thread, float* row)> RowFunction;
+
+    DistanceMatrix();
+
+    /**
+     * Brings the matrix up to date with points.
+     *
+     * @param cancelled polled between rows, if it returns true the matrix only keeps the rows that were valid before
+     * @return false if it has been cancelled
+     */
+    bool update(const std::vector<Vec3>& points, const RowFunction& row, ThreadPool& pool,
+                const std::function<bool()>& cancelled = std::function<bool()>());
+
+    size_t getSize() const { return points_.size(); }
+    float get(size_t i, size_t j) const { return values_[i * points_.size() + j]; }
+
+    /// Number of rows computed by the last update().
+    size_t getNumComputed() const { return numComputed_; }
+
+    void clear();
+
+private:
+    std::vector<Vec3> points_;      ///< the matrix is valid for
+    std::vector<float> values_;     ///< row-major
+    size_t numComputed_;
+};
+
+/// RowFunction of the euclidean distance.
+DistanceMatrix::RowFunction euclideanRows(const std::vector<Vec3>& points);
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_DISTANCEMATRIX_H
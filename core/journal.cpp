@@ -0,0 +1,291 @@
+#include "journal.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace poitools {
+
+namespace {
+
+const char MAGIC[4] = { 'P', 'O', 'I', 'J' };
+const unsigned int VERSION = 1;
+const size_t HEADER_SIZE = 8;
+
+struct CrcTable {
+    CrcTable() {
+        for (unsigned int i = 0; i < 256; ++i) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+    unsigned int entries[256];
+};
+
+/// CRC-32 (IEEE), as used by zip and png.
+unsigned int crc32(const unsigned char* data, size_t size) {
+    static const CrcTable table;   // initialized once, also with several journals
+    unsigned int crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i)
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void appendWord(std::vector<unsigned char>& out, const void* word) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(word);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+unsigned int readWord(const unsigned char* bytes) {
+    unsigned int word;
+    std::memcpy(&word, bytes, 4);
+    return word;
+}
+
+bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0)
+        return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool truncateFile(std::FILE* file, long long length) {
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), length) == 0;
+#else
+    return ftruncate(fileno(file), static_cast<off_t>(length)) == 0;
+#endif
+}
+
+} // namespace
+
+bool readJournal(const std::string& path, std::vector<JournalRecord>& records, long long* validLength) {
+    records.clear();
+    if (validLength)
+        *validLength = 0;
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!file)
+        return true;
+    std::vector<unsigned char> data(static_cast<size_t>(file.tellg()));
+    if (data.empty())
+        return true;
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(&data[0]), data.size()))
+        return false;
+    if (data.size() < HEADER_SIZE || std::memcmp(&data[0], MAGIC, 4) != 0 || readWord(&data[4]) != VERSION)
+        return false;
+
+    size_t pos = HEADER_SIZE;
+    while (pos + 8 <= data.size()) {
+        const unsigned int type = readWord(&data[pos]);
+        const size_t count = readWord(&data[pos + 4]);
+        const size_t size = 8 + 4 * count;
+        if (count > (data.size() - pos) / 4 || pos + size + 4 > data.size())
+            break;
+        if (crc32(&data[pos], size) != readWord(&data[pos + size]))
+            break;
+
+        JournalRecord record;
+        record.type = type;
+        record.values.resize(count);
+        if (count > 0)
+            std::memcpy(&record.values[0], &data[pos + 8], 4 * count);
+        records.push_back(record);
+        pos += size + 4;
+    }
+    if (validLength)
+        *validLength = static_cast<long long>(pos);
+    return true;
+}
+
+std::vector<Vec3> replayPoints(const std::vector<JournalRecord>& records) {
+    std::vector<Vec3> points;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const JournalRecord& record = records[i];
+        switch (record.type) {
+        case POINT_ADD:
+            if (record.values.size() >= 3)
+                points.push_back(Vec3(record.values[0], record.values[1], record.values[2]));
+            break;
+        case POINT_UNDO:
+            if (!points.empty())
+                points.pop_back();
+            break;
+        case POINT_REMOVE:
+            if (!record.values.empty() && record.values[0] >= 0.0f && record.values[0] < static_cast<float>(points.size()))
+                points.erase(points.begin() + static_cast<size_t>(record.values[0]));
+            break;
+        case POINT_CLEAR:
+            points.clear();
+            break;
+        default:
+            break;
+        }
+    }
+    return points;
+}
+
+JournalRecord encodeMeasurement(float distance, const std::vector<float>& segmentLengths, const std::vector<Vec3>& path) {
+    JournalRecord record;
+    record.type = MEASURE_RESULT;
+    record.values.reserve(2 + segmentLengths.size() + 3 * path.size());
+    record.values.push_back(distance);
+    record.values.push_back(static_cast<float>(segmentLengths.size()));
+    record.values.insert(record.values.end(), segmentLengths.begin(), segmentLengths.end());
+    for (size_t i = 0; i < path.size(); ++i) {
+        record.values.push_back(path[i].x);
+        record.values.push_back(path[i].y);
+        record.values.push_back(path[i].z);
+    }
+    return record;
+}
+
+bool replayMeasurement(const std::vector<JournalRecord>& records, float& distance, std::vector<float>& segmentLengths, std::vector<Vec3>& path) {
+    // only the newest record matters
+    for (size_t i = records.size(); i-- > 0;) {
+        const JournalRecord& record = records[i];
+        if (record.type == MEASURE_CLEAR)
+            return false;
+        if (record.type != MEASURE_RESULT || record.values.size() < 2)
+            continue;
+
+        const std::vector<float>& values = record.values;
+        const size_t numSegments = static_cast<size_t>(values[1]);
+        if (values.size() < 2 + numSegments || (values.size() - 2 - numSegments) % 3 != 0)
+            continue;
+        distance = values[0];
+        segmentLengths.assign(values.begin() + 2, values.begin() + 2 + numSegments);
+        path.clear();
+        for (size_t v = 2 + numSegments; v < values.size(); v += 3)
+            path.push_back(Vec3(values[v], values[v + 1], values[v + 2]));
+        return true;
+    }
+    return false;
+}
+
+JournalWriter::JournalWriter()
+    : file_(0)
+    , appended_(0)
+    , synced_(0)
+    , failed_(false)
+    , quit_(false)
+{
+}
+
+JournalWriter::~JournalWriter() {
+    close();
+}
+
+bool JournalWriter::open(const std::string& path, long long validLength) {
+    close();
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file)
+        file = std::fopen(path.c_str(), "w+b");
+    if (!file)
+        return false;
+
+    // a torn record at the end would hide everything appended behind it
+    if (validLength < static_cast<long long>(HEADER_SIZE))
+        validLength = 0;
+    if (!truncateFile(file, validLength) || std::fseek(file, 0, SEEK_END) != 0) {
+        std::fclose(file);
+        return false;
+    }
+    if (validLength == 0) {
+        std::vector<unsigned char> header(MAGIC, MAGIC + 4);
+        appendWord(header, &VERSION);
+        if (std::fwrite(&header[0], 1, header.size(), file) != header.size() || !syncFile(file)) {
+            std::fclose(file);
+            return false;
+        }
+    }
+
+    file_ = file;
+    pending_.clear();
+    appended_ = 0;
+    synced_ = 0;
+    failed_ = false;
+    quit_ = false;
+    thread_ = std::thread(&JournalWriter::run, this);
+    return true;
+}
+
+bool JournalWriter::hasFailed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+void JournalWriter::append(const JournalRecord& record) {
+    if (!file_)
+        return;
+    std::vector<unsigned char> encoded;
+    encoded.reserve(12 + 4 * record.values.size());
+    const unsigned int count = static_cast<unsigned int>(record.values.size());
+    appendWord(encoded, &record.type);
+    appendWord(encoded, &count);
+    for (size_t i = 0; i < record.values.size(); ++i)
+        appendWord(encoded, &record.values[i]);
+    const unsigned int crc = crc32(&encoded[0], encoded.size());
+    appendWord(encoded, &crc);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.insert(pending_.end(), encoded.begin(), encoded.end());
+    appended_++;
+    wakeup_.notify_one();
+}
+
+void JournalWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const unsigned long long target = appended_;
+    written_.wait(lock, [this, target]() { return synced_ >= target || failed_ || !file_; });
+}
+
+void JournalWriter::close() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+        wakeup_.notify_one();
+    }
+    // the thread writes what is left before it quits
+    thread_.join();
+    std::fclose(file_);
+    file_ = 0;
+}
+
+void JournalWriter::run() {
+    std::vector<unsigned char> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wakeup_.wait(lock, [this]() { return quit_ || !pending_.empty(); });
+        if (pending_.empty() && quit_)
+            break;
+
+        // everything appended meanwhile goes into one write and one sync
+        batch.swap(pending_);
+        const unsigned long long count = appended_;
+        lock.unlock();
+        bool ok = std::fwrite(&batch[0], 1, batch.size(), file_) == batch.size() && syncFile(file_);
+        batch.clear();
+        lock.lock();
+
+        if (ok)
+            synced_ = count;
+        else
+            failed_ = true;
+        written_.notify_all();
+    }
+}
+
+} // namespace poitools
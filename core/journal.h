@@ -0,0 +1,109 @@
+#ifndef POITOOLS_CORE_JOURNAL_H
+#define POITOOLS_CORE_JOURNAL_H
+
+#include "types.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace poitools {
+
+/// Record types of the journals of the processors.
+enum JournalRecordType {
+    POINT_ADD = 1,          ///< x, y, z of the picked point
+    POINT_UNDO = 2,         ///< the last point has been removed
+    POINT_REMOVE = 3,       ///< index of the removed point
+    POINT_CLEAR = 4,        ///< all points have been removed
+    MEASURE_RESULT = 16,    ///< distance, number of segments n, n segment lengths, x, y, z of every path point
+    MEASURE_CLEAR = 17      ///< the measurement has been reset
+};
+
+struct JournalRecord {
+    JournalRecord() : type(0) {}
+    JournalRecord(unsigned int type, const std::vector<float>& values) : type(type), values(values) {}
+
+    unsigned int type;
+    std::vector<float> values;
+};
+
+/**
+ * Reads an append-only journal.
+ *
+ * The file starts with the magic "POIJ" and a format version, followed by the
+ * records: type, number of values, the values and a CRC-32 of all of them, as
+ * 32 bit words in native byte order. Reading stops at the first incomplete or
+ * corrupt record, i.e. at the tail of a write interrupted by a crash.
+ *
+ * @param validLength if not null, receives the length of the intact part of the file
+ * @return false if the file exists but is no journal, a missing file is an empty journal
+ */
+bool readJournal(const std::string& path, std::vector<JournalRecord>& records, long long* validLength = 0);
+
+/// Points picked in PointFitting after the POINT_* records.
+std::vector<Vec3> replayPoints(const std::vector<JournalRecord>& records);
+
+/// MEASURE_RESULT record of a measurement in SurfaceMeasure.
+JournalRecord encodeMeasurement(float distance, const std::vector<float>& segmentLengths, const std::vector<Vec3>& path);
+
+/**
+ * The last measurement in SurfaceMeasure after the MEASURE_* records.
+ *
+ * @return false if there is none, e.g. because it has been reset
+ */
+bool replayMeasurement(const std::vector<JournalRecord>& records, float& distance, std::vector<float>& segmentLengths, std::vector<Vec3>& path);
+
+/**
+ * Appends records to a journal without blocking the caller.
+ *
+ * append() only encodes the record into a buffer. A thread writes the
+ * buffer in batches and syncs the file to disk after every batch, so a crash
+ * loses at most the records of the batch being written.
+ */
+class JournalWriter {
+public:
+    JournalWriter();
+    ~JournalWriter();
+
+    /**
+     * Opens the journal at path for appending, it is created if it does not exist.
+     *
+     * @param validLength length of the intact part as returned by readJournal(), anything behind it is truncated
+     */
+    bool open(const std::string& path, long long validLength);
+
+    bool isOpen() const { return file_ != 0; }
+
+    /// True if a write or sync has failed since open().
+    bool hasFailed() const;
+
+    void append(const JournalRecord& record);
+
+    /// Blocks until all records appended so far are on disk.
+    void flush();
+
+    /// Flushes and closes the file.
+    void close();
+
+private:
+    void run();
+
+    std::FILE* file_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable written_;
+
+    std::vector<unsigned char> pending_;    ///< encoded records not handed to the thread yet
+    unsigned long long appended_;           ///< number of appended records
+    unsigned long long synced_;             ///< number of records on disk
+    bool failed_;
+    bool quit_;
+};
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_JOURNAL_H
@@ -0,0 +1,44 @@
+#include "landmarks.h"
+
+#include <fstream>
+#include <limits>
+
+namespace poitools {
+
+std::vector<std::string> readLandmarkTemplate(std::istream& in) {
+    std::vector<std::string> names;
+    std::string line;
+    while (std::getline(in, line)) {
+        // tolerate files written on windows
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        if (!line.empty())
+            names.push_back(line);
+    }
+    return names;
+}
+
+bool readLandmarkTemplate(const std::string& path, std::vector<std::string>& names) {
+    std::ifstream file(path.c_str());
+    if (!file)
+        return false;
+    names = readLandmarkTemplate(file);
+    return true;
+}
+
+void writeLandmarks(std::ostream& out, const std::vector<Vec3>& points) {
+    // enough digits to read back the same floats
+    out.precision(std::numeric_limits<float>::max_digits10);
+    for (size_t i = 0; i < points.size(); ++i)
+        out << points[i].x << " " << points[i].y << " " << points[i].z << "\n";
+}
+
+bool writeLandmarks(const std::string& path, const std::vector<Vec3>& points) {
+    std::ofstream file(path.c_str());
+    if (!file)
+        return false;
+    writeLandmarks(file, points);
+    return static_cast<bool>(file.flush());
+}
+
+} // namespace poitools
@@ -0,0 +1,37 @@
+#ifndef POITOOLS_CORE_LANDMARKS_H
+#define POITOOLS_CORE_LANDMARKS_H
+
+#include "types.h"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace poitools {
+
+/**
+ * Reads a landmark template (mandatory points file): one landmark name per
+ * line, empty lines are skipped.
+ */
+std::vector<std::string> readLandmarkTemplate(std::istream& in);
+
+/**
+ * Reads the landmark template stored at path.
+ *
+ * @return false if the file cannot be opened, names is left untouched then
+ */
+bool readLandmarkTemplate(const std::string& path, std::vector<std::string>& names);
+
+/**
+ * Writes picked points, one "x y z" line per point separated by spaces. The
+ * points of a template are written in its order, so line i is landmark i.
+ */
+void writeLandmarks(std::ostream& out, const std::vector<Vec3>& points);
+
+/// Writes the points to path, returns false if the file cannot be written.
+bool writeLandmarks(const std::string& path, const std::vector<Vec3>& points);
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_LANDMARKS_H
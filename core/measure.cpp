@@ -0,0 +1,45 @@
+#include "measure.h"
+
+namespace poitools {
+
+PathSampler::PathSampler(bool bilinear)
+    : hits_()
+    , world_()
+    , path_()
+    , bilinear_(bilinear)
+    , samples_()
+    , cachedStart_()
+    , cachedEnd_()
+    , cachedMatrix_()
+    , cachedBilinear_(bilinear)
+{
+}
+
+float PathSampler::measure(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 start, IVec2 end) {
+    return measure(start, end, textureToWorld, [&fhp](IVec2 p) { return fhp.at(p); });
+}
+
+float PathSampler::update(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 start, IVec2 end) {
+    return update(start, end, textureToWorld, [&fhp](IVec2 p) { return fhp.at(p); });
+}
+
+bool pickSurfacePoint(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 pos, Vec3& world) {
+    Vec3 hit = fhp.at(pos);
+    if (!isSurfaceHit(hit))
+        return false;
+    world = textureToWorld.transform(hit);
+    return true;
+}
+
+std::vector<Vec3> pickSurfacePoints(const FhpBuffer& fhp, const Mat4& textureToWorld, const std::vector<IVec2>& positions) {
+    std::vector<Vec3> points;
+    points.reserve(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        Vec3 world;
+        if (pickSurfacePoint(fhp, textureToWorld, positions[i], world))
+            points.push_back(world);
+    }
+    return points;
+}
+
+} // namespace poitools
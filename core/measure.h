@@ -0,0 +1,309 @@
+#ifndef POITOOLS_CORE_MEASURE_H
+#define POITOOLS_CORE_MEASURE_H
+
+#include "polyline.h"
+#include "types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace poitools {
+
+/// True if fhp is a first-hit-point on the surface, i.e. not the background.
+inline bool isSurfaceHit(const Vec3& fhp) {
+    return length(fhp) > 0.0f;
+}
+
+/**
+ * Integer DDA over the pixels of a screen space segment.
+ *
+ * The segment is walked along its major axis, one step per pixel including
+ * both end pixels; the minor coordinate is rounded by the midpoint rule.
+ */
+class SegmentWalker {
+public:
+    SegmentWalker(IVec2 start, IVec2 end);
+
+    int getNumSamples() const   { return steps_ + 1; }
+    int getMajorAxis() const    { return u_; }
+    IVec2 getPixel() const      { return p_; }
+
+    /// Exact (unrounded) minor coordinate of the current step.
+    float getMinor() const {
+        return steps_ > 0 ? start_[1 - u_] + stepV_ * static_cast<float>(i_) * deltaV_ / steps_ : static_cast<float>(p_[1 - u_]);
+    }
+
+    void next() {
+        p_[u_] += stepU_;
+        error_ += 2 * deltaV_;
+        if (error_ > steps_) {
+            p_[1 - u_] += stepV_;
+            error_ -= 2 * steps_;
+        }
+        ++i_;
+    }
+
+    /// Jumps to step i, as if next() had been called i times from the start.
+    void seek(int i) {
+        // the midpoint rule has stepped the minor axis k times, leaving error_ in (-steps_, steps_]
+        const int k = steps_ > 0 ? (2 * i * deltaV_ + steps_ - 1) / (2 * steps_) : 0;
+        p_ = start_;
+        p_[u_] += stepU_ * i;
+        p_[1 - u_] += stepV_ * k;
+        error_ = 2 * i * deltaV_ - 2 * steps_ * k;
+        i_ = i;
+    }
+
+    /**
+     * True if this and other visit the same pixels, with the same minor
+     * coordinates, at every step they both have, i.e. one segment is a
+     * prefix of the other.
+     */
+    bool sharesPrefix(const SegmentWalker& other) const {
+        if (start_ != other.start_)
+            return false;
+        if (steps_ == 0 || other.steps_ == 0)
+            return true;
+        return u_ == other.u_ && stepU_ == other.stepU_ && stepV_ == other.stepV_
+            && deltaV_ * other.steps_ == other.deltaV_ * steps_;
+    }
+
+private:
+    IVec2 start_;
+    IVec2 p_;
+    int u_;         ///< major axis
+    int steps_;
+    int stepU_;
+    int stepV_;
+    int deltaV_;
+    int error_;
+    int i_;
+};
+
+inline SegmentWalker::SegmentWalker(IVec2 start, IVec2 end)
+    : start_(start)
+    , p_(start)
+    , u_(std::abs(end.x - start.x) >= std::abs(end.y - start.y) ? 0 : 1)
+    , steps_(std::abs(end[u_] - start[u_]))
+    , stepU_(end[u_] >= start[u_] ? 1 : -1)
+    , stepV_(end[1 - u_] >= start[1 - u_] ? 1 : -1)
+    , deltaV_(std::abs(end[1 - u_] - start[1 - u_]))
+    , error_(0)
+    , i_(0)
+{
+}
+
+/**
+ * Samples the surface along the screen space segment between two pixels and
+ * measures the length of the resulting path, as done by SurfaceMeasure.
+ *
+ * The segment is walked once with a SegmentWalker, one first-hit-point per
+ * step. In bilinear mode the minor axis coordinate is not rounded, instead
+ * the two neighboring pixels are interpolated (falling back to the nearest
+ * one next to the background). Samples on the background are skipped, the
+ * path bridges them.
+ *
+ * measure() transforms the hits to world coordinates and measures them in one
+ * batch with the SIMD kernel of transformPolyline(). update() is meant for
+ * segments that follow the mouse: it keeps every sample with its surface point
+ * and running length, and only looks up and transforms the samples whose pixel
+ * differs from the previous call.
+ *
+ * The buffers are reused between measurements, so repeated measurements do
+ * not allocate once they have grown to the longest segment.
+ */
+class PathSampler {
+public:
+    explicit PathSampler(bool bilinear = false);
+
+    void setBilinear(bool bilinear) { bilinear_ = bilinear; }
+    bool isBilinear() const         { return bilinear_; }
+
+    /**
+     * Measures the surface distance between start and end.
+     *
+     * @param fhp callable returning the first-hit-point (texture coordinates) of a pixel as Vec3
+     * @return the path length in world units, the path is available from getPath()
+     */
+    template<typename FhpLookup>
+    float measure(IVec2 start, IVec2 end, const Mat4& textureToWorld, FhpLookup fhp);
+
+    /// measure() on a first-hit-point buffer.
+    float measure(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 start, IVec2 end);
+
+    /**
+     * Same result as measure(), but only the samples that moved to another pixel
+     * since the previous update() with the same start are looked up again, the
+     * unchanged leading part keeps its prefix length. If the end moved along the
+     * segment, the unchanged part is known from the DDA parameters and the update
+     * only costs the samples added, otherwise the samples are compared up to the
+     * first one that changed. In bilinear mode a sample is only reused if its exact
+     * position is unchanged, which mostly limits the reuse to moves along the
+     * segment. Call invalidate() when the first-hit-points change.
+     */
+    template<typename FhpLookup>
+    float update(IVec2 start, IVec2 end, const Mat4& textureToWorld, FhpLookup fhp);
+
+    /// update() on a first-hit-point buffer.
+    float update(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 start, IVec2 end);
+
+    /// Forgets the samples kept for update().
+    void invalidate() { samples_.clear(); }
+
+    /// World positions of the samples of the last measurement.
+    const std::vector<Vec3>& getPath() const { return path_; }
+
+private:
+    /// Sample kept by update().
+    struct Sample {
+        IVec2 pixel;
+        float minor;        ///< unrounded minor coordinate, only relevant in bilinear mode
+        int axis;           ///< major axis of the segment
+        bool hit;
+        Vec3 world;         ///< surface point if hit
+        int prevHit;        ///< index of the previous hit, -1 if none
+        float segment;      ///< distance to the previous hit
+        size_t numHits;     ///< number of surface hits up to and including this sample
+        float length;       ///< path length up to the last hit
+
+        bool matches(const SegmentWalker& walker, bool bilinear) const {
+            return pixel == walker.getPixel()
+                && (!bilinear || (axis == walker.getMajorAxis() && minor == walker.getMinor()));
+        }
+    };
+
+    template<typename FhpLookup>
+    Vec3 sample(FhpLookup& fhp, const SegmentWalker& walker) const;
+
+    PointsSoA hits_;            ///< first-hit-points of the last measure()
+    PointsSoA world_;           ///< hits_ in world coordinates
+    std::vector<Vec3> path_;
+    bool bilinear_;
+
+    std::vector<Sample> samples_;   ///< samples of the last update()
+    std::vector<char> changed_;     ///< samples looked up again by the last update(), from its first changed one on
+    IVec2 cachedStart_;
+    IVec2 cachedEnd_;
+    Mat4 cachedMatrix_;
+    bool cachedBilinear_;
+};
+
+template<typename FhpLookup>
+Vec3 PathSampler::sample(FhpLookup& fhp, const SegmentWalker& walker) const {
+    if (!bilinear_)
+        return fhp(walker.getPixel());
+
+    const int u = walker.getMajorAxis();
+    const float minor = walker.getMinor();
+    IVec2 p = walker.getPixel();
+    p[1 - u] = static_cast<int>(std::floor(minor));
+    float t = minor - std::floor(minor);
+    Vec3 a = fhp(p);
+    if (t <= 0.0f)
+        return a;
+
+    p[1 - u]++;
+    Vec3 b = fhp(p);
+    if (!isSurfaceHit(a) || !isSurfaceHit(b))
+        return t < 0.5f ? a : b;
+    return a + (b - a) * t;
+}
+
+template<typename FhpLookup>
+float PathSampler::measure(IVec2 start, IVec2 end, const Mat4& textureToWorld, FhpLookup fhp) {
+    invalidate();
+    hits_.clear();
+
+    SegmentWalker walker(start, end);
+    hits_.reserve(walker.getNumSamples());
+    for (int i = 0; i < walker.getNumSamples(); ++i, walker.next()) {
+        Vec3 hit = sample(fhp, walker);
+        if (isSurfaceHit(hit))
+            hits_.push_back(hit);
+    }
+
+    float dist = transformPolyline(textureToWorld, hits_, &world_);
+    path_.resize(world_.size());
+    for (size_t i = 0; i < path_.size(); ++i)
+        path_[i] = world_[i];
+    return dist;
+}
+
+template<typename FhpLookup>
+float PathSampler::update(IVec2 start, IVec2 end, const Mat4& textureToWorld, FhpLookup fhp) {
+    if (start != cachedStart_ || textureToWorld != cachedMatrix_ || bilinear_ != cachedBilinear_)
+        samples_.clear();
+    const IVec2 oldEnd = cachedEnd_;
+    cachedStart_ = start;
+    cachedEnd_ = end;
+    cachedMatrix_ = textureToWorld;
+    cachedBilinear_ = bilinear_;
+
+    // the leading samples that are unchanged keep their prefix length; if the end moved along the
+    // segment, these are all samples both segments have, without looking at them
+    SegmentWalker walker(start, end);
+    const int numSamples = walker.getNumSamples();
+    const int numOld = static_cast<int>(samples_.size());
+    int i = 0;
+    if (numOld > 0 && walker.sharesPrefix(SegmentWalker(start, oldEnd))) {
+        i = std::min(numOld, numSamples);
+        walker.seek(i);
+    }
+    else {
+        for (; i < numSamples && i < numOld; ++i, walker.next()) {
+            if (!samples_[i].matches(walker, bilinear_))
+                break;
+        }
+    }
+    const int firstChanged = i;
+    path_.resize(i > 0 ? samples_[i - 1].numHits : 0);
+    float dist = i > 0 ? samples_[i - 1].length : 0.0f;
+    int prevHit = i > 0 ? (samples_[i - 1].hit ? i - 1 : samples_[i - 1].prevHit) : -1;
+
+    // the rest of the path: samples on the same pixel as before reuse their first-hit-point, and
+    // their segment length as long as the previous hit has not changed either
+    changed_.resize(numSamples);
+    samples_.resize(numSamples);
+    for (; i < numSamples; ++i, walker.next()) {
+        Sample& s = samples_[i];
+        bool reuse = i < numOld && s.matches(walker, bilinear_);
+        if (!reuse) {
+            Vec3 hit = sample(fhp, walker);
+            s.pixel = walker.getPixel();
+            s.minor = walker.getMinor();
+            s.axis = walker.getMajorAxis();
+            s.hit = isSurfaceHit(hit);
+            if (s.hit)
+                s.world = textureToWorld.transform(hit);
+        }
+        changed_[i] = !reuse;
+        if (s.hit) {
+            if (!reuse || s.prevHit != prevHit || (prevHit >= firstChanged && changed_[prevHit]))
+                s.segment = prevHit >= 0 ? distance(samples_[prevHit].world, s.world) : 0.0f;
+            dist += s.segment;
+            path_.push_back(s.world);
+        }
+        s.prevHit = prevHit;
+        s.numHits = path_.size();
+        s.length = dist;
+        if (s.hit)
+            prevHit = i;
+    }
+    return dist;
+}
+
+/**
+ * Turns the first-hit-point at pos into a world position.
+ *
+ * @return false if pos shows the background
+ */
+bool pickSurfacePoint(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 pos, Vec3& world);
+
+/// pickSurfacePoint() for a list of pixels, background pixels are skipped.
+std::vector<Vec3> pickSurfacePoints(const FhpBuffer& fhp, const Mat4& textureToWorld, const std::vector<IVec2>& positions);
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_MEASURE_H
@@ -0,0 +1,184 @@
+#include "planecontour.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace poitools {
+
+namespace {
+
+// cell edges: 0 bottom (i,j)-(i+1,j), 1 right (i+1,j)-(i+1,j+1), 2 top (i,j+1)-(i+1,j+1), 3 left (i,j)-(i,j+1)
+// corners: bit 0 (i,j), bit 1 (i+1,j), bit 2 (i+1,j+1), bit 3 (i,j+1), set if inside
+const int SEGMENTS[16][4] = {
+    { -1, -1, -1, -1 }, { 3, 0, -1, -1 }, { 0, 1, -1, -1 }, { 3, 1, -1, -1 },
+    { 1, 2, -1, -1 },   { 3, 0, 1, 2 },   { 0, 2, -1, -1 }, { 3, 2, -1, -1 },
+    { 2, 3, -1, -1 },   { 0, 2, -1, -1 }, { 0, 1, 2, 3 },   { 1, 2, -1, -1 },
+    { 3, 1, -1, -1 },   { 0, 1, -1, -1 }, { 3, 0, -1, -1 }, { -1, -1, -1, -1 }
+};
+
+// saddles 5 and 10 with an inside center, i.e. the two inside corners are connected
+const int CONNECTED_5[4] = { 0, 1, 2, 3 };
+const int CONNECTED_10[4] = { 3, 0, 1, 2 };
+
+/// Edges are keyed 2 * (j * width + i) for the horizontal edge from (i,j), + 1 for the vertical one.
+size_t edgeKey(int width, int i, int j, int cellEdge) {
+    switch (cellEdge) {
+    case 0:  return 2 * (static_cast<size_t>(j) * width + i);
+    case 1:  return 2 * (static_cast<size_t>(j) * width + i + 1) + 1;
+    case 2:  return 2 * (static_cast<size_t>(j + 1) * width + i);
+    default: return 2 * (static_cast<size_t>(j) * width + i) + 1;
+    }
+}
+
+typedef std::pair<size_t, size_t> Segment;  ///< edge keys of both ends
+
+} // namespace
+
+bool PlaneContour::extract(const Grid& grid, float isoValue, const RowSampler& sample, ThreadPool& pool,
+                           const std::function<bool()>& cancelled)
+{
+    contours_.clear();
+    const int width = grid.width;
+    const int height = grid.height;
+    if (width < 2 || height < 2)
+        return true;
+    values_.resize(static_cast<size_t>(width) * height);
+
+    // sampling, every band writes its own rows
+    const size_t numBands = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    pool.parallelFor(numBands, [&](size_t band, size_t thread) {
+        const int end = std::min(height, static_cast<int>(band + 1) * BAND_HEIGHT);
+        for (int j = static_cast<int>(band) * BAND_HEIGHT; j < end; ++j) {
+            if (cancelled && cancelled())
+                return;
+            sample(j, thread, &values_[static_cast<size_t>(j) * width]);
+        }
+    });
+    if (cancelled && cancelled())
+        return false;
+
+    // marching squares, cell row j reads sample rows j and j + 1
+    std::vector<std::vector<Segment> > bandSegments(numBands);
+    pool.parallelFor(numBands, [&](size_t band, size_t) {
+        std::vector<Segment>& segments = bandSegments[band];
+        const int end = std::min(height - 1, static_cast<int>(band + 1) * BAND_HEIGHT);
+        for (int j = static_cast<int>(band) * BAND_HEIGHT; j < end; ++j) {
+            if (cancelled && cancelled())
+                return;
+            const float* lower = &values_[static_cast<size_t>(j) * width];
+            const float* upper = lower + width;
+            for (int i = 0; i + 1 < width; ++i) {
+                const int cell = (lower[i] >= isoValue ? 1 : 0) | (lower[i + 1] >= isoValue ? 2 : 0)
+                               | (upper[i + 1] >= isoValue ? 4 : 0) | (upper[i] >= isoValue ? 8 : 0);
+                if (cell == 0 || cell == 15)
+                    continue;
+                const int* edges = SEGMENTS[cell];
+                if ((cell == 5 || cell == 10) && (lower[i] + lower[i + 1] + upper[i + 1] + upper[i]) * 0.25f >= isoValue)
+                    edges = cell == 5 ? CONNECTED_5 : CONNECTED_10;
+                for (int s = 0; s < 4 && edges[s] >= 0; s += 2)
+                    segments.push_back(Segment(edgeKey(width, i, j, edges[s]), edgeKey(width, i, j, edges[s + 1])));
+            }
+        }
+    });
+    if (cancelled && cancelled())
+        return false;
+
+    std::vector<Segment> segments;
+    for (size_t b = 0; b < numBands; ++b)
+        segments.insert(segments.end(), bandSegments[b].begin(), bandSegments[b].end());
+
+    // every edge is shared by at most two segment ends, which are neighbours after sorting by edge
+    const size_t numEnds = 2 * segments.size();
+    std::vector<std::pair<size_t, size_t> > ends(numEnds); // (edge, 2 * segment + end)
+    for (size_t s = 0; s < segments.size(); ++s) {
+        ends[2 * s] = std::make_pair(segments[s].first, 2 * s);
+        ends[2 * s + 1] = std::make_pair(segments[s].second, 2 * s + 1);
+    }
+    std::sort(ends.begin(), ends.end());
+    const size_t none = std::numeric_limits<size_t>::max();
+    std::vector<size_t> link(numEnds, none);
+    for (size_t e = 0; e + 1 < numEnds; ++e) {
+        if (ends[e].first == ends[e + 1].first) {
+            link[ends[e].second] = ends[e + 1].second;
+            link[ends[e + 1].second] = ends[e].second;
+            ++e;
+        }
+    }
+
+    // follows the segments from the given end of first, returns the edges passed and whether it came back to first
+    std::vector<char> visited(segments.size(), 0);
+    auto walk = [&](size_t first, size_t exit, std::vector<size_t>& edges) {
+        size_t segment = first;
+        for (;;) {
+            edges.push_back(exit == 0 ? segments[segment].first : segments[segment].second);
+            const size_t next = link[2 * segment + exit];
+            if (next == none)
+                return false;
+            if (next / 2 == first) {
+                edges.pop_back();   // the start edge
+                return true;
+            }
+            segment = next / 2;
+            exit = 1 - next % 2;
+            visited[segment] = 1;
+        }
+    };
+
+    std::vector<size_t> forward, backward;
+    for (size_t s = 0; s < segments.size(); ++s) {
+        if (visited[s])
+            continue;
+        visited[s] = 1;
+        forward.assign(1, segments[s].first);
+        Contour contour;
+        contour.closed = walk(s, 1, forward);
+        if (!contour.closed) {
+            // the part before the start segment
+            backward.clear();
+            walk(s, 0, backward);
+            forward.insert(forward.begin(), backward.rbegin(), backward.rend() - 1);
+        }
+
+        contour.points.reserve(forward.size());
+        for (size_t e = 0; e < forward.size(); ++e)
+            contour.points.push_back(getCrossing(grid, isoValue, forward[e]));
+        for (size_t p = 1; p < contour.points.size(); ++p)
+            contour.length += distance(contour.points[p - 1], contour.points[p]);
+        if (contour.closed && contour.points.size() > 1)
+            contour.length += distance(contour.points.back(), contour.points.front());
+        contours_.push_back(contour);
+    }
+    return true;
+}
+
+Vec3 PlaneContour::getCrossing(const Grid& grid, float isoValue, size_t edge) const {
+    const size_t index = edge / 2;
+    const int i = static_cast<int>(index % grid.width);
+    const int j = static_cast<int>(index / grid.width);
+    const size_t other = index + (edge % 2 == 0 ? 1 : grid.width);
+    const float a = values_[index];
+    const float b = values_[other];
+    const float t = (isoValue - a) / (b - a);  // a and b lie on different sides
+    if (edge % 2 == 0)
+        return grid.at(i + t, static_cast<float>(j));
+    return grid.at(static_cast<float>(i), j + t);
+}
+
+int PlaneContour::findNearest(const Vec3& p) const {
+    int nearest = -1;
+    float best = std::numeric_limits<float>::max();
+    for (size_t c = 0; c < contours_.size(); ++c) {
+        const std::vector<Vec3>& points = contours_[c].points;
+        for (size_t i = 0; i < points.size(); ++i) {
+            const float d = distance(points[i], p);
+            if (d < best) {
+                best = d;
+                nearest = static_cast<int>(c);
+            }
+        }
+    }
+    return nearest;
+}
+
+} // namespace poitools
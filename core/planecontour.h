@@ -0,0 +1,75 @@
+#ifndef POITOOLS_CORE_PLANECONTOUR_H
+#define POITOOLS_CORE_PLANECONTOUR_H
+
+#include "threadpool.h"
+#include "types.h"
+
+#include <functional>
+#include <vector>
+
+namespace poitools {
+
+/**
+ * Iso contour of a scalar field on a plane, e.g. the outline of a surface in
+ * a slice through the volume, extracted with marching squares.
+ *
+ * The field is sampled on a regular grid of the plane. Sampling and the
+ * marching squares run in parallel over bands of rows, only linking the
+ * segments to contours is sequential. Saddle cells are resolved with the
+ * average of their corners.
+ */
+class PlaneContour {
+public:
+    /// Sample (i, j) lies at origin + i * u + j * v (world coordinates).
+    struct Grid {
+        Grid() : width(0), height(0) {}
+
+        Vec3 origin;
+        Vec3 u;
+        Vec3 v;
+        int width;
+        int height;
+
+        Vec3 at(float i, float j) const { return origin + u * i + v * j; }
+    };
+
+    /// Writes the grid.width values of row j to values, thread identifies the thread of the pool.
+    typedef std::function<void(int j, size_t thread, float* values)> RowSampler;
+
+    struct Contour {
+        Contour() : closed(false), length(0.0f) {}
+
+        std::vector<Vec3> points;   ///< world coordinates
+        bool closed;                ///< the last point connects to the first one
+        float length;
+    };
+
+    /**
+     * Samples the grid and extracts the contours of the region >= isoValue.
+     *
+     * @param cancelled polled between rows, if it returns true there are no contours
+     * @return false if it has been cancelled
+     */
+    bool extract(const Grid& grid, float isoValue, const RowSampler& sample, ThreadPool& pool,
+                 const std::function<bool()>& cancelled = std::function<bool()>());
+
+    const std::vector<Contour>& getContours() const { return contours_; }
+
+    /// Index of the contour passing closest to p, -1 if there is none.
+    int findNearest(const Vec3& p) const;
+
+    void clear() { contours_.clear(); }
+
+private:
+    static const int BAND_HEIGHT = 32;  ///< rows per parallel item
+
+    /// Position of the iso crossing on the grid edge with the given key (see extract()).
+    Vec3 getCrossing(const Grid& grid, float isoValue, size_t edge) const;
+
+    std::vector<float> values_;         ///< of the last grid, row-major
+    std::vector<Contour> contours_;
+};
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_PLANECONTOUR_H
@@ -0,0 +1,383 @@
+#include "pointexport.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace poitools {
+
+namespace {
+
+const char MAGIC[4] = { 'P', 'O', 'I', 'X' };
+const unsigned int VERSION = 1;
+const unsigned int ORDER_MARK = 0x01020304u;
+const char* const TYPE_NAMES[2] = { "point", "path" };
+
+static_assert(sizeof(Vec3) == 12, "vertices are written as they are in memory");
+static_assert(sizeof(PointExportHeader) == 64, "the header layout is part of the format");
+static_assert(sizeof(PointExportEntry) == 32, "the entry layout is part of the format");
+
+/// Quotes field if it contains a separator, a quote or a line break.
+std::string csvField(const std::string& field) {
+    if (field.find_first_of(",\"\r\n") == std::string::npos)
+        return field;
+    std::string quoted = "\"";
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '"')
+            quoted += '"';
+        quoted += field[i];
+    }
+    return quoted + "\"";
+}
+
+size_t formatInteger(unsigned long long value, char* out) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < n; ++i)
+        out[i] = digits[n - 1 - i];
+    return n;
+}
+
+/// Powers of ten for every decimal exponent of a float, pow() is slow.
+struct PowerTable {
+    PowerTable() {
+        for (int i = 0; i < 2 * RANGE + 1; ++i)
+            entries[i] = std::pow(10.0, i - RANGE);
+    }
+    double get(int exponent) const { return entries[exponent + RANGE]; }
+
+    static const int RANGE = 64;
+    double entries[2 * RANGE + 1];
+};
+
+/**
+ * Writes value with 9 significant digits like "%.9g", which reads back as the
+ * same float, but several times faster than printf. The digits are rounded in
+ * double precision, an error in the last digit is still far below half a
+ * float ulp.
+ */
+size_t formatFloat(float value, char* out) {
+    if (!std::isfinite(value))
+        return static_cast<size_t>(std::snprintf(out, 8, "%g", value));
+    char* p = out;
+    double v = value;
+    if (std::signbit(v)) {
+        *p++ = '-';
+        v = -v;
+    }
+    if (v == 0.0) {
+        *p++ = '0';
+        return p - out;
+    }
+
+    // the decimal exponent is estimated from the binary one, it is either right or one too small
+    static const PowerTable powers;
+    int binaryExponent;
+    std::frexp(v, &binaryExponent);
+    int exponent = static_cast<int>(std::floor((binaryExponent - 1) * 0.30102999566398120));
+    unsigned long long digits = static_cast<unsigned long long>(std::llround(v * powers.get(8 - exponent)));
+    if (digits >= 1000000000ull) {
+        exponent++;
+        digits = static_cast<unsigned long long>(std::llround(v * powers.get(8 - exponent)));
+    }
+    char d[9];
+    for (int i = 8; i >= 0; --i) {
+        d[i] = static_cast<char>('0' + digits % 10);
+        digits /= 10;
+    }
+    int n = 9;
+    while (n > 1 && d[n - 1] == '0')
+        n--;
+
+    if (exponent >= -5 && exponent < 9) {
+        if (exponent < 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int i = -1; i > exponent; --i)
+                *p++ = '0';
+            for (int i = 0; i < n; ++i)
+                *p++ = d[i];
+        } else {
+            for (int i = 0; i <= exponent; ++i)
+                *p++ = d[i];
+            if (n > exponent + 1) {
+                *p++ = '.';
+                for (int i = exponent + 1; i < n; ++i)
+                    *p++ = d[i];
+            }
+        }
+        return p - out;
+    }
+
+    *p++ = d[0];
+    if (n > 1) {
+        *p++ = '.';
+        for (int i = 1; i < n; ++i)
+            *p++ = d[i];
+    }
+    *p++ = 'e';
+    *p++ = exponent < 0 ? '-' : '+';
+    const int e = exponent < 0 ? -exponent : exponent;
+    *p++ = static_cast<char>('0' + e / 10);
+    *p++ = static_cast<char>('0' + e % 10);
+    return p - out;
+}
+
+PointExportHeader makeHeader() {
+    PointExportHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.headerSize = sizeof(PointExportHeader);
+    header.byteOrder = ORDER_MARK;
+    header.vertexOffset = sizeof(PointExportHeader);
+    return header;
+}
+
+} // namespace
+
+PointExporter::PointExporter()
+    : file_(0)
+    , format_(EXPORT_CSV)
+    , failed_(false)
+    , numVertices_(0)
+{
+}
+
+PointExporter::~PointExporter() {
+    close();
+}
+
+bool PointExporter::open(const std::string& path, ExportFormat format) {
+    close();
+    file_ = std::fopen(path.c_str(), format == EXPORT_BINARY ? "wb" : "w");
+    if (!file_)
+        return false;
+    buffer_.resize(BUFFER_SIZE);
+    std::setvbuf(file_, &buffer_[0], _IOFBF, buffer_.size());
+
+    format_ = format;
+    failed_ = false;
+    group_.clear();
+    quotedGroup_.clear();
+    numVertices_ = 0;
+    entries_.clear();
+    strings_.clear();
+    stringOffsets_.clear();
+
+    if (format_ == EXPORT_CSV) {
+        const char columns[] = "group,label,type,value,index,x,y,z\n";
+        failed_ = std::fwrite(columns, 1, sizeof(columns) - 1, file_) != sizeof(columns) - 1;
+    } else {
+        // rewritten by close(), an unfinished export is recognizable by its missing entry table
+        const PointExportHeader header = makeHeader();
+        failed_ = std::fwrite(&header, sizeof(header), 1, file_) != 1;
+    }
+    return true;
+}
+
+void PointExporter::setGroup(const std::string& group) {
+    group_ = group;
+    quotedGroup_ = csvField(group);
+}
+
+void PointExporter::writePoint(const std::string& label, const Vec3& point) {
+    if (!file_)
+        return;
+    if (format_ == EXPORT_CSV) {
+        writeRow(TYPE_NAMES[EXPORT_POINT], csvField(label), 0.0f, 0, point);
+        return;
+    }
+    PointExportEntry entry;
+    entry.type = EXPORT_POINT;
+    entry.group = addString(group_);
+    entry.label = addString(label);
+    entry.value = 0.0f;
+    entry.firstVertex = numVertices_;
+    entry.numVertices = 1;
+    entries_.push_back(entry);
+    writeVertices(&point, 1);
+}
+
+void PointExporter::writePath(const std::string& label, float length, const std::vector<Vec3>& path) {
+    if (!file_)
+        return;
+    if (format_ == EXPORT_CSV) {
+        const std::string quoted = csvField(label);
+        for (size_t i = 0; i < path.size(); ++i)
+            writeRow(TYPE_NAMES[EXPORT_PATH], quoted, length, i, path[i]);
+        return;
+    }
+    PointExportEntry entry;
+    entry.type = EXPORT_PATH;
+    entry.group = addString(group_);
+    entry.label = addString(label);
+    entry.value = length;
+    entry.firstVertex = numVertices_;
+    entry.numVertices = path.size();
+    entries_.push_back(entry);
+    if (!path.empty())
+        writeVertices(&path[0], path.size());
+}
+
+bool PointExporter::close() {
+    if (!file_)
+        return false;
+
+    if (format_ == EXPORT_BINARY) {
+        PointExportHeader header = makeHeader();
+        header.numVertices = numVertices_;
+        header.numEntries = entries_.size();
+
+        // the entries are aligned to 8 bytes for mappings
+        const unsigned long long vertexEnd = header.vertexOffset + 12 * numVertices_;
+        const char padding[8] = { 0 };
+        const size_t numPadding = static_cast<size_t>((8 - vertexEnd % 8) % 8);
+        header.entryOffset = vertexEnd + numPadding;
+        header.stringOffset = header.entryOffset + sizeof(PointExportEntry) * entries_.size();
+        header.stringSize = strings_.size();
+
+        if (numPadding > 0 && std::fwrite(padding, 1, numPadding, file_) != numPadding)
+            failed_ = true;
+        if (!entries_.empty() && std::fwrite(&entries_[0], sizeof(PointExportEntry), entries_.size(), file_) != entries_.size())
+            failed_ = true;
+        if (!strings_.empty() && std::fwrite(&strings_[0], 1, strings_.size(), file_) != strings_.size())
+            failed_ = true;
+        if (std::fseek(file_, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(header), 1, file_) != 1)
+            failed_ = true;
+    }
+
+    if (std::ferror(file_) || std::fclose(file_) != 0)
+        failed_ = true;
+    file_ = 0;
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    entries_.clear();
+    strings_.clear();
+    stringOffsets_.clear();
+    return !failed_;
+}
+
+void PointExporter::writeRow(const char* type, const std::string& label, float value, size_t index, const Vec3& point) {
+    // the row is assembled first, one locked stdio call per row instead of one per field
+    const size_t typeSize = std::strlen(type);
+    const size_t maxSize = quotedGroup_.size() + label.size() + typeSize + 128;
+    char local[512];
+    std::vector<char> heap;
+    char* row = local;
+    if (maxSize > sizeof(local)) {
+        heap.resize(maxSize);
+        row = &heap[0];
+    }
+
+    char* p = row;
+    std::memcpy(p, quotedGroup_.data(), quotedGroup_.size());
+    p += quotedGroup_.size();
+    *p++ = ',';
+    std::memcpy(p, label.data(), label.size());
+    p += label.size();
+    *p++ = ',';
+    std::memcpy(p, type, typeSize);
+    p += typeSize;
+    *p++ = ',';
+    p += formatFloat(value, p);
+    *p++ = ',';
+    p += formatInteger(index, p);
+    *p++ = ',';
+    p += formatFloat(point.x, p);
+    *p++ = ',';
+    p += formatFloat(point.y, p);
+    *p++ = ',';
+    p += formatFloat(point.z, p);
+    *p++ = '\n';
+
+    const size_t size = p - row;
+    if (std::fwrite(row, 1, size, file_) != size)
+        failed_ = true;
+}
+
+void PointExporter::writeVertices(const Vec3* points, size_t count) {
+    if (std::fwrite(points, sizeof(Vec3), count, file_) != count)
+        failed_ = true;
+    numVertices_ += count;
+}
+
+unsigned int PointExporter::addString(const std::string& s) {
+    std::map<std::string, unsigned int>::const_iterator it = stringOffsets_.find(s);
+    if (it != stringOffsets_.end())
+        return it->second;
+    const unsigned int offset = static_cast<unsigned int>(strings_.size());
+    strings_.insert(strings_.end(), s.begin(), s.end());
+    strings_.push_back('\0');
+    stringOffsets_[s] = offset;
+    return offset;
+}
+
+ExportFormat getExportFormat(const std::string& path) {
+    const std::string extension = ".poix";
+    if (path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0)
+        return EXPORT_BINARY;
+    return EXPORT_CSV;
+}
+
+bool readPointExport(const std::string& path, std::vector<ExportRecord>& records) {
+    records.clear();
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (data.size() < sizeof(PointExportHeader) || !file.read(&data[0], data.size()))
+        return false;
+
+    PointExportHeader header;
+    std::memcpy(&header, &data[0], sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, 4) != 0 || header.version != VERSION || header.byteOrder != ORDER_MARK
+            || header.entryOffset == 0)
+        return false;
+    const unsigned long long size = data.size();
+    if (header.vertexOffset > size || header.numVertices > (size - header.vertexOffset) / 12
+            || header.entryOffset > size || header.numEntries > (size - header.entryOffset) / sizeof(PointExportEntry)
+            || header.stringOffset > size || header.stringSize > size - header.stringOffset)
+        return false;
+
+    const char* strings = &data[0] + header.stringOffset;
+    const size_t stringSize = static_cast<size_t>(header.stringSize);
+    auto getString = [&](unsigned int offset, std::string& s) {
+        if (offset >= stringSize)
+            return false;
+        const void* end = std::memchr(strings + offset, '\0', stringSize - offset);
+        if (!end)
+            return false;
+        s.assign(strings + offset, static_cast<const char*>(end));
+        return true;
+    };
+
+    records.resize(static_cast<size_t>(header.numEntries));
+    for (size_t e = 0; e < records.size(); ++e) {
+        PointExportEntry entry;
+        std::memcpy(&entry, &data[0] + header.entryOffset + e * sizeof(PointExportEntry), sizeof(entry));
+        if (entry.type > EXPORT_PATH || entry.firstVertex > header.numVertices
+                || entry.numVertices > header.numVertices - entry.firstVertex) {
+            records.clear();
+            return false;
+        }
+        ExportRecord& record = records[e];
+        record.type = static_cast<ExportRecordType>(entry.type);
+        record.value = entry.value;
+        if (!getString(entry.group, record.group) || !getString(entry.label, record.label)) {
+            records.clear();
+            return false;
+        }
+        record.points.resize(static_cast<size_t>(entry.numVertices));
+        if (!record.points.empty())
+            std::memcpy(&record.points[0], &data[0] + header.vertexOffset + 12 * entry.firstVertex, 12 * record.points.size());
+    }
+    return true;
+}
+
+} // namespace poitools
@@ -0,0 +1,136 @@
+#ifndef POITOOLS_CORE_POINTEXPORT_H
+#define POITOOLS_CORE_POINTEXPORT_H
+
+#include "types.h"
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace poitools {
+
+enum ExportFormat {
+    EXPORT_CSV,     ///< text, one row per point
+    EXPORT_BINARY   ///< see PointExportHeader
+};
+
+enum ExportRecordType {
+    EXPORT_POINT = 0,   ///< a single point, e.g. a landmark
+    EXPORT_PATH = 1     ///< the points of a measured path, value is its length
+};
+
+/**
+ * Header at the start of a binary point export, version 1. Together with
+ * PointExportEntry it can be used as is on a memory mapping of the file:
+ *
+ *  - numVertices x, y, z floats at vertexOffset,
+ *  - numEntries PointExportEntry at entryOffset,
+ *  - the group and label strings at stringOffset, each terminated by a zero byte.
+ *
+ * All values are in the byte order of the writer, byteOrder reads
+ * 0x01020304 in the same one. The tables are written when the export is
+ * closed, entryOffset is 0 in files of an export that has not been finished.
+ */
+struct PointExportHeader {
+    char magic[4];                  ///< "POIX"
+    unsigned int version;
+    unsigned int headerSize;        ///< sizeof(PointExportHeader), the vertices may start behind it in later versions
+    unsigned int byteOrder;
+    unsigned long long numVertices;
+    unsigned long long numEntries;
+    unsigned long long vertexOffset;
+    unsigned long long entryOffset;
+    unsigned long long stringOffset;
+    unsigned long long stringSize;
+};
+
+struct PointExportEntry {
+    unsigned int type;              ///< ExportRecordType
+    unsigned int group;             ///< offset of the group name into the strings
+    unsigned int label;             ///< offset of the label into the strings
+    float value;                    ///< length of a path, 0 for points
+    unsigned long long firstVertex;
+    unsigned long long numVertices;
+};
+
+/// A record read back from an export.
+struct ExportRecord {
+    ExportRecord() : type(EXPORT_POINT), value(0.0f) {}
+
+    ExportRecordType type;
+    std::string group;
+    std::string label;
+    float value;
+    std::vector<Vec3> points;
+};
+
+/**
+ * Streams picked points and measured paths to a file.
+ *
+ * Records are grouped, e.g. by the volume they have been measured on, see
+ * setGroup(). CSV exports have the columns group, label, type, value, index,
+ * x, y, z and a row for every point, the index counts the points of a path.
+ * Binary exports stream the points to the file as they are written and keep
+ * only the small record table in memory until close(). Both are written
+ * through a large buffer, so long paths are written at disk speed.
+ */
+class PointExporter {
+public:
+    PointExporter();
+    ~PointExporter();
+
+    /// Creates the file at path, an open export is closed first.
+    bool open(const std::string& path, ExportFormat format);
+
+    bool isOpen() const { return file_ != 0; }
+
+    /// Group of the records written from now on, empty by default.
+    void setGroup(const std::string& group);
+
+    void writePoint(const std::string& label, const Vec3& point);
+
+    void writePath(const std::string& label, float length, const std::vector<Vec3>& path);
+
+    /**
+     * Writes the tables of a binary export and closes the file.
+     *
+     * @return false if any write since open() has failed
+     */
+    bool close();
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    void writeRow(const char* type, const std::string& label, float value, size_t index, const Vec3& point);
+    void writeVertices(const Vec3* points, size_t count);
+    unsigned int addString(const std::string& s);
+
+    std::FILE* file_;
+    ExportFormat format_;
+    bool failed_;
+    std::vector<char> buffer_;      ///< stdio buffer of file_
+
+    std::string group_;
+    std::string quotedGroup_;       ///< group_ as a CSV field
+
+    // tables of a binary export
+    unsigned long long numVertices_;
+    std::vector<PointExportEntry> entries_;
+    std::vector<char> strings_;
+    std::map<std::string, unsigned int> stringOffsets_;
+};
+
+/// EXPORT_BINARY for files ending in ".poix", otherwise EXPORT_CSV.
+ExportFormat getExportFormat(const std::string& path);
+
+/**
+ * Reads a binary export.
+ *
+ * @return false if the file cannot be read, is no point export or has not been finished
+ */
+bool readPointExport(const std::string& path, std::vector<ExportRecord>& records);
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_POINTEXPORT_H
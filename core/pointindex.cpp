@@ -0,0 +1,134 @@
+#include "pointindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace poitools {
+
+PointIndex::PointIndex(float cellSize)
+    : cellSize_(cellSize > 0.0f ? cellSize : 1.0f)
+    , size_(0)
+{
+}
+
+void PointIndex::setCellSize(float cellSize) {
+    if (cellSize <= 0.0f || cellSize == cellSize_)
+        return;
+
+    std::vector<Entry> entries;
+    entries.reserve(size_);
+    for (std::unordered_map<uint64_t, std::vector<Entry> >::const_iterator it = cells_.begin(); it != cells_.end(); ++it)
+        entries.insert(entries.end(), it->second.begin(), it->second.end());
+
+    clear();
+    cellSize_ = cellSize;
+    for (size_t i = 0; i < entries.size(); ++i)
+        insert(entries[i].id, entries[i].pos);
+}
+
+PointIndex::Cell PointIndex::getCell(const Vec3& pos) const {
+    Cell cell;
+    cell.x = static_cast<int>(std::floor(pos.x / cellSize_));
+    cell.y = static_cast<int>(std::floor(pos.y / cellSize_));
+    cell.z = static_cast<int>(std::floor(pos.z / cellSize_));
+    return cell;
+}
+
+uint64_t PointIndex::getKey(int x, int y, int z) {
+    // 21 bits per axis, coordinates wrap around far away from the origin which only costs precision of the hash
+    const uint64_t mask = (1u << 21) - 1;
+    return ((static_cast<uint64_t>(x) & mask) << 42) | ((static_cast<uint64_t>(y) & mask) << 21) | (static_cast<uint64_t>(z) & mask);
+}
+
+void PointIndex::insert(size_t id, const Vec3& pos) {
+    Cell c = getCell(pos);
+    Entry entry;
+    entry.id = id;
+    entry.pos = pos;
+    cells_[getKey(c.x, c.y, c.z)].push_back(entry);
+    size_++;
+}
+
+bool PointIndex::remove(size_t id, const Vec3& pos) {
+    Cell c = getCell(pos);
+    std::unordered_map<uint64_t, std::vector<Entry> >::iterator it = cells_.find(getKey(c.x, c.y, c.z));
+    if (it == cells_.end())
+        return false;
+
+    std::vector<Entry>& entries = it->second;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].id == id) {
+            entries[i] = entries.back();
+            entries.pop_back();
+            if (entries.empty())
+                cells_.erase(it);
+            size_--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PointIndex::clear() {
+    cells_.clear();
+    size_ = 0;
+}
+
+void PointIndex::visit(uint64_t key, const Vec3& pos, float& bestDistance, const Entry*& best) const {
+    std::unordered_map<uint64_t, std::vector<Entry> >::const_iterator it = cells_.find(key);
+    if (it == cells_.end())
+        return;
+    for (size_t i = 0; i < it->second.size(); ++i) {
+        float d = distance(pos, it->second[i].pos);
+        if (d <= bestDistance) {
+            bestDistance = d;
+            best = &it->second[i];
+        }
+    }
+}
+
+bool PointIndex::findNearest(const Vec3& pos, float maxDistance, size_t& id, float* dist) const {
+    if (size_ == 0 || !(maxDistance >= 0.0f))
+        return false;
+
+    float bestDistance = maxDistance;
+    const Entry* best = 0;
+    const Cell c = getCell(pos);
+
+    // shell r holds the cells with a chebyshev distance of r to the query cell, any point in it is
+    // at least (r - 1) * cellSize away
+    const float maxShells = std::min(maxDistance / cellSize_ + 1.0f, static_cast<float>(1 << 20));
+    for (int r = 0; r <= static_cast<int>(maxShells); ++r) {
+        if (best && bestDistance < (r - 1) * cellSize_)
+            break;
+
+        // a shell with more cells than there are occupied ones is more expensive than looking at all of them
+        const double shellCells = r == 0 ? 1.0 : std::pow(2.0 * r + 1.0, 3.0) - std::pow(2.0 * r - 1.0, 3.0);
+        if (shellCells > static_cast<double>(cells_.size())) {
+            for (std::unordered_map<uint64_t, std::vector<Entry> >::const_iterator it = cells_.begin(); it != cells_.end(); ++it)
+                visit(it->first, pos, bestDistance, best);
+            break;
+        }
+
+        for (int z = -r; z <= r; ++z) {
+            for (int y = -r; y <= r; ++y) {
+                const bool inner = std::abs(z) < r && std::abs(y) < r;
+                for (int x = -r; x <= r; x += (inner ? 2 * r : 1)) {
+                    visit(getKey(c.x + x, c.y + y, c.z + z), pos, bestDistance, best);
+                    if (r == 0)
+                        break;
+                }
+            }
+        }
+    }
+
+    if (!best)
+        return false;
+    id = best->id;
+    if (dist)
+        *dist = bestDistance;
+    return true;
+}
+
+} // namespace poitools
@@ -0,0 +1,68 @@
+#ifndef POITOOLS_CORE_POINTINDEX_H
+#define POITOOLS_CORE_POINTINDEX_H
+
+#include "types.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace poitools {
+
+/**
+ * Uniform hash grid over a changing set of points, e.g. the picked landmarks.
+ *
+ * Points are inserted and removed one at a time in constant time. Nearest
+ * point queries visit the cells in growing shells around the query position
+ * and stop as soon as no closer point can follow, so their cost depends on the
+ * local density rather than on the number of points. The cell size should be
+ * in the order of the typical query radius.
+ */
+class PointIndex {
+public:
+    explicit PointIndex(float cellSize = 1.0f);
+
+    /// Changes the cell size, the points are kept.
+    void setCellSize(float cellSize);
+    float getCellSize() const { return cellSize_; }
+
+    void insert(size_t id, const Vec3& pos);
+
+    /// Removes the point id that has been inserted at pos, returns false if there is none.
+    bool remove(size_t id, const Vec3& pos);
+
+    void clear();
+    size_t size() const { return size_; }
+
+    /**
+     * Finds the point closest to pos.
+     *
+     * @param maxDistance only points up to this distance are considered
+     * @return false if there is no such point, id and distance are left untouched then
+     */
+    bool findNearest(const Vec3& pos, float maxDistance, size_t& id, float* distance = 0) const;
+
+private:
+    struct Entry {
+        size_t id;
+        Vec3 pos;
+    };
+
+    struct Cell {
+        int x, y, z;
+    };
+
+    Cell getCell(const Vec3& pos) const;
+    static uint64_t getKey(int x, int y, int z);
+
+    /// Checks the points of one cell against the best candidate so far.
+    void visit(uint64_t key, const Vec3& pos, float& bestDistance, const Entry*& best) const;
+
+    float cellSize_;
+    size_t size_;
+    std::unordered_map<uint64_t, std::vector<Entry> > cells_;
+};
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_POINTINDEX_H
@@ -0,0 +1,215 @@
+#include "polyline.h"
+
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POITOOLS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define POITOOLS_TARGET_AVX
+#else
+#define POITOOLS_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+namespace poitools {
+
+namespace {
+
+std::atomic<int> simdLevel(-1);
+
+/**
+ * Kernel signature: m is the row-major affine matrix (first three rows) or null
+ * for the identity, out* may be null or alias the input.
+ */
+typedef float (*Kernel)(const float* m, const float* x, const float* y, const float* z, size_t n,
+                        float* ox, float* oy, float* oz);
+
+/// Transforms and measures the points [begin, n), prev is the transformed point begin - 1 if begin > 0.
+float scalarTail(const float* m, const float* x, const float* y, const float* z, size_t begin, size_t n,
+                 float* ox, float* oy, float* oz)
+{
+    float dist = 0.0f;
+    float px = 0.0f, py = 0.0f, pz = 0.0f;
+    for (size_t i = begin; i < n; ++i) {
+        float tx = x[i], ty = y[i], tz = z[i];
+        if (m) {
+            float ax = m[0] * tx + m[1] * ty + m[2]  * tz + m[3];
+            float ay = m[4] * tx + m[5] * ty + m[6]  * tz + m[7];
+            float az = m[8] * tx + m[9] * ty + m[10] * tz + m[11];
+            tx = ax; ty = ay; tz = az;
+        }
+        if (i > begin) {
+            float dx = tx - px, dy = ty - py, dz = tz - pz;
+            dist += std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+        if (ox) {
+            ox[i] = tx; oy[i] = ty; oz[i] = tz;
+        }
+        px = tx; py = ty; pz = tz;
+    }
+    return dist;
+}
+
+float scalarKernel(const float* m, const float* x, const float* y, const float* z, size_t n,
+                   float* ox, float* oy, float* oz)
+{
+    return scalarTail(m, x, y, z, 0, n, ox, oy, oz);
+}
+
+#ifdef POITOOLS_X86
+
+float sse2Kernel(const float* m, const float* x, const float* y, const float* z, size_t n,
+                 float* ox, float* oy, float* oz)
+{
+    __m128 r[12];
+    for (int i = 0; i < 12; ++i)
+        r[i] = _mm_set1_ps(m ? m[i] : ((i % 5 == 0) ? 1.0f : 0.0f));
+
+    __m128 sum = _mm_setzero_ps();
+    size_t i = 0;
+    // block i covers the segments i..i+3 and needs the points i..i+4
+    for (; i + 5 <= n; i += 4) {
+        __m128 x0 = _mm_loadu_ps(x + i), y0 = _mm_loadu_ps(y + i), z0 = _mm_loadu_ps(z + i);
+        __m128 x1 = _mm_loadu_ps(x + i + 1), y1 = _mm_loadu_ps(y + i + 1), z1 = _mm_loadu_ps(z + i + 1);
+
+        __m128 tx0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], x0), _mm_mul_ps(r[1], y0)), _mm_add_ps(_mm_mul_ps(r[2], z0), r[3]));
+        __m128 ty0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[4], x0), _mm_mul_ps(r[5], y0)), _mm_add_ps(_mm_mul_ps(r[6], z0), r[7]));
+        __m128 tz0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[8], x0), _mm_mul_ps(r[9], y0)), _mm_add_ps(_mm_mul_ps(r[10], z0), r[11]));
+        __m128 tx1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], x1), _mm_mul_ps(r[1], y1)), _mm_add_ps(_mm_mul_ps(r[2], z1), r[3]));
+        __m128 ty1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[4], x1), _mm_mul_ps(r[5], y1)), _mm_add_ps(_mm_mul_ps(r[6], z1), r[7]));
+        __m128 tz1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[8], x1), _mm_mul_ps(r[9], y1)), _mm_add_ps(_mm_mul_ps(r[10], z1), r[11]));
+
+        __m128 dx = _mm_sub_ps(tx1, tx0), dy = _mm_sub_ps(ty1, ty0), dz = _mm_sub_ps(tz1, tz0);
+        sum = _mm_add_ps(sum, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz))));
+
+        if (ox) {
+            _mm_storeu_ps(ox + i, tx0);
+            _mm_storeu_ps(oy + i, ty0);
+            _mm_storeu_ps(oz + i, tz0);
+        }
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalarTail(m, x, y, z, i, n, ox, oy, oz);
+}
+
+POITOOLS_TARGET_AVX
+float avxKernel(const float* m, const float* x, const float* y, const float* z, size_t n,
+                float* ox, float* oy, float* oz)
+{
+    __m256 r[12];
+    for (int i = 0; i < 12; ++i)
+        r[i] = _mm256_set1_ps(m ? m[i] : ((i % 5 == 0) ? 1.0f : 0.0f));
+
+    __m256 sum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 9 <= n; i += 8) {
+        __m256 x0 = _mm256_loadu_ps(x + i), y0 = _mm256_loadu_ps(y + i), z0 = _mm256_loadu_ps(z + i);
+        __m256 x1 = _mm256_loadu_ps(x + i + 1), y1 = _mm256_loadu_ps(y + i + 1), z1 = _mm256_loadu_ps(z + i + 1);
+
+        __m256 tx0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], x0), _mm256_mul_ps(r[1], y0)), _mm256_add_ps(_mm256_mul_ps(r[2], z0), r[3]));
+        __m256 ty0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[4], x0), _mm256_mul_ps(r[5], y0)), _mm256_add_ps(_mm256_mul_ps(r[6], z0), r[7]));
+        __m256 tz0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[8], x0), _mm256_mul_ps(r[9], y0)), _mm256_add_ps(_mm256_mul_ps(r[10], z0), r[11]));
+        __m256 tx1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], x1), _mm256_mul_ps(r[1], y1)), _mm256_add_ps(_mm256_mul_ps(r[2], z1), r[3]));
+        __m256 ty1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[4], x1), _mm256_mul_ps(r[5], y1)), _mm256_add_ps(_mm256_mul_ps(r[6], z1), r[7]));
+        __m256 tz1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[8], x1), _mm256_mul_ps(r[9], y1)), _mm256_add_ps(_mm256_mul_ps(r[10], z1), r[11]));
+
+        __m256 dx = _mm256_sub_ps(tx1, tx0), dy = _mm256_sub_ps(ty1, ty0), dz = _mm256_sub_ps(tz1, tz0);
+        sum = _mm256_add_ps(sum, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz))));
+
+        if (ox) {
+            _mm256_storeu_ps(ox + i, tx0);
+            _mm256_storeu_ps(oy + i, ty0);
+            _mm256_storeu_ps(oz + i, tz0);
+        }
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, sum);
+    float dist = 0.0f;
+    for (int l = 0; l < 8; ++l)
+        dist += lanes[l];
+    _mm256_zeroupper();
+    return dist + scalarTail(m, x, y, z, i, n, ox, oy, oz);
+}
+
+#endif // POITOOLS_X86
+
+Kernel getKernel() {
+    switch (getSimdLevel()) {
+#ifdef POITOOLS_X86
+    case SIMD_AVX:  return &avxKernel;
+    case SIMD_SSE2: return &sse2Kernel;
+#endif
+    default:        return &scalarKernel;
+    }
+}
+
+float run(const float* m, const PointsSoA& in, PointsSoA* out) {
+    const size_t n = in.size();
+    if (out && out != &in)
+        out->resize(n);
+    if (n == 0)
+        return 0.0f;
+    return getKernel()(m, in.x.data(), in.y.data(), in.z.data(), n,
+                       out ? out->x.data() : 0, out ? out->y.data() : 0, out ? out->z.data() : 0);
+}
+
+} // namespace
+
+SimdLevel getSupportedSimdLevel() {
+#if defined(POITOOLS_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (osxsave && avx && (_xgetbv(0) & 6) == 6)
+        return SIMD_AVX;
+    return (info[3] & (1 << 26)) ? SIMD_SSE2 : SIMD_SCALAR;
+#elif defined(POITOOLS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+        return SIMD_AVX;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+    return SIMD_SCALAR;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+SimdLevel getSimdLevel() {
+    int level = simdLevel.load();
+    if (level < 0) {
+        level = getSupportedSimdLevel();
+        simdLevel.store(level);
+    }
+    return static_cast<SimdLevel>(level);
+}
+
+void setSimdLevel(SimdLevel level) {
+    SimdLevel supported = getSupportedSimdLevel();
+    simdLevel.store(level < supported ? level : supported);
+}
+
+const char* getSimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SIMD_AVX:  return "avx";
+    case SIMD_SSE2: return "sse2";
+    default:        return "scalar";
+    }
+}
+
+float transformPolyline(const Mat4& m, const PointsSoA& in, PointsSoA* out) {
+    return run(m.m, in, out);
+}
+
+float polylineLength(const PointsSoA& points) {
+    return run(0, points, 0);
+}
+
+} // namespace poitools
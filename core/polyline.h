@@ -0,0 +1,53 @@
+#ifndef POITOOLS_CORE_POLYLINE_H
+#define POITOOLS_CORE_POLYLINE_H
+
+#include "types.h"
+
+#include <vector>
+
+namespace poitools {
+
+/// Points in structure of arrays layout, as consumed by the batch kernels below.
+struct PointsSoA {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    size_t size() const { return x.size(); }
+    void clear() { x.clear(); y.clear(); z.clear(); }
+    void reserve(size_t n) { x.reserve(n); y.reserve(n); z.reserve(n); }
+    void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); }
+    void push_back(const Vec3& p) { x.push_back(p.x); y.push_back(p.y); z.push_back(p.z); }
+    Vec3 operator[](size_t i) const { return Vec3(x[i], y[i], z[i]); }
+};
+
+/**
+ * Instruction set used by the kernels. The best one supported by the CPU is
+ * selected on first use, setSimdLevel() allows to force a lower one (e.g. to
+ * compare them in the benchmark).
+ */
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX
+};
+
+SimdLevel getSupportedSimdLevel();
+SimdLevel getSimdLevel();
+void setSimdLevel(SimdLevel level);     ///< clamped to the supported level
+const char* getSimdLevelName(SimdLevel level);
+
+/**
+ * Transforms n points with the affine matrix m and returns the length of the
+ * polyline through the transformed points, both in one pass.
+ *
+ * @param out receives the transformed points if not null, may alias in
+ */
+float transformPolyline(const Mat4& m, const PointsSoA& in, PointsSoA* out);
+
+/// Length of the polyline through the points.
+float polylineLength(const PointsSoA& points);
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_POLYLINE_H
@@ -0,0 +1,235 @@
+#include "surfacenets.h"
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace poitools {
+
+namespace {
+
+const int MIN_BRICK_SIZE = 8;
+const int MAX_BRICK_SIZE = 64;
+
+/// Memory of a brick of size^3 cells in flight.
+size_t getBrickBytes(int size, const SurfaceNets::Settings& settings) {
+    const size_t samples = static_cast<size_t>(size + 1) * (size + 1) * (size + 1);
+    return samples * (sizeof(float) + settings.readerBytesPerSample);
+}
+
+struct Vertex {
+    size_t cellId;
+    Vec3 position;
+
+    bool operator<(const Vertex& other) const { return cellId < other.cellId; }
+};
+
+void getRange(const float* values, size_t count, float& minimum, float& maximum) {
+    minimum = values[0];
+    maximum = values[0];
+    for (size_t i = 1; i < count; ++i) {
+        minimum = std::min(minimum, values[i]);
+        maximum = std::max(maximum, values[i]);
+    }
+}
+
+/// Appends the surface nets vertices of the brick at offset with size samples.
+void extractBrick(const float* values, const IVec3& offset, const IVec3& size, const IVec3& cellDims,
+                  float isoValue, std::vector<Vertex>& vertices)
+{
+    const size_t strideY = static_cast<size_t>(size.x);
+    const size_t strideZ = strideY * size.y;
+    for (int z = 0; z + 1 < size.z; ++z) {
+        for (int y = 0; y + 1 < size.y; ++y) {
+            const float* row = values + z * strideZ + y * strideY;
+            for (int x = 0; x + 1 < size.x; ++x) {
+                // corner i is offset by (i & 1, (i >> 1) & 1, (i >> 2) & 1)
+                float corners[8];
+                int mask = 0;
+                for (int i = 0; i < 8; ++i) {
+                    corners[i] = row[((i >> 2) & 1) * strideZ + ((i >> 1) & 1) * strideY + x + (i & 1)];
+                    if (corners[i] >= isoValue)
+                        mask |= 1 << i;
+                }
+                if (mask == 0 || mask == 255)
+                    continue;
+
+                // mean of all edge crossings
+                Vec3 sum;
+                int numCrossings = 0;
+                for (int a = 0; a < 8; ++a) {
+                    for (int bit = 1; bit < 8; bit <<= 1) {
+                        int b = a | bit;
+                        if ((a & bit) || ((mask >> a) & 1) == ((mask >> b) & 1))
+                            continue;
+                        float t = (isoValue - corners[a]) / (corners[b] - corners[a]);
+                        Vec3 pa(static_cast<float>(a & 1), static_cast<float>((a >> 1) & 1), static_cast<float>((a >> 2) & 1));
+                        Vec3 pb(static_cast<float>(b & 1), static_cast<float>((b >> 1) & 1), static_cast<float>((b >> 2) & 1));
+                        sum = sum + pa + (pb - pa) * t;
+                        numCrossings++;
+                    }
+                }
+
+                const int cx = offset.x + x;
+                const int cy = offset.y + y;
+                const int cz = offset.z + z;
+                Vertex vertex;
+                vertex.cellId = (static_cast<size_t>(cz) * cellDims.y + cy) * cellDims.x + cx;
+                vertex.position = Vec3(static_cast<float>(cx), static_cast<float>(cy), static_cast<float>(cz))
+                                  + sum * (1.0f / static_cast<float>(numCrossings));
+                vertices.push_back(vertex);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void BrickLayout::getBrick(size_t brick, IVec3& offset, IVec3& size) const {
+    const int bx = static_cast<int>(brick % numBricks.x);
+    const int by = static_cast<int>((brick / numBricks.x) % numBricks.y);
+    const int bz = static_cast<int>(brick / (static_cast<size_t>(numBricks.x) * numBricks.y));
+    offset = IVec3(bx * brickSize, by * brickSize, bz * brickSize);
+    size = IVec3(std::min(brickSize, gridDims.x - 1 - offset.x) + 1,
+                 std::min(brickSize, gridDims.y - 1 - offset.y) + 1,
+                 std::min(brickSize, gridDims.z - 1 - offset.z) + 1);
+}
+
+BrickLayout SurfaceNets::getLayout(const IVec3& gridDims, const Settings& settings) {
+    BrickLayout layout;
+    layout.gridDims = gridDims;
+    if (gridDims.x < 2 || gridDims.y < 2 || gridDims.z < 2)
+        return layout;
+
+    int size = MAX_BRICK_SIZE;
+    while (size > MIN_BRICK_SIZE && getBrickBytes(size, settings) > settings.memoryBudget)
+        size /= 2;
+    layout.brickSize = size;
+    layout.numBricks = IVec3((gridDims.x - 2) / size + 1, (gridDims.y - 2) / size + 1, (gridDims.z - 2) / size + 1);
+
+    size_t numThreads = settings.numThreads;
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t fitting = settings.memoryBudget / getBrickBytes(size, settings);
+    layout.numThreads = std::max<size_t>(1, std::min(std::min(numThreads, fitting), layout.getNumBricks()));
+    return layout;
+}
+
+bool SurfaceNets::summarize(const BrickLayout& layout, const BrickReader& read, BrickSummary& summary) {
+    const size_t numBricks = layout.getNumBricks();
+    summary.gridDims = layout.gridDims;
+    summary.brickSize = layout.brickSize;
+    summary.minimum.assign(numBricks, 0.0f);
+    summary.maximum.assign(numBricks, 0.0f);
+
+    ThreadPool& pool = ThreadPool::getShared();
+    std::vector<std::vector<float> > buffers(pool.getNumThreads());
+    std::atomic<bool> failed(false);
+    pool.parallelFor(numBricks, [&](size_t brick, size_t thread) {
+        if (failed)
+            return;
+        IVec3 offset, size;
+        layout.getBrick(brick, offset, size);
+        std::vector<float>& values = buffers[thread];
+        values.resize(static_cast<size_t>(size.x) * size.y * size.z);
+        if (!read(offset, size, &values[0])) {
+            failed = true;
+            return;
+        }
+        getRange(&values[0], values.size(), summary.minimum[brick], summary.maximum[brick]);
+    }, layout.numThreads);
+
+    if (failed) {
+        summary = BrickSummary();
+        return false;
+    }
+    return true;
+}
+
+SurfaceNets::SurfaceNets()
+    : numBricksRead_(0)
+    , numBricksSkipped_(0)
+{
+}
+
+void SurfaceNets::clear() {
+    positions_.clear();
+    cellIds_.clear();
+    numBricksRead_ = 0;
+    numBricksSkipped_ = 0;
+}
+
+bool SurfaceNets::extract(const BrickLayout& layout, const BrickReader& read, float isoValue, const BrickSummary* summary) {
+    clear();
+    const size_t numBricks = layout.getNumBricks();
+    if (numBricks == 0)
+        return true;
+    if (summary && !summary->matches(layout))
+        summary = 0;
+    const IVec3 cellDims(layout.gridDims.x - 1, layout.gridDims.y - 1, layout.gridDims.z - 1);
+
+    // every thread collects the vertices of its bricks, they are sorted by cell afterwards
+    ThreadPool& pool = ThreadPool::getShared();
+    std::vector<std::vector<float> > buffers(pool.getNumThreads());
+    std::vector<std::vector<Vertex> > threadVertices(pool.getNumThreads());
+    std::atomic<bool> failed(false);
+    std::atomic<size_t> numRead(0);
+    pool.parallelFor(numBricks, [&](size_t brick, size_t thread) {
+        if (failed || (summary && !summary->mayContain(brick, isoValue)))
+            return;
+        IVec3 offset, size;
+        layout.getBrick(brick, offset, size);
+        std::vector<float>& values = buffers[thread];
+        values.resize(static_cast<size_t>(size.x) * size.y * size.z);
+        if (!read(offset, size, &values[0])) {
+            failed = true;
+            return;
+        }
+        numRead++;
+
+        float minimum, maximum;
+        getRange(&values[0], values.size(), minimum, maximum);
+        if (minimum < isoValue && maximum >= isoValue)
+            extractBrick(&values[0], offset, size, cellDims, isoValue, threadVertices[thread]);
+    }, layout.numThreads);
+    buffers.clear();
+    numBricksRead_ = numRead;
+    numBricksSkipped_ = numBricks - numBricksRead_;
+    if (failed) {
+        numBricksSkipped_ = 0;
+        return false;
+    }
+
+    // the cells of a layer of bricks are a contiguous range of cell ids, so sorting the layers one by one sorts all
+    const size_t numLayers = static_cast<size_t>(layout.numBricks.z);
+    const size_t layerCells = static_cast<size_t>(cellDims.x) * cellDims.y * layout.brickSize;
+    std::vector<size_t> layerStart(numLayers + 1, 0);
+    for (size_t t = 0; t < threadVertices.size(); ++t)
+        for (size_t v = 0; v < threadVertices[t].size(); ++v)
+            layerStart[threadVertices[t][v].cellId / layerCells + 1]++;
+    for (size_t l = 0; l < numLayers; ++l)
+        layerStart[l + 1] += layerStart[l];
+
+    std::vector<Vertex> vertices(layerStart[numLayers]);
+    std::vector<size_t> fill(layerStart.begin(), layerStart.end() - 1);
+    for (size_t t = 0; t < threadVertices.size(); ++t) {
+        for (size_t v = 0; v < threadVertices[t].size(); ++v)
+            vertices[fill[threadVertices[t][v].cellId / layerCells]++] = threadVertices[t][v];
+        std::vector<Vertex>().swap(threadVertices[t]);
+    }
+
+    positions_.resize(vertices.size());
+    cellIds_.resize(vertices.size());
+    pool.parallelFor(numLayers, [&](size_t layer, size_t) {
+        std::sort(vertices.begin() + layerStart[layer], vertices.begin() + layerStart[layer + 1]);
+        for (size_t v = layerStart[layer]; v < layerStart[layer + 1]; ++v) {
+            positions_[v] = vertices[v].position;
+            cellIds_[v] = vertices[v].cellId;
+        }
+    });
+    return true;
+}
+
+} // namespace poitools
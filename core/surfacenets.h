@@ -0,0 +1,125 @@
+#ifndef POITOOLS_CORE_SURFACENETS_H
+#define POITOOLS_CORE_SURFACENETS_H
+
+#include "types.h"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace poitools {
+
+/**
+ * Reads the samples [offset, offset + size) of a sample grid into values,
+ * x fastest, as normalized intensities. Called concurrently for different
+ * bricks, returns false if the samples cannot be read.
+ */
+typedef std::function<bool(const IVec3& offset, const IVec3& size, float* values)> BrickReader;
+
+/**
+ * Division of a sample grid into bricks of brickSize^3 cells. Neighboring
+ * bricks share their boundary samples, so every cell lies in exactly one brick.
+ */
+struct BrickLayout {
+    BrickLayout() : brickSize(0), numThreads(1) {}
+
+    IVec3 gridDims;     ///< samples of the grid, the last brick of each row may be smaller
+    IVec3 numBricks;
+    int brickSize;      ///< cells per brick edge
+    size_t numThreads;  ///< bricks read at the same time
+
+    size_t getNumBricks() const { return static_cast<size_t>(numBricks.x) * numBricks.y * numBricks.z; }
+
+    /// First sample and number of samples of brick, including the shared boundary.
+    void getBrick(size_t brick, IVec3& offset, IVec3& size) const;
+};
+
+/**
+ * Value range of every brick of a layout. It does not depend on the iso
+ * value, so it is computed once per volume and lets every later extraction
+ * skip the bricks the surface does not cross without reading them.
+ */
+struct BrickSummary {
+    BrickSummary() : brickSize(0) {}
+
+    /// True if it has been computed for a layout with these grid and brick sizes.
+    bool matches(const BrickLayout& layout) const { return gridDims == layout.gridDims && brickSize == layout.brickSize; }
+
+    /// True if the iso surface may cross brick, i.e. it has values on both sides of isoValue.
+    bool mayContain(size_t brick, float isoValue) const { return minimum[brick] < isoValue && maximum[brick] >= isoValue; }
+
+    size_t getMemoryUsage() const { return (minimum.capacity() + maximum.capacity()) * sizeof(float); }
+
+    IVec3 gridDims;
+    int brickSize;
+    std::vector<float> minimum;
+    std::vector<float> maximum;
+};
+
+/**
+ * Surface nets vertices of a sample grid, extracted brick by brick.
+ *
+ * Every cell that is crossed by the iso surface gets one vertex at the mean
+ * of its edge crossings. The bricks are read through a BrickReader, e.g.
+ * from a volume on disk, on the shared thread pool, and only as many bricks
+ * are held in memory at a time as fit into the memory budget. So the memory
+ * needed depends on the budget and the size of the surface, not on the size
+ * of the volume. The result is a compact list of vertices sorted by their
+ * cell, from which the surface graph is built.
+ */
+class SurfaceNets {
+public:
+    struct Settings {
+        Settings() : isoValue(0.5f), memoryBudget(size_t(256) << 20), readerBytesPerSample(0), numThreads(0) {}
+
+        float isoValue;                 ///< normalized intensity
+        size_t memoryBudget;            ///< bytes of all bricks in flight, including those of the reader
+        size_t readerBytesPerSample;    ///< memory the reader needs per sample of a brick, e.g. for loading it from disk
+        size_t numThreads;              ///< at most, 0 means one per core
+    };
+
+    /**
+     * Largest bricks that fit into the budget, at most 64^3 cells, and as
+     * many bricks in flight as threads and budget allow. At least one brick
+     * of 8^3 cells is read at a time, whatever the budget.
+     */
+    static BrickLayout getLayout(const IVec3& gridDims, const Settings& settings);
+
+    /**
+     * Reads every brick once and records its value range.
+     *
+     * @return false if a brick cannot be read
+     */
+    static bool summarize(const BrickLayout& layout, const BrickReader& read, BrickSummary& summary);
+
+    SurfaceNets();
+
+    /**
+     * Extracts the vertices, replacing the previous ones.
+     *
+     * @param summary if it matches layout, the bricks the surface does not cross are not read
+     * @return false if a brick cannot be read, the result is empty then
+     */
+    bool extract(const BrickLayout& layout, const BrickReader& read, float isoValue, const BrickSummary* summary = 0);
+
+    void clear();
+
+    /// Vertex positions in grid coordinates, i.e. (1, 0, 0) is the second sample.
+    const std::vector<Vec3>& getPositions() const { return positions_; }
+
+    /// Linear index (x fastest) of the cell of every vertex, ascending.
+    const std::vector<size_t>& getCellIds() const { return cellIds_; }
+
+    size_t getNumBricksRead() const { return numBricksRead_; }
+    size_t getNumBricksSkipped() const { return numBricksSkipped_; }
+
+private:
+    std::vector<Vec3> positions_;
+    std::vector<size_t> cellIds_;
+    size_t numBricksRead_;
+    size_t numBricksSkipped_;
+};
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_SURFACENETS_H
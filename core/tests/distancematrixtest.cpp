@@ -0,0 +1,75 @@
+#include "test.h"
+
+#include "distancematrix.h"
+
+#include <atomic>
+
+using namespace poitools;
+
+namespace {
+
+void checkEuclidean(const DistanceMatrix& matrix, const std::vector<Vec3>& points) {
+    CHECK(matrix.getSize() == points.size());
+    for (size_t i = 0; i < matrix.getSize(); ++i)
+        for (size_t j = 0; j < matrix.getSize(); ++j)
+            CHECK_NEAR(matrix.get(i, j), distance(points[i], points[j]), 1e-5);
+}
+
+} // namespace
+
+POITOOLS_TEST(distancematrix, incremental) {
+    ThreadPool pool(4);
+    DistanceMatrix matrix;
+    std::vector<Vec3> points;
+    for (int i = 0; i < 6; ++i)
+        points.push_back(Vec3(static_cast<float>(i), static_cast<float>(i * i), 1.0f));
+
+    CHECK(matrix.update(points, euclideanRows(points), pool));
+    CHECK(matrix.getNumComputed() == 6);
+    checkEuclidean(matrix, points);
+
+    // appending computes one row, removing the last point none
+    points.push_back(Vec3(-3.0f, 2.0f, 0.5f));
+    CHECK(matrix.update(points, euclideanRows(points), pool));
+    CHECK(matrix.getNumComputed() == 1);
+    checkEuclidean(matrix, points);
+
+    points.pop_back();
+    CHECK(matrix.update(points, euclideanRows(points), pool));
+    CHECK(matrix.getNumComputed() == 0);
+    checkEuclidean(matrix, points);
+
+    // a moved point invalidates the rows from it on
+    points[2] = Vec3(7.0f, 7.0f, 7.0f);
+    CHECK(matrix.update(points, euclideanRows(points), pool));
+    CHECK(matrix.getNumComputed() == 4);
+    checkEuclidean(matrix, points);
+}
+
+POITOOLS_TEST(distancematrix, cancel) {
+    ThreadPool pool(2);
+    DistanceMatrix matrix;
+    std::vector<Vec3> points(3, Vec3(1.0f, 2.0f, 3.0f));
+    points[1] = Vec3();
+    CHECK(matrix.update(points, euclideanRows(points), pool));
+
+    // a cancelled update keeps the rows that were valid before
+    std::vector<Vec3> more = points;
+    for (int i = 0; i < 20; ++i)
+        more.push_back(Vec3(static_cast<float>(i), 0.0f, 0.0f));
+    std::atomic<int> numRows(0);
+    const DistanceMatrix::RowFunction rows = euclideanRows(more);
+    const bool done = matrix.update(more, [&](size_t source, size_t thread, float* row) {
+        numRows++;
+        rows(source, thread, row);
+    }, pool, [&numRows]() { return numRows > 5; });
+    CHECK(!done);
+    checkEuclidean(matrix, points);
+
+    CHECK(matrix.update(more, euclideanRows(more), pool));
+    CHECK(matrix.getNumComputed() == 20);
+    checkEuclidean(matrix, more);
+
+    matrix.clear();
+    CHECK(matrix.getSize() == 0);
+}
@@ -0,0 +1,147 @@
+#include "test.h"
+
+#include "journal.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+using namespace poitools;
+
+namespace {
+
+std::vector<float> getPoint(float x, float y, float z) {
+    std::vector<float> values;
+    values.push_back(x);
+    values.push_back(y);
+    values.push_back(z);
+    return values;
+}
+
+std::vector<char> readFile(const std::string& path) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::vector<char>& data) {
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(data.empty() ? "" : &data[0], data.size());
+}
+
+} // namespace
+
+POITOOLS_TEST(journal, replay) {
+    const std::string path = test::getTempPath("replay.poij");
+    std::remove(path.c_str());
+    std::vector<JournalRecord> records;
+    long long validLength = -1;
+    CHECK(readJournal(path, records, &validLength));
+    CHECK(records.empty() && validLength == 0);
+
+    JournalWriter writer;
+    CHECK(writer.open(path, validLength));
+    writer.append(JournalRecord(POINT_ADD, getPoint(1.0f, 2.0f, 3.0f)));
+    writer.append(JournalRecord(POINT_ADD, getPoint(4.0f, 5.0f, 6.0f)));
+    writer.append(JournalRecord(POINT_ADD, getPoint(7.0f, 8.0f, 9.0f)));
+    writer.append(JournalRecord(POINT_REMOVE, std::vector<float>(1, 0.0f)));
+    writer.append(JournalRecord(POINT_ADD, getPoint(-1.0f, -2.0f, -3.0f)));
+    writer.append(JournalRecord(POINT_UNDO, std::vector<float>()));
+    writer.flush();
+    CHECK(!writer.hasFailed());
+    writer.close();
+
+    CHECK(readJournal(path, records, &validLength));
+    CHECK(records.size() == 6);
+    CHECK(validLength == static_cast<long long>(readFile(path).size()));
+    std::vector<Vec3> points = replayPoints(records);
+    CHECK(points.size() == 2);
+    if (points.size() == 2) {
+        CHECK(points[0] == Vec3(4.0f, 5.0f, 6.0f));
+        CHECK(points[1] == Vec3(7.0f, 8.0f, 9.0f));
+    }
+
+    // appending goes on behind the existing records
+    CHECK(writer.open(path, validLength));
+    writer.append(JournalRecord(POINT_CLEAR, std::vector<float>()));
+    writer.append(JournalRecord(POINT_ADD, getPoint(0.5f, 0.5f, 0.5f)));
+    writer.close();
+    CHECK(readJournal(path, records));
+    CHECK(records.size() == 8);
+    points = replayPoints(records);
+    CHECK(points.size() == 1 && points[0] == Vec3(0.5f, 0.5f, 0.5f));
+    std::remove(path.c_str());
+}
+
+POITOOLS_TEST(journal, tornRecord) {
+    const std::string path = test::getTempPath("torn.poij");
+    std::remove(path.c_str());
+    JournalWriter writer;
+    CHECK(writer.open(path, 0));
+    for (int i = 0; i < 4; ++i)
+        writer.append(JournalRecord(POINT_ADD, getPoint(static_cast<float>(i), 0.0f, 0.0f)));
+    writer.close();
+    const std::vector<char> intact = readFile(path);
+
+    // a write interrupted by a crash leaves part of the last record
+    std::vector<char> torn(intact.begin(), intact.end() - 5);
+    writeFile(path, torn);
+    std::vector<JournalRecord> records;
+    long long validLength = 0;
+    CHECK(readJournal(path, records, &validLength));
+    CHECK(records.size() == 3);
+    CHECK(validLength == static_cast<long long>(intact.size()) - 24);
+
+    // the torn tail is cut off when the journal is opened again, so new records can be read
+    CHECK(writer.open(path, validLength));
+    writer.append(JournalRecord(POINT_ADD, getPoint(9.0f, 9.0f, 9.0f)));
+    writer.close();
+    CHECK(readJournal(path, records));
+    CHECK(records.size() == 4);
+    CHECK(replayPoints(records).back() == Vec3(9.0f, 9.0f, 9.0f));
+
+    // a flipped bit ends the journal at the corrupt record
+    std::vector<char> corrupt = intact;
+    corrupt[8 + 24 + 12] ^= 0x10;
+    writeFile(path, corrupt);
+    CHECK(readJournal(path, records, &validLength));
+    CHECK(records.size() == 1);
+    CHECK(validLength == 8 + 24);
+
+    // a record claiming more values than the file holds
+    corrupt = intact;
+    corrupt[8 + 4] = 0x7f;
+    writeFile(path, corrupt);
+    CHECK(readJournal(path, records));
+    CHECK(records.empty());
+
+    // other files are not taken for a journal
+    writeFile(path, std::vector<char>(20, 'x'));
+    CHECK(!readJournal(path, records));
+    std::remove(path.c_str());
+}
+
+POITOOLS_TEST(journal, measurement) {
+    std::vector<float> segments;
+    segments.push_back(1.5f);
+    segments.push_back(2.5f);
+    std::vector<Vec3> path;
+    path.push_back(Vec3(0.0f, 0.0f, 0.0f));
+    path.push_back(Vec3(1.0f, 2.0f, 3.0f));
+    path.push_back(Vec3(4.0f, 5.0f, 6.0f));
+
+    std::vector<JournalRecord> records;
+    records.push_back(encodeMeasurement(1.0f, std::vector<float>(), std::vector<Vec3>()));
+    records.push_back(encodeMeasurement(4.0f, segments, path));
+    float dist = 0.0f;
+    std::vector<float> readSegments;
+    std::vector<Vec3> readPath;
+    CHECK(replayMeasurement(records, dist, readSegments, readPath));
+    CHECK(dist == 4.0f);
+    CHECK(readSegments == segments);
+    CHECK(readPath.size() == path.size());
+    for (size_t i = 0; i < path.size() && i < readPath.size(); ++i)
+        CHECK(readPath[i] == path[i]);
+
+    records.push_back(JournalRecord(MEASURE_CLEAR, std::vector<float>()));
+    CHECK(!replayMeasurement(records, dist, readSegments, readPath));
+}
@@ -0,0 +1,52 @@
+#include "test.h"
+
+#include "landmarks.h"
+
+#include <cstdio>
+#include <sstream>
+
+using namespace poitools;
+
+POITOOLS_TEST(landmarks, parse) {
+    // empty lines are skipped, windows line ends and a missing last line end are tolerated
+    std::istringstream in("nasion\n\nsella\r\n  left porion \r\n\r\nmenton");
+    const std::vector<std::string> names = readLandmarkTemplate(in);
+    CHECK(names.size() == 4);
+    if (names.size() == 4) {
+        CHECK(names[0] == "nasion");
+        CHECK(names[1] == "sella");
+        CHECK(names[2] == "  left porion ");
+        CHECK(names[3] == "menton");
+    }
+
+    std::istringstream empty("\n\r\n");
+    CHECK(readLandmarkTemplate(empty).empty());
+}
+
+POITOOLS_TEST(landmarks, files) {
+    const std::string path = test::getTempPath("template.txt");
+    std::vector<std::string> names(1, "untouched");
+    CHECK(!readLandmarkTemplate(path + ".missing", names));
+    CHECK(names.size() == 1 && names[0] == "untouched");
+
+    // the points are written with enough digits to read back the same floats
+    std::vector<Vec3> points;
+    points.push_back(Vec3(1.0f, -2.5f, 0.1f));
+    points.push_back(Vec3(123.456789f, 1e-7f, -98765.4321f));
+    CHECK(writeLandmarks(path, points));
+    std::FILE* file = std::fopen(path.c_str(), "r");
+    CHECK(file != 0);
+    if (file) {
+        for (size_t i = 0; i < points.size(); ++i) {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            CHECK(std::fscanf(file, "%f %f %f", &x, &y, &z) == 3);
+            CHECK(Vec3(x, y, z) == points[i]);
+        }
+        std::fclose(file);
+    }
+
+    // a template is read line by line, every written line is one landmark
+    CHECK(readLandmarkTemplate(path, names));
+    CHECK(names.size() == points.size());
+    std::remove(path.c_str());
+}
@@ -0,0 +1,83 @@
+#include "test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace poitools {
+namespace test {
+
+namespace {
+
+struct Test {
+    const char* group;
+    const char* name;
+    TestFunction function;
+};
+
+/// Constructed on first use, the registrations run before main().
+std::vector<Test>& getTests() {
+    static std::vector<Test> tests;
+    return tests;
+}
+
+int numFailures = 0;
+
+} // namespace
+
+Registration::Registration(const char* group, const char* name, TestFunction function) {
+    Test test = { group, name, function };
+    getTests().push_back(test);
+}
+
+void fail(const char* file, int line, const std::string& message) {
+    std::cerr << file << ":" << line << ": check failed: " << message << std::endl;
+    numFailures++;
+}
+
+std::string getTempPath(const std::string& name) {
+    const char* dir = std::getenv("TMPDIR");
+#ifdef _WIN32
+    if (!dir)
+        dir = std::getenv("TEMP");
+#endif
+    std::ostringstream path;
+    path << (dir ? dir : "/tmp") << "/poitoolstests_" << getpid() << "_" << name;
+    return path.str();
+}
+
+} // namespace test
+} // namespace poitools
+
+/// Runs the tests of the groups given as arguments, all without arguments.
+int main(int argc, char** argv) {
+    using namespace poitools::test;
+    int numRun = 0;
+    const std::vector<Test>& tests = getTests();
+    for (size_t i = 0; i < tests.size(); ++i) {
+        bool selected = argc < 2;
+        for (int a = 1; a < argc; ++a)
+            selected = selected || std::string(argv[a]) == tests[i].group;
+        if (!selected)
+            continue;
+
+        const int failuresBefore = numFailures;
+        tests[i].function();
+        std::cout << (numFailures == failuresBefore ? "passed " : "FAILED ") << tests[i].group << "." << tests[i].name << std::endl;
+        numRun++;
+    }
+
+    if (numRun == 0) {
+        std::cerr << "no tests selected" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return numFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
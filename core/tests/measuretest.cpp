@@ -0,0 +1,181 @@
+#include "test.h"
+
+#include "legacy.h"
+#include "measure.h"
+#include "synthetic.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace poitools;
+
+namespace {
+
+/// Texture to world matrix of a volume of 200 x 160 x 120 mm, shifted away from the origin.
+Mat4 getTextureToWorld() {
+    Mat4 m;
+    m.m[0] = 200.0f;
+    m.m[5] = 160.0f;
+    m.m[10] = 120.0f;
+    m.m[3] = -40.0f;
+    m.m[7] = 15.0f;
+    m.m[11] = 3.0f;
+    return m;
+}
+
+/// Length of the step from pixel a to pixel b on the surface.
+float getStep(const FhpBuffer& fhp, const Mat4& textureToWorld, IVec2 a, IVec2 b) {
+    return distance(textureToWorld.transform(fhp.at(a)), textureToWorld.transform(fhp.at(b)));
+}
+
+} // namespace
+
+POITOOLS_TEST(measure, legacyAxisAligned) {
+    // along a screen axis or the diagonal both visit the same pixels, the original
+    // measureX()/measureY() only starts at the second pixel
+    const SyntheticFhp surface(SyntheticFhp::HEAD, 256, 256);
+    const FhpBuffer fhp = surface.getBuffer();
+    const Mat4 textureToWorld = getTextureToWorld();
+    const IVec2 segments[][2] = {
+        { IVec2(60, 128), IVec2(190, 128) },
+        { IVec2(190, 100), IVec2(60, 100) },
+        { IVec2(128, 40), IVec2(128, 210) },
+        { IVec2(90, 200), IVec2(90, 70) },
+        { IVec2(70, 70), IVec2(180, 180) },
+        { IVec2(180, 80), IVec2(80, 180) }
+    };
+
+    PathSampler sampler;
+    for (size_t i = 0; i < sizeof(segments) / sizeof(segments[0]); ++i) {
+        const IVec2 start = segments[i][0];
+        const IVec2 end = segments[i][1];
+        std::vector<Vec3> legacyPath;
+        const float legacy = legacySurfaceDistance(fhp, textureToWorld, start, end, legacyPath);
+
+        // the legacy walk runs from the lower pixel on the walked axis
+        const bool alongX = std::abs(end.x - start.x) >= std::abs(end.y - start.y);
+        const int u = alongX ? 0 : 1;
+        const IVec2 first = start[u] < end[u] ? start : end;
+        IVec2 second = first;
+        second[u]++;
+        if (start.x != end.x && start.y != end.y)
+            second[1 - u] += (start[1 - u] < end[1 - u]) == (first == start) ? 1 : -1;
+
+        const float dist = sampler.measure(fhp, textureToWorld, start, end);
+        const float expected = legacy + getStep(fhp, textureToWorld, first, second);
+        CHECK_NEAR(dist, expected, 1e-5 * expected);
+        CHECK(sampler.getPath().size() == legacyPath.size() + 2);
+    }
+}
+
+POITOOLS_TEST(measure, legacySlopes) {
+    // on other slopes the midpoint rule picks other pixels than the truncation of the original
+    // math, the lengths on a smooth surface differ by little more than the skipped first step
+    const SyntheticFhp surface(SyntheticFhp::SPHERE, 256, 256);
+    const FhpBuffer fhp = surface.getBuffer();
+    const Mat4 textureToWorld = getTextureToWorld();
+
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> inside(80, 175);
+    PathSampler sampler;
+    for (int i = 0; i < 200; ++i) {
+        const IVec2 start(inside(random), inside(random));
+        const IVec2 end(inside(random), inside(random));
+        if (std::max(std::abs(end.x - start.x), std::abs(end.y - start.y)) < 4)
+            continue;
+        std::vector<Vec3> legacyPath;
+        const float legacy = legacySurfaceDistance(fhp, textureToWorld, start, end, legacyPath);
+        const float dist = sampler.measure(fhp, textureToWorld, start, end);
+        CHECK_NEAR(dist, legacy, 0.03 * legacy + 4.0);
+    }
+}
+
+POITOOLS_TEST(measure, background) {
+    // samples on the background are bridged, so a hole does not add the distance to the origin
+    const SyntheticFhp surface(SyntheticFhp::PLANE, 64, 64);
+    std::vector<float> pixels(surface.getBuffer().data, surface.getBuffer().data + 64 * 64 * 4);
+    std::fill(pixels.begin() + 4 * (32 * 64 + 20), pixels.begin() + 4 * (32 * 64 + 30), 0.0f);
+    const FhpBuffer holes(&pixels[0], 64, 64);
+    const Mat4 textureToWorld = getTextureToWorld();
+
+    PathSampler sampler;
+    const float full = sampler.measure(surface.getBuffer(), textureToWorld, IVec2(5, 32), IVec2(60, 32));
+    const float bridged = sampler.measure(holes, textureToWorld, IVec2(5, 32), IVec2(60, 32));
+    CHECK(sampler.getPath().size() == 56 - 10);
+    CHECK_NEAR(bridged, full, 1e-4 * full);
+
+    // a plane is measured as the straight line between the end pixels
+    const Vec3 a = textureToWorld.transform(surface.getBuffer().at(IVec2(5, 32)));
+    const Vec3 b = textureToWorld.transform(surface.getBuffer().at(IVec2(60, 32)));
+    CHECK_NEAR(full, distance(a, b), 1e-4 * full);
+
+    Vec3 world;
+    CHECK(!pickSurfacePoint(holes, textureToWorld, IVec2(25, 32), world));
+    CHECK(pickSurfacePoint(holes, textureToWorld, IVec2(5, 32), world));
+    CHECK(world == a);
+    CHECK(pickSurfacePoints(holes, textureToWorld, std::vector<IVec2>(3, IVec2(25, 32))).empty());
+}
+
+POITOOLS_TEST(measure, walkerSeek) {
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> coordinate(-300, 300);
+    for (int i = 0; i < 2000; ++i) {
+        const IVec2 start(coordinate(random), coordinate(random));
+        const IVec2 end(coordinate(random), coordinate(random));
+        SegmentWalker walker(start, end);
+        SegmentWalker jumping(start, end);
+        for (int s = 0; s < walker.getNumSamples(); ++s, walker.next()) {
+            jumping.seek(s);
+            CHECK(jumping.getPixel() == walker.getPixel());
+            CHECK(jumping.getMinor() == walker.getMinor());
+        }
+
+        SegmentWalker longer(start, IVec2(2 * end.x - start.x, 2 * end.y - start.y));
+        CHECK(longer.sharesPrefix(SegmentWalker(start, end)));
+    }
+}
+
+POITOOLS_TEST(measure, update) {
+    // update() has to give the same path and length as measure() for any sequence of moves
+    const SyntheticFhp surface(SyntheticFhp::HEAD, 200, 200);
+    const FhpBuffer fhp = surface.getBuffer();
+    const Mat4 textureToWorld = getTextureToWorld();
+
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int> coordinate(0, 199);
+    std::uniform_int_distribution<int> jitter(-3, 3);
+    for (int bilinear = 0; bilinear < 2; ++bilinear) {
+        PathSampler incremental(bilinear != 0);
+        PathSampler reference(bilinear != 0);
+        IVec2 start(100, 100);
+        IVec2 end(100, 100);
+        for (int i = 0; i < 3000; ++i) {
+            switch (random() % 4) {
+            case 0:
+                end = IVec2(coordinate(random), coordinate(random));
+                break;
+            case 1:
+                // along the segment
+                end = IVec2(start.x + (end.x - start.x) * 3 / 2, start.y + (end.y - start.y) * 3 / 2);
+                if (random() % 2)
+                    end = IVec2(start.x + (end.x - start.x) / 2, start.y + (end.y - start.y) / 2);
+                break;
+            case 2:
+                end = IVec2(end.x + jitter(random), end.y + jitter(random));
+                break;
+            default:
+                if (random() % 10 == 0)
+                    start = IVec2(coordinate(random), coordinate(random));
+                break;
+            }
+            end = IVec2(std::min(std::max(end.x, 0), 199), std::min(std::max(end.y, 0), 199));
+
+            const float dist = incremental.update(fhp, textureToWorld, start, end);
+            const float expected = reference.measure(fhp, textureToWorld, start, end);
+            CHECK_NEAR(dist, expected, 1e-4 * expected + 1e-4);
+            CHECK(incremental.getPath().size() == reference.getPath().size());
+            for (size_t p = 0; p < incremental.getPath().size() && p < reference.getPath().size(); ++p)
+                CHECK_NEAR(distance(incremental.getPath()[p], reference.getPath()[p]), 0.0, 1e-3);
+        }
+    }
+}
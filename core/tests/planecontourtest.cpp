@@ -0,0 +1,91 @@
+#include "test.h"
+
+#include "planecontour.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+using namespace poitools;
+
+namespace {
+
+/// Oblique plane through the origin with a sample spacing of 0.5 mm, several bands high.
+PlaneContour::Grid getGrid() {
+    PlaneContour::Grid grid;
+    const float s = 0.5f / std::sqrt(2.0f);
+    grid.u = Vec3(s, s, 0.0f);
+    grid.v = Vec3(-0.3f, 0.3f, 0.4f * std::sqrt(2.0f)) * (0.5f / std::sqrt(0.5f));
+    grid.origin = grid.u * -80.0f + grid.v * -60.0f;
+    grid.width = 160;
+    grid.height = 120;
+    return grid;
+}
+
+} // namespace
+
+POITOOLS_TEST(planecontour, circles) {
+    // two balls cut through their centers give two closed circles of the analytic circumference
+    const PlaneContour::Grid grid = getGrid();
+    const Vec3 centers[2] = { grid.at(50.0f, 60.0f), grid.at(120.0f, 70.0f) };
+    const float radii[2] = { 20.0f, 12.0f };
+    ThreadPool pool(3);
+    std::atomic<bool> badThread(false);
+    PlaneContour contour;
+    const bool done = contour.extract(grid, 0.0f, [&](int j, size_t thread, float* values) {
+        if (thread >= pool.getNumThreads())
+            badThread = true;
+        for (int i = 0; i < grid.width; ++i) {
+            const Vec3 p = grid.at(static_cast<float>(i), static_cast<float>(j));
+            values[i] = std::max(radii[0] - distance(p, centers[0]), radii[1] - distance(p, centers[1]));
+        }
+    }, pool);
+    CHECK(done);
+    CHECK(!badThread);
+    CHECK(contour.getContours().size() == 2);
+
+    for (int c = 0; c < 2; ++c) {
+        const int nearest = contour.findNearest(centers[c]);
+        CHECK(nearest >= 0);
+        if (nearest < 0)
+            continue;
+        const PlaneContour::Contour& circle = contour.getContours()[nearest];
+        CHECK(circle.closed);
+        CHECK_NEAR(circle.length, 2.0 * 3.14159265 * radii[c], 0.005 * 2.0 * 3.14159265 * radii[c]);
+        for (size_t p = 0; p < circle.points.size(); ++p)
+            CHECK_NEAR(distance(circle.points[p], centers[c]), radii[c], 0.05);
+    }
+    CHECK(contour.findNearest(centers[0]) != contour.findNearest(centers[1]));
+}
+
+POITOOLS_TEST(planecontour, open) {
+    // a region reaching over the border of the grid is cut open there
+    const PlaneContour::Grid grid = getGrid();
+    ThreadPool pool(2);
+    PlaneContour contour;
+    contour.extract(grid, 30.5f, [&](int, size_t, float* values) {
+        for (int i = 0; i < grid.width; ++i)
+            values[i] = static_cast<float>(i);
+    }, pool);
+    CHECK(contour.getContours().size() == 1);
+    if (contour.getContours().size() == 1) {
+        const PlaneContour::Contour& line = contour.getContours()[0];
+        CHECK(!line.closed);
+        CHECK(line.points.size() == static_cast<size_t>(grid.height));
+        CHECK_NEAR(line.length, (grid.height - 1) * length(grid.v), 1e-3);
+    }
+}
+
+POITOOLS_TEST(planecontour, cancel) {
+    const PlaneContour::Grid grid = getGrid();
+    ThreadPool pool(2);
+    PlaneContour contour;
+    std::atomic<int> rows(0);
+    const bool done = contour.extract(grid, 0.0f, [&](int, size_t, float* values) {
+        rows++;
+        std::fill(values, values + grid.width, -1.0f);
+        values[grid.width / 2] = 1.0f;
+    }, pool, [&]() { return rows > 40; });
+    CHECK(!done);
+    CHECK(contour.getContours().empty());
+}
@@ -0,0 +1,93 @@
+#include "test.h"
+
+#include "pointexport.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+using namespace poitools;
+
+POITOOLS_TEST(pointexport, binary) {
+    const std::string path = test::getTempPath("points.poix");
+    CHECK(getExportFormat(path) == EXPORT_BINARY);
+    std::vector<Vec3> longPath;
+    for (int i = 0; i < 100000; ++i)
+        longPath.push_back(Vec3(static_cast<float>(i), 0.5f * i, -0.25f * i));
+
+    PointExporter exporter;
+    CHECK(exporter.open(path, EXPORT_BINARY));
+    exporter.setGroup("subject 1");
+    exporter.writePoint("nasion", Vec3(1.0f, 2.0f, 3.0f));
+    exporter.writePath("circumference", 42.5f, longPath);
+    exporter.setGroup("subject 2");
+    exporter.writePoint("nasion", Vec3(-1.0f, -2.0f, -3.0f));
+    exporter.writePath("empty", 0.0f, std::vector<Vec3>());
+
+    // an export that has not been closed is not read
+    std::vector<ExportRecord> records;
+    CHECK(!readPointExport(path, records));
+    CHECK(exporter.close());
+
+    CHECK(readPointExport(path, records));
+    CHECK(records.size() == 4);
+    if (records.size() == 4) {
+        CHECK(records[0].type == EXPORT_POINT && records[0].group == "subject 1" && records[0].label == "nasion");
+        CHECK(records[0].points.size() == 1 && records[0].points[0] == Vec3(1.0f, 2.0f, 3.0f));
+        CHECK(records[1].type == EXPORT_PATH && records[1].label == "circumference" && records[1].value == 42.5f);
+        CHECK(records[1].points.size() == longPath.size());
+        CHECK(records[1].points.size() == longPath.size() && records[1].points.back() == longPath.back());
+        CHECK(records[2].group == "subject 2" && records[2].points[0] == Vec3(-1.0f, -2.0f, -3.0f));
+        CHECK(records[3].type == EXPORT_PATH && records[3].points.empty());
+    }
+    std::remove(path.c_str());
+}
+
+POITOOLS_TEST(pointexport, csv) {
+    const std::string path = test::getTempPath("points.csv");
+    CHECK(getExportFormat(path) == EXPORT_CSV);
+
+    // values that exercise the float formatting: exponents, rounding at 9 digits, negative zero
+    std::mt19937 random(23);
+    std::uniform_real_distribution<float> mantissa(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> exponent(-30, 30);
+    std::vector<Vec3> points;
+    points.push_back(Vec3(0.0f, -0.0f, 1.0f));
+    points.push_back(Vec3(123456789.0f, 0.1f, 1e-5f));
+    points.push_back(Vec3(999999999.0f, 9.99999999e-3f, -3.4028235e38f));
+    for (int i = 0; i < 2000; ++i)
+        points.push_back(Vec3(std::ldexp(mantissa(random), exponent(random)), std::ldexp(mantissa(random), exponent(random)),
+                              std::ldexp(mantissa(random), exponent(random))));
+
+    PointExporter exporter;
+    CHECK(exporter.open(path, EXPORT_CSV));
+    exporter.setGroup("scan, \"left\"");
+    exporter.writePoint("nasion", points[0]);
+    exporter.writePath("path", 12.75f, points);
+    CHECK(exporter.close());
+
+    std::ifstream file(path.c_str());
+    std::string line;
+    CHECK(std::getline(file, line) && line == "group,label,type,value,index,x,y,z");
+    CHECK(std::getline(file, line) && line == "\"scan, \"\"left\"\"\",nasion,point,0,0,0,-0,1");
+    for (size_t i = 0; i < points.size(); ++i) {
+        CHECK(std::getline(file, line));
+        const std::string prefix = "\"scan, \"\"left\"\"\",path,path,12.75,";
+        CHECK(line.compare(0, prefix.size(), prefix) == 0);
+
+        // every value reads back as the same float
+        std::istringstream fields(line.substr(prefix.size()));
+        std::string index, x, y, z;
+        std::getline(fields, index, ',');
+        std::getline(fields, x, ',');
+        std::getline(fields, y, ',');
+        std::getline(fields, z, ',');
+        CHECK(std::strtoul(index.c_str(), 0, 10) == i);
+        CHECK(Vec3(std::strtof(x.c_str(), 0), std::strtof(y.c_str(), 0), std::strtof(z.c_str(), 0)) == points[i]);
+    }
+    CHECK(!std::getline(file, line));
+    file.close();
+    std::remove(path.c_str());
+}
@@ -0,0 +1,75 @@
+#include "test.h"
+
+#include "pointindex.h"
+
+#include <limits>
+#include <random>
+
+using namespace poitools;
+
+namespace {
+
+/// Brute force nearest point of the live points, returns false if none is within maxDistance.
+bool findNearest(const std::vector<Vec3>& points, const std::vector<bool>& live, const Vec3& pos, float maxDistance,
+                 size_t& id, float& dist)
+{
+    dist = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (live[i] && distance(points[i], pos) < dist) {
+            dist = distance(points[i], pos);
+            id = i;
+        }
+    }
+    return dist <= maxDistance;
+}
+
+} // namespace
+
+POITOOLS_TEST(pointindex, nearest) {
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+    PointIndex index(4.0f);
+    std::vector<Vec3> points;
+    std::vector<bool> live;
+    size_t numLive = 0;
+
+    for (int step = 0; step < 3000; ++step) {
+        const unsigned int action = random() % 10;
+        if (action < 5 || numLive == 0) {
+            points.push_back(Vec3(coordinate(random), coordinate(random), coordinate(random)));
+            live.push_back(true);
+            index.insert(points.size() - 1, points.back());
+            numLive++;
+        } else if (action < 7) {
+            const size_t id = random() % points.size();
+            CHECK(index.remove(id, points[id]) == live[id]);
+            if (live[id])
+                numLive--;
+            live[id] = false;
+        } else {
+            // radii below and far above the cell size
+            const Vec3 pos(coordinate(random), coordinate(random), coordinate(random));
+            const float maxDistance = action == 7 ? 2.0f : (action == 8 ? 15.0f : 1000.0f);
+            size_t expectedId = 0, id = 0;
+            float expected = 0.0f, dist = -1.0f;
+            const bool found = findNearest(points, live, pos, maxDistance, expectedId, expected);
+            CHECK(index.findNearest(pos, maxDistance, id, &dist) == found);
+            if (found) {
+                CHECK(id == expectedId);
+                CHECK_NEAR(dist, expected, 1e-5);
+            }
+        }
+        CHECK(index.size() == numLive);
+
+        // a new cell size keeps the points
+        if (step == 1500) {
+            index.setCellSize(1.5f);
+            CHECK(index.size() == numLive);
+        }
+    }
+
+    index.clear();
+    size_t id = 0;
+    CHECK(index.size() == 0);
+    CHECK(!index.findNearest(Vec3(), 1000.0f, id));
+}
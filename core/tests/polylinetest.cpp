@@ -0,0 +1,52 @@
+#include "test.h"
+
+#include "polyline.h"
+
+#include <random>
+
+using namespace poitools;
+
+POITOOLS_TEST(polyline, kernels) {
+    // every instruction set gives the scalar result, for all tail lengths of the vector loops
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    Mat4 textureToWorld;
+    textureToWorld.m[0] = 200.0f;
+    textureToWorld.m[1] = 3.0f;
+    textureToWorld.m[5] = 160.0f;
+    textureToWorld.m[10] = 120.0f;
+    textureToWorld.m[3] = -40.0f;
+    textureToWorld.m[7] = 15.0f;
+    const SimdLevel supported = getSupportedSimdLevel();
+
+    for (size_t n = 0; n < 40; ++n) {
+        PointsSoA points;
+        for (size_t i = 0; i < n; ++i)
+            points.push_back(Vec3(value(random), value(random), value(random)));
+
+        // reference in double precision
+        double expectedLength = 0.0;
+        std::vector<Vec3> expected;
+        for (size_t i = 0; i < n; ++i) {
+            expected.push_back(textureToWorld.transform(points[i]));
+            if (i > 0)
+                expectedLength += distance(expected[i - 1], expected[i]);
+        }
+
+        for (int level = SIMD_SCALAR; level <= supported; ++level) {
+            setSimdLevel(static_cast<SimdLevel>(level));
+            PointsSoA world;
+            const float length = transformPolyline(textureToWorld, points, &world);
+            CHECK_NEAR(length, expectedLength, 1e-5 * expectedLength + 1e-4);
+            CHECK(world.size() == n);
+            for (size_t i = 0; i < n && i < world.size(); ++i)
+                CHECK_NEAR(distance(world[i], expected[i]), 0.0, 1e-4);
+            CHECK_NEAR(polylineLength(world), expectedLength, 1e-5 * expectedLength + 1e-4);
+
+            // in place
+            PointsSoA inPlace = points;
+            CHECK_NEAR(transformPolyline(textureToWorld, inPlace, &inPlace), length, 1e-5 * length);
+        }
+    }
+    setSimdLevel(supported);
+}
@@ -0,0 +1,103 @@
+#include "test.h"
+
+#include "surfacenets.h"
+
+#include <atomic>
+#include <cmath>
+
+using namespace poitools;
+
+namespace {
+
+const IVec3 GRID_DIMS(97, 70, 133);
+
+/// Two overlapping spheres in a grid that does not divide into whole bricks.
+bool readSpheres(const IVec3& offset, const IVec3& size, float* values) {
+    for (int z = 0; z < size.z; ++z) {
+        for (int y = 0; y < size.y; ++y) {
+            for (int x = 0; x < size.x; ++x) {
+                const Vec3 p((offset.x + x) / 96.0f, (offset.y + y) / 69.0f, (offset.z + z) / 132.0f);
+                const float a = length(p - Vec3(0.3f, 0.5f, 0.4f));
+                const float b = length(p - Vec3(0.6f, 0.45f, 0.6f));
+                *values++ = 1.0f - 4.0f * std::min(a, b);
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+POITOOLS_TEST(surfacenets, budgets) {
+    // the vertices must not depend on how the grid is split into bricks
+    SurfaceNets reference;
+    SurfaceNets::Settings unlimited;
+    unlimited.memoryBudget = size_t(1) << 40;
+    unlimited.numThreads = 1;
+    const BrickLayout single = SurfaceNets::getLayout(GRID_DIMS, unlimited);
+    CHECK(reference.extract(single, readSpheres, 0.5f));
+    CHECK(!reference.getPositions().empty());
+    CHECK(reference.getPositions().size() == reference.getCellIds().size());
+    for (size_t i = 1; i < reference.getCellIds().size(); ++i)
+        CHECK(reference.getCellIds()[i - 1] < reference.getCellIds()[i]);
+
+    const size_t budgets[] = { size_t(300000), size_t(20000), size_t(1000) };
+    for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); ++b) {
+        SurfaceNets::Settings settings;
+        settings.memoryBudget = budgets[b];
+        settings.readerBytesPerSample = 2;
+        settings.numThreads = 8;
+        const BrickLayout layout = SurfaceNets::getLayout(GRID_DIMS, settings);
+        CHECK(layout.brickSize >= 8 && layout.brickSize <= 64);
+        CHECK(layout.numThreads >= 1 && layout.numThreads <= 8);
+        CHECK(layout.numThreads == 1 || layout.numThreads * (layout.brickSize + 1) * (layout.brickSize + 1) * (layout.brickSize + 1) * 6 <= budgets[b]);
+
+        // bricks in flight at the same time stay within the layout
+        std::atomic<int> inFlight(0);
+        std::atomic<int> maxInFlight(0);
+        BrickReader counting = [&](const IVec3& offset, const IVec3& size, float* values) {
+            int n = ++inFlight;
+            int seen = maxInFlight;
+            while (n > seen && !maxInFlight.compare_exchange_weak(seen, n)) {}
+            bool ok = readSpheres(offset, size, values);
+            inFlight--;
+            return ok;
+        };
+
+        SurfaceNets nets;
+        CHECK(nets.extract(layout, counting, 0.5f));
+        CHECK(maxInFlight <= static_cast<int>(layout.numThreads));
+        CHECK(nets.getCellIds() == reference.getCellIds());
+        CHECK(nets.getPositions().size() == reference.getPositions().size());
+        for (size_t i = 0; i < nets.getPositions().size() && i < reference.getPositions().size(); ++i)
+            CHECK(nets.getPositions()[i] == reference.getPositions()[i]);
+
+        // with the value ranges of the bricks only the ones crossed by the surface are read
+        BrickSummary summary;
+        CHECK(SurfaceNets::summarize(layout, readSpheres, summary));
+        CHECK(summary.matches(layout));
+        SurfaceNets skipping;
+        CHECK(skipping.extract(layout, readSpheres, 0.5f, &summary));
+        CHECK(skipping.getCellIds() == reference.getCellIds());
+        CHECK(skipping.getNumBricksSkipped() > 0);
+        CHECK(skipping.getNumBricksRead() + skipping.getNumBricksSkipped() == layout.getNumBricks());
+    }
+}
+
+POITOOLS_TEST(surfacenets, readFailure) {
+    SurfaceNets::Settings settings;
+    settings.memoryBudget = 50000;
+    const BrickLayout layout = SurfaceNets::getLayout(GRID_DIMS, settings);
+    BrickReader failing = [](const IVec3& offset, const IVec3& size, float* values) {
+        return offset.z == 0 && readSpheres(offset, size, values);
+    };
+
+    SurfaceNets nets;
+    CHECK(nets.extract(layout, readSpheres, 0.5f));
+    CHECK(!nets.extract(layout, failing, 0.5f));
+    CHECK(nets.getPositions().empty() && nets.getCellIds().empty());
+
+    BrickSummary summary;
+    CHECK(!SurfaceNets::summarize(layout, failing, summary));
+    CHECK(!summary.matches(layout));
+}
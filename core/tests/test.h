@@ -0,0 +1,54 @@
+#ifndef POITOOLS_TESTS_TEST_H
+#define POITOOLS_TESTS_TEST_H
+
+#include <cmath>
+#include <sstream>
+#include <string>
+
+namespace poitools {
+namespace test {
+
+/**
+ * Minimal test harness of the measurement core, so the tests build wherever
+ * the core does, without a test framework.
+ *
+ * POITOOLS_TEST(group, name) defines and registers a test, poitoolstests runs
+ * the tests of the groups given on the command line, or all of them. A failed
+ * CHECK is reported and the test goes on, so one run shows all failures.
+ */
+typedef void (*TestFunction)();
+
+struct Registration {
+    Registration(const char* group, const char* name, TestFunction function);
+};
+
+void fail(const char* file, int line, const std::string& message);
+
+/// Path of a scratch file in the temp directory, unique to this process.
+std::string getTempPath(const std::string& name);
+
+} // namespace test
+} // namespace poitools
+
+#define POITOOLS_TEST(group, name) \
+    static void test_##group##_##name(); \
+    static const poitools::test::Registration registration_##group##_##name(#group, #name, &test_##group##_##name); \
+    static void test_##group##_##name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+            poitools::test::fail(__FILE__, __LINE__, #condition); \
+    } while (false)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        const double a_ = (actual), e_ = (expected); \
+        if (!(std::fabs(a_ - e_) <= (tolerance))) { \
+            std::ostringstream message_; \
+            message_ << #actual << " is " << a_ << ", expected " << e_ << " +- " << (tolerance); \
+            poitools::test::fail(__FILE__, __LINE__, message_.str()); \
+        } \
+    } while (false)
+
+#endif // POITOOLS_TESTS_TEST_H
@@ -0,0 +1,96 @@
+#include "test.h"
+
+#include "threadpool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace poitools;
+
+POITOOLS_TEST(threadpool, parallelFor) {
+    ThreadPool pool(4);
+    CHECK(pool.getNumThreads() == 4);
+    std::vector<std::atomic<int> > calls(1000);
+    for (size_t i = 0; i < calls.size(); ++i)
+        calls[i] = 0;
+    std::atomic<bool> badThread(false);
+    pool.parallelFor(calls.size(), [&](size_t item, size_t thread) {
+        calls[item]++;
+        if (thread >= 4)
+            badThread = true;
+    });
+    for (size_t i = 0; i < calls.size(); ++i)
+        CHECK(calls[i] == 1);
+    CHECK(!badThread);
+
+    // at most maxThreads take part
+    std::atomic<size_t> maxThread(0);
+    pool.parallelFor(1000, [&](size_t, size_t thread) {
+        size_t seen = maxThread;
+        while (thread > seen && !maxThread.compare_exchange_weak(seen, thread)) {}
+    }, 2);
+    CHECK(maxThread < 2);
+    pool.parallelFor(0, [&](size_t, size_t) { badThread = true; });
+    CHECK(!badThread);
+}
+
+POITOOLS_TEST(threadpool, concurrentLoops) {
+    // loops started from several threads share the pool, loops started from within a loop run serially
+    ThreadPool& pool = ThreadPool::getShared();
+    CHECK(&pool == &ThreadPool::getShared());
+    std::atomic<long long> sum(0);
+    std::atomic<bool> nestedOnOtherThread(false);
+    auto loop = [&]() {
+        for (int round = 0; round < 100; ++round) {
+            pool.parallelFor(50, [&](size_t item, size_t) {
+                sum += static_cast<long long>(item);
+                if (item == 7) {
+                    pool.parallelFor(10, [&](size_t nested, size_t thread) {
+                        sum += static_cast<long long>(nested);
+                        if (thread != 0)
+                            nestedOnOtherThread = true;
+                    });
+                }
+            });
+        }
+    };
+    std::thread a(loop), b(loop), c(loop);
+    a.join();
+    b.join();
+    c.join();
+    CHECK(sum == 3 * 100 * (1225 + 45));
+    CHECK(!nestedOnOtherThread);
+}
+
+POITOOLS_TEST(threadpool, sharedWorkers) {
+    // a loop started while another one holds the calling thread and a worker still gets the free worker
+    ThreadPool pool(3);
+    std::mutex mutex;
+    std::condition_variable released;
+    bool done = false;
+    std::atomic<bool> onWorker(false);
+    std::thread blocking([&]() {
+        pool.parallelFor(2, [&](size_t, size_t) {
+            std::unique_lock<std::mutex> lock(mutex);
+            released.wait(lock, [&done]() { return done; });
+        });
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pool.parallelFor(20, [&](size_t, size_t thread) {
+        if (thread != 0)
+            onWorker = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    released.notify_all();
+    blocking.join();
+    CHECK(onWorker);
+}
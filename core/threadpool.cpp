@@ -0,0 +1,107 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+namespace poitools {
+
+namespace {
+
+/// Number of loop items the current thread is running, a loop started inside one is nested.
+thread_local int itemDepth = 0;
+
+void callItem(const std::function<void(size_t, size_t)>& f, size_t item, size_t thread) {
+    ++itemDepth;
+    f(item, thread);
+    --itemDepth;
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t numThreads)
+    : quit_(false)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t t = 1; t < numThreads; ++t)
+        workers_.push_back(std::thread(&ThreadPool::run, this, t));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wakeup_.notify_all();
+    for (size_t t = 0; t < workers_.size(); ++t)
+        workers_[t].join();
+}
+
+ThreadPool& ThreadPool::getShared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& f, size_t maxThreads) {
+    if (count == 0)
+        return;
+    const size_t numThreads = maxThreads == 0 ? getNumThreads() : std::min(maxThreads, getNumThreads());
+
+    // not worth waking anybody up, or nested in an item of another loop
+    if (count == 1 || numThreads == 1 || itemDepth > 0) {
+        for (size_t i = 0; i < count; ++i)
+            callItem(f, i, 0);
+        return;
+    }
+
+    Loop loop = { &f, count, 0, 0, numThreads };
+    std::unique_lock<std::mutex> lock(mutex_);
+    loops_.push_back(&loop);
+    wakeup_.notify_all();
+
+    // the calling thread only works on its own loop, it returns as soon as that is done
+    while (loop.next < loop.count) {
+        const size_t item = takeItem(&loop);
+        lock.unlock();
+        callItem(f, item, 0);
+        lock.lock();
+        ++loop.finished;
+    }
+    done_.wait(lock, [&loop]() { return loop.finished == loop.count; });
+}
+
+ThreadPool::Loop* ThreadPool::findLoop(size_t thread) const {
+    for (size_t l = 0; l < loops_.size(); ++l) {
+        if (thread < loops_[l]->limit)
+            return loops_[l];
+    }
+    return 0;
+}
+
+size_t ThreadPool::takeItem(Loop* loop) {
+    const size_t item = loop->next++;
+    if (loop->next == loop->count)
+        loops_.erase(std::find(loops_.begin(), loops_.end(), loop));
+    return item;
+}
+
+void ThreadPool::run(size_t thread) {
+    // items are handed out one by one, they usually differ a lot in cost
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wakeup_.wait(lock, [this, thread]() { return quit_ || findLoop(thread) != 0; });
+        if (quit_)
+            return;
+
+        Loop* loop = findLoop(thread);
+        const size_t item = takeItem(loop);
+        lock.unlock();
+        callItem(*loop->f, item, thread);
+        lock.lock();
+
+        // the caller may return and free the loop as soon as it sees the last item finished
+        if (++loop->finished == loop->count)
+            done_.notify_all();
+    }
+}
+
+} // namespace poitools
@@ -0,0 +1,74 @@
+#ifndef POITOOLS_CORE_THREADPOOL_H
+#define POITOOLS_CORE_THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace poitools {
+
+/**
+ * Fixed set of worker threads for data parallel loops.
+ *
+ * The threads are started once and wait for work in between, so a loop does
+ * not pay for thread creation. The measurement code shares one pool, see
+ * getShared(), so several processors do not start a thread per core each.
+ */
+class ThreadPool {
+public:
+    /// @param numThreads number of threads including the calling one, 0 means one per core
+    explicit ThreadPool(size_t numThreads = 0);
+    ~ThreadPool();
+
+    /// Pool with one thread per core, started on first use.
+    static ThreadPool& getShared();
+
+    size_t getNumThreads() const { return workers_.size() + 1; }
+
+    /**
+     * Calls f(item, thread) for every item in [0, count) and returns when all
+     * calls are done. The calling thread takes part as thread 0, the others are
+     * numbered up to getNumThreads() - 1, so f may index per-thread state with it.
+     *
+     * Loops started concurrently, e.g. by several processors, share the
+     * workers, which take the items of the oldest loop first. A loop started
+     * from within f runs on the calling thread alone as thread 0, waiting for
+     * workers there could deadlock.
+     *
+     * @param maxThreads at most this many threads take part, 0 means all
+     */
+    void parallelFor(size_t count, const std::function<void(size_t item, size_t thread)>& f, size_t maxThreads = 0);
+
+private:
+    /// One parallelFor() call, lives on the stack of the calling thread.
+    struct Loop {
+        const std::function<void(size_t, size_t)>* f;
+        size_t count;
+        size_t next;        ///< next item to hand out
+        size_t finished;    ///< items done
+        size_t limit;       ///< threads taking part
+    };
+
+    void run(size_t thread);
+
+    /// Oldest loop with items left that thread takes part in, 0 if there is none.
+    Loop* findLoop(size_t thread) const;
+
+    /// Hands out the next item of loop, the mutex has to be locked.
+    size_t takeItem(Loop* loop);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable done_;
+
+    std::vector<Loop*> loops_;  ///< loops with items left to hand out, oldest first
+    bool quit_;
+};
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_THREADPOOL_H
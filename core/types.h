@@ -0,0 +1,152 @@
+#ifndef POITOOLS_CORE_TYPES_H
+#define POITOOLS_CORE_TYPES_H
+
+#include <cmath>
+#include <cstddef>
+
+namespace poitools {
+
+/**
+ * Minimal vector and matrix types of the measurement core.
+ *
+ * They mirror the memory layout of tgt::vec3, tgt::ivec2, tgt::ivec3 and tgt::mat4
+ * (row-major, column vectors), so the processors can convert by copying the
+ * elements, but do not pull in tgt or GL.
+ */
+struct Vec3 {
+    float x, y, z;
+
+    Vec3() : x(0.0f), y(0.0f), z(0.0f) {}
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    Vec3 operator+(const Vec3& v) const { return Vec3(x + v.x, y + v.y, z + v.z); }
+    Vec3 operator-(const Vec3& v) const { return Vec3(x - v.x, y - v.y, z - v.z); }
+    Vec3 operator*(float s) const       { return Vec3(x * s, y * s, z * s); }
+    bool operator==(const Vec3& v) const { return x == v.x && y == v.y && z == v.z; }
+};
+
+inline float length(const Vec3& v) {
+    return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+}
+
+inline float distance(const Vec3& a, const Vec3& b) {
+    return length(b - a);
+}
+
+struct IVec2 {
+    int x, y;
+
+    IVec2() : x(0), y(0) {}
+    IVec2(int x, int y) : x(x), y(y) {}
+
+    int& operator[](int i)       { return i == 0 ? x : y; }
+    int operator[](int i) const  { return i == 0 ? x : y; }
+    bool operator==(const IVec2& v) const { return x == v.x && y == v.y; }
+    bool operator!=(const IVec2& v) const { return !(*this == v); }
+};
+
+struct IVec3 {
+    int x, y, z;
+
+    IVec3() : x(0), y(0), z(0) {}
+    IVec3(int x, int y, int z) : x(x), y(y), z(z) {}
+
+    bool operator==(const IVec3& v) const { return x == v.x && y == v.y && z == v.z; }
+    bool operator!=(const IVec3& v) const { return !(*this == v); }
+};
+
+/// 4x4 matrix, row-major like tgt::mat4.
+struct Mat4 {
+    float m[16];
+
+    Mat4() {
+        for (int i = 0; i < 16; ++i)
+            m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+    explicit Mat4(const float* elements) {
+        for (int i = 0; i < 16; ++i)
+            m[i] = elements[i];
+    }
+
+    bool operator==(const Mat4& o) const {
+        for (int i = 0; i < 16; ++i)
+            if (m[i] != o.m[i])
+                return false;
+        return true;
+    }
+    bool operator!=(const Mat4& o) const { return !(*this == o); }
+
+    /// Transforms an affine point, i.e. w is assumed to be 1 and ignored in the result.
+    Vec3 transform(const Vec3& p) const {
+        return Vec3(m[0] * p.x + m[1] * p.y + m[2]  * p.z + m[3],
+                    m[4] * p.x + m[5] * p.y + m[6]  * p.z + m[7],
+                    m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11]);
+    }
+
+    /// Transforms a point with w = 1 and divides by the resulting w, e.g. for inverse projections.
+    Vec3 project(const Vec3& p) const {
+        float w = m[12] * p.x + m[13] * p.y + m[14] * p.z + m[15];
+        return transform(p) * (1.0f / w);
+    }
+};
+
+/**
+ * First-hit-point (texture coordinates) of the pixel at pos with the given
+ * window depth, background (zero) for the far plane. windowToTexture maps
+ * (x + 0.5, y + 0.5, depth) of a pixel center to texture coordinates.
+ */
+inline Vec3 unprojectDepth(const Mat4& windowToTexture, IVec2 pos, float depth) {
+    if (depth >= 1.0f)
+        return Vec3();
+    return windowToTexture.project(Vec3(static_cast<float>(pos.x) + 0.5f, static_cast<float>(pos.y) + 0.5f, depth));
+}
+
+/**
+ * Read-only view of a first-hit-point image.
+ *
+ * data points to width * height RGBA float pixels, row by row starting at the
+ * lower left. The view may be a region of a larger render target, offset is
+ * the position of its lower left pixel in the target. Pixels outside the
+ * region read as background (zero).
+ *
+ * Depth images (see fromDepth()) hold a single window depth per pixel, the
+ * first-hit-points are reconstructed with the inverse view projection.
+ */
+struct FhpBuffer {
+    const float* data;
+    int width;
+    int height;
+    IVec2 offset;
+    int channels;           ///< 4 for first-hit-point positions, 1 for depth
+    Mat4 windowToTexture;   ///< depth images only, see unprojectDepth()
+
+    FhpBuffer() : data(0), width(0), height(0), offset(), channels(4) {}
+    FhpBuffer(const float* data, int width, int height, IVec2 offset = IVec2())
+        : data(data), width(width), height(height), offset(offset), channels(4) {}
+
+    static FhpBuffer fromDepth(const float* data, int width, int height, IVec2 offset, const Mat4& windowToTexture) {
+        FhpBuffer buffer(data, width, height, offset);
+        buffer.channels = 1;
+        buffer.windowToTexture = windowToTexture;
+        return buffer;
+    }
+
+    bool contains(IVec2 pos) const {
+        return pos.x >= offset.x && pos.y >= offset.y && pos.x < offset.x + width && pos.y < offset.y + height;
+    }
+
+    /// First-hit-point (texture coordinates) at pos in target coordinates.
+    Vec3 at(IVec2 pos) const {
+        if (!data || !contains(pos))
+            return Vec3();
+        size_t index = static_cast<size_t>(pos.y - offset.y) * width + (pos.x - offset.x);
+        if (channels == 1)
+            return unprojectDepth(windowToTexture, pos, data[index]);
+        const float* p = data + 4 * index;
+        return Vec3(p[0], p[1], p[2]);
+    }
+};
+
+} // namespace poitools
+
+#endif // POITOOLS_CORE_TYPES_H
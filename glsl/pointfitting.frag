@@ -5,7 +5,52 @@ uniform sampler2D colorTex_;
 uniform sampler2D depthTex_;
 uniform TextureParameters textureParameters_;
 
+#ifdef SCREEN_OVERLAY
+// polyline on the surface, see utils/screenoverlay.h
+uniform samplerBuffer overlayTex_;  // per vertex: window x, y, depth and flags (1: disc, 2: line to the next vertex)
+uniform isamplerBuffer overlayTiles_; // per tile the offset of its vertex indices, one more for the end, then the indices
+uniform int overlayCount_;
+uniform vec4 overlayBounds_;        // lower left and upper right in window coordinates
+uniform ivec2 overlayGrid_;         // tiles in x and y, starting at the lower left of overlayBounds_
+uniform float overlayTileSize_;     // pixels
+uniform float overlayLineWidth_;
+uniform float overlayDiscRadius_;
+uniform vec4 overlayColor_;
+
+// coverage of the fragment at p by the visible lines and discs of its tile, antialiased over one pixel
+float overlayCoverage(vec2 p, float depth) {
+    if (overlayCount_ == 0 || any(lessThan(p, overlayBounds_.xy)) || any(greaterThan(p, overlayBounds_.zw)))
+        return 0.0;
+
+    ivec2 tile = clamp(ivec2((p - overlayBounds_.xy) / overlayTileSize_), ivec2(0), overlayGrid_ - 1);
+    int first = texelFetch(overlayTiles_, tile.y * overlayGrid_.x + tile.x).r;
+    int last = texelFetch(overlayTiles_, tile.y * overlayGrid_.x + tile.x + 1).r;
+
+    float coverage = 0.0;
+    for (int k = first; k < last; ++k) {
+        int i = texelFetch(overlayTiles_, k).r;
+        vec4 a = texelFetch(overlayTex_, i);
+        int flags = int(a.w + 0.5);
+        if ((flags & 1) != 0 && a.z <= depth)
+            coverage = max(coverage, clamp(overlayDiscRadius_ + 0.5 - distance(p, a.xy), 0.0, 1.0));
+
+        if ((flags & 2) != 0 && i + 1 < overlayCount_) {
+            vec4 b = texelFetch(overlayTex_, i + 1);
+            vec2 ab = b.xy - a.xy;
+            float t = clamp(dot(p - a.xy, ab) / max(dot(ab, ab), 1e-6), 0.0, 1.0);
+            if (mix(a.z, b.z, t) <= depth)
+                coverage = max(coverage, clamp(0.5 * overlayLineWidth_ + 0.5 - distance(p, a.xy + t * ab), 0.0, 1.0));
+        }
+    }
+    return coverage;
+}
+#endif
+
 void main() {
     FragData0 = textureLookup2Dscreen(colorTex_, textureParameters_, gl_FragCoord.xy);
     gl_FragDepth = textureLookup2Dscreen(depthTex_, textureParameters_, gl_FragCoord.xy).x;
+#ifdef SCREEN_OVERLAY
+    float coverage = overlayCoverage(gl_FragCoord.xy, gl_FragDepth) * overlayColor_.a;
+    FragData0 = vec4(mix(FragData0.rgb, overlayColor_.rgb, coverage), max(FragData0.a, coverage));
+#endif
 }
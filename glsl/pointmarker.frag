@@ -0,0 +1,34 @@
+in vec3 eyeCenter_;
+in vec3 eyePos_;
+
+uniform mat4 projectionMatrix_;
+uniform float radius_;
+uniform vec4 color_;
+
+uniform vec4 lightPosition_;    // eye space, w = 0 for directional lights
+uniform vec3 lightAmbient_;
+uniform vec3 lightDiffuse_;
+uniform vec3 lightSpecular_;
+uniform float shininess_;
+
+void main() {
+    // intersect the view ray with the sphere
+    vec3 dir = normalize(eyePos_);
+    float b = dot(dir, eyeCenter_);
+    float disc = b * b - dot(eyeCenter_, eyeCenter_) + radius_ * radius_;
+    if (disc < 0.0)
+        discard;
+    vec3 hit = (b - sqrt(disc)) * dir;
+    vec3 n = normalize(hit - eyeCenter_);
+
+    // phong lighting with the default material coefficients of the fixed function pipeline
+    vec3 l = normalize(lightPosition_.w == 0.0 ? lightPosition_.xyz : lightPosition_.xyz - hit);
+    vec3 v = normalize(-hit);
+    float diffuse = max(dot(n, l), 0.0);
+    float specular = diffuse > 0.0 ? pow(max(dot(reflect(-l, n), v), 0.0), shininess_) : 0.0;
+    vec3 rgb = color_.rgb * (0.2 * lightAmbient_ + 0.8 * diffuse * lightDiffuse_) + specular * lightSpecular_;
+    FragData0 = vec4(rgb, color_.a);
+
+    vec4 clip = projectionMatrix_ * vec4(hit, 1.0);
+    gl_FragDepth = 0.5 * (clip.z / clip.w) + 0.5;
+}
@@ -0,0 +1,18 @@
+in vec2 corner_;    // billboard corner in [-1,1]^2
+in vec3 center_;    // sphere center in world coordinates, one per instance
+
+uniform mat4 viewMatrix_;
+uniform mat4 projectionMatrix_;
+uniform float radius_;
+
+out vec3 eyeCenter_;
+out vec3 eyePos_;
+
+void main() {
+    eyeCenter_ = (viewMatrix_ * vec4(center_, 1.0)).xyz;
+
+    // the billboard is enlarged, as the perspective silhouette of a sphere is
+    // larger than its radius on the center plane
+    eyePos_ = eyeCenter_ + vec3(corner_ * radius_ * 1.5, 0.0);
+    gl_Position = projectionMatrix_ * vec4(eyePos_, 1.0);
+}
@@ -3,12 +3,54 @@ SET(MOD_CORE_MODULECLASS PoiTools)
  
 # module's core source files, path relative to module dir
 SET(MOD_CORE_SOURCES
+    ${MOD_DIR}/processors/poibatch.cpp
     ${MOD_DIR}/processors/pointfitting.cpp
+    ${MOD_DIR}/processors/subjectqueue.cpp
     ${MOD_DIR}/processors/surfacemeasure.cpp
+    ${MOD_DIR}/utils/asyncfhppicker.cpp
+    ${MOD_DIR}/utils/fhpcache.cpp
+    ${MOD_DIR}/utils/fhpformat.cpp
+    ${MOD_DIR}/utils/fhpraycaster.cpp
+    ${MOD_DIR}/utils/geodesicengine.cpp
+    ${MOD_DIR}/utils/measureworker.cpp
+    ${MOD_DIR}/utils/planesection.cpp
+    ${MOD_DIR}/utils/pointmarkerrenderer.cpp
+    ${MOD_DIR}/utils/polylineevaluator.cpp
+    ${MOD_DIR}/utils/screenoverlay.cpp
+    ${MOD_DIR}/utils/stagetimer.cpp
+    ${MOD_DIR}/utils/surfacecache.cpp
+    ${MOD_DIR}/utils/volumebrickreader.cpp
+    ${MOD_DIR}/utils/volumeprefetcher.cpp
 )
  
 # module's core header files, path relative to module dir
 SET(MOD_CORE_HEADERS
+    ${MOD_DIR}/processors/poibatch.h
     ${MOD_DIR}/processors/pointfitting.h
+    ${MOD_DIR}/processors/subjectqueue.h
     ${MOD_DIR}/processors/surfacemeasure.h
+    ${MOD_DIR}/utils/asyncfhppicker.h
+    ${MOD_DIR}/utils/coreadapter.h
+    ${MOD_DIR}/utils/fhpcache.h
+    ${MOD_DIR}/utils/fhpformat.h
+    ${MOD_DIR}/utils/fhpraycaster.h
+    ${MOD_DIR}/utils/fhpsource.h
+    ${MOD_DIR}/utils/geodesicengine.h
+    ${MOD_DIR}/utils/inputkey.h
+    ${MOD_DIR}/utils/measureworker.h
+    ${MOD_DIR}/utils/planesection.h
+    ${MOD_DIR}/utils/pointmarkerrenderer.h
+    ${MOD_DIR}/utils/polylineevaluator.h
+    ${MOD_DIR}/utils/screenoverlay.h
+    ${MOD_DIR}/utils/stagetimer.h
+    ${MOD_DIR}/utils/surfacecache.h
+    ${MOD_DIR}/utils/volumebrickreader.h
+    ${MOD_DIR}/utils/volumeprefetcher.h
+    ${MOD_DIR}/utils/volumesampling.h
 )
+
+# GL-free measurement core, a separate target that also builds on its own (see core/CMakeLists.txt)
+IF(NOT TARGET poitoolscore)
+    ADD_SUBDIRECTORY(${MOD_DIR}/core ${CMAKE_BINARY_DIR}/poitoolscore)
+ENDIF()
+SET(MOD_LIBRARIES poitoolscore)
@@ -2,15 +2,24 @@
 #include "poitools.h"
  
 // include classes to be registered
+#include "processors/poibatch.h"
 #include "processors/pointfitting.h"
+#include "processors/subjectqueue.h"
 #include "processors/surfacemeasure.h"
+
+#include "tgt/assert.h"
  
 //use voreen namespace
 namespace voreen {
  
+PoiTools* PoiTools::instance_ = 0;
+ 
 PoiTools::PoiTools(const std::string& modulePath)
     : VoreenModule(modulePath)
+    , cacheMemory_("surfaceCacheMemory", "Surface Cache Memory (MiB)", static_cast<int>(SurfaceCache::DEFAULT_BUDGET >> 20), 64, 65536)
 {
+    instance_ = this;
+ 
     // module name to be used internally
     setID("POI Tools");
  
@@ -18,15 +27,34 @@ PoiTools::PoiTools(const std::string& modulePath)
     setGuiName("POI Tools");
  
     // each module processor needs to be registered
+    registerProcessor(new PoiBatch());
     registerProcessor(new PointFitting());
+    registerProcessor(new SubjectQueue());
     registerProcessor(new SurfaceMeasure());
  
+    // module setting, surface graphs of large volumes may need more than the default
+    addProperty(cacheMemory_);
+    cacheMemory_.onChange(MemberFunctionCallback<PoiTools>(this, &PoiTools::updateCacheBudget));
+
     // adds a glsl dir to the shader search path (if shaders are needed in the module)
     addShaderPath(getModulePath("glsl"));
 }
  
+PoiTools::~PoiTools() {
+    instance_ = 0;
+}
+ 
 std::string PoiTools::getDescription() const {
     return "This module is a toolset for handling points of interest.";
 }
  
+void PoiTools::updateCacheBudget() {
+    surfaceCache_.setMemoryBudget(static_cast<size_t>(cacheMemory_.get()) << 20);
+}
+ 
+SurfaceCache& PoiTools::getSurfaceCache() {
+    tgtAssert(instance_, "POI Tools module has not been created");
+    return instance_->surfaceCache_;
+}
+ 
 } // namespace
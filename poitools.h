@@ -3,6 +3,9 @@
  
 //include module base class
 #include "voreen/core/voreenmodule.h"
+#include "voreen/core/properties/intproperty.h"
+
+#include "utils/surfacecache.h"
  
 //use namespace voreen
 namespace voreen {
@@ -20,10 +23,26 @@ public:
      */
     PoiTools(const std::string& modulePath);
  
+    ~PoiTools();
+
     /**
      * Sets the description to be shown in the VoreenVE GUI.
      */
     virtual std::string getDescription() const;
+
+    /**
+     * Data derived from volumes that all processors of the module share,
+     * e.g. a PointFitting and a SurfaceMeasure on the same volume.
+     */
+    static SurfaceCache& getSurfaceCache();
+
+private:
+    void updateCacheBudget(); ///< passes cacheMemory_ to the surface cache
+
+    SurfaceCache surfaceCache_;
+    IntProperty cacheMemory_; ///< MiB of shared surface data kept while no processor uses it
+
+    static PoiTools* instance_;
 };
  
 } // namespace
@@ -0,0 +1,287 @@
+#include "poibatch.h"
+
+#include "../poitools.h"
+
+#include "../core/measure.h"
+#include "../core/pointexport.h"
+#include "../utils/coreadapter.h"
+#include "../utils/fhpraycaster.h"
+#include "../utils/geodesicengine.h"
+#include "../utils/volumeprefetcher.h"
+
+#include "voreen/core/voreenapplication.h"
+
+#include "tgt/filesystem.h"
+
+#include <sstream>
+
+namespace voreen {
+
+PoiBatch::PoiBatch()
+    : Processor()
+    , jobFile_("jobFile", "Job File", "Open Job File", VoreenApplication::app()->getUserDataPath(), "Job File (*.txt)")
+    , outputFile_("outputFile", "Output File", "Select Output File", VoreenApplication::app()->getUserDataPath(), "Results (*.csv *.poix)", FileDialogProperty::SAVE_FILE)
+    , isoValue_("isoValue", "Surface Iso Value", 0.5f, 0.0f, 1.0f)
+    , geodesicStride_("geodesicStride", "Surface Graph Subsampling", 2, 1, 8)
+    , extractionMemory_("extractionMemory", "Surface Extraction Memory (MiB)", 256, 16, 65536)
+    , autoRun_("autoRun", "Run on Evaluation", false)
+    , runBatch_("runBatch", "Run Batch")
+    , lastRun_()
+{
+    addProperty(jobFile_);
+    addProperty(outputFile_);
+    addProperty(isoValue_);
+    addProperty(geodesicStride_);
+    addProperty(extractionMemory_);
+    addProperty(autoRun_);
+    addProperty(runBatch_);
+
+    runBatch_.onChange(MemberFunctionCallback<PoiBatch>(this, &PoiBatch::runBatch));
+}
+
+PoiBatch::~PoiBatch() {
+}
+
+Processor* PoiBatch::create() const {
+    return new PoiBatch();
+}
+
+void PoiBatch::process() {
+    // voreentool evaluates the network once, so the batch runs without any button being pressed
+    if (autoRun_.get() && jobFile_.get() != "" && jobFile_.get() != lastRun_) {
+        lastRun_ = jobFile_.get();
+        runBatch();
+    }
+}
+
+bool PoiBatch::readJobs(std::vector<Job>& jobs) const {
+    if (!tgt::FileSystem::fileExists(jobFile_.get())) {
+        LERROR("Job file does not exist: " << jobFile_.get());
+        return false;
+    }
+
+    std::ifstream file(jobFile_.get());
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream in(line);
+        std::string keyword;
+        if (!(in >> keyword) || keyword[0] == '#')
+            continue;
+
+        if (keyword == "volume") {
+            Job job;
+            job.viewport = tgt::ivec2(512);
+            in >> std::ws;
+            std::getline(in, job.volumePath);
+            jobs.push_back(job);
+            continue;
+        }
+        if (jobs.empty()) {
+            LERROR(jobFile_.get() << ":" << lineNumber << ": '" << keyword << "' before the first volume");
+            return false;
+        }
+
+        Job& job = jobs.back();
+        bool valid = true;
+        if (keyword == "camera") {
+            tgt::vec3 position, focus, up;
+            float fovy = 45.0f;
+            valid = static_cast<bool>(in >> position.x >> position.y >> position.z >> focus.x >> focus.y >> focus.z >> up.x >> up.y >> up.z);
+            in >> fovy;
+            job.camera = tgt::Camera(position, focus, up, fovy);
+        } else if (keyword == "viewport") {
+            valid = static_cast<bool>(in >> job.viewport.x >> job.viewport.y);
+        } else {
+            Record record;
+            if (keyword == "pick") {
+                record.type = Record::PICK;
+                valid = static_cast<bool>(in >> record.label >> record.a.x >> record.a.y);
+            } else if (keyword == "point") {
+                record.type = Record::POINT;
+                valid = static_cast<bool>(in >> record.label >> record.a.x >> record.a.y >> record.a.z);
+            } else if (keyword == "pair") {
+                record.type = Record::PAIR;
+                valid = static_cast<bool>(in >> record.label >> record.a.x >> record.a.y >> record.b.x >> record.b.y);
+            } else if (keyword == "geodesic") {
+                record.type = Record::GEODESIC;
+                valid = static_cast<bool>(in >> record.label >> record.a.x >> record.a.y >> record.a.z >> record.b.x >> record.b.y >> record.b.z);
+            } else {
+                LERROR(jobFile_.get() << ":" << lineNumber << ": unknown keyword '" << keyword << "'");
+                return false;
+            }
+            job.records.push_back(record);
+        }
+
+        if (!valid) {
+            LERROR(jobFile_.get() << ":" << lineNumber << ": malformed '" << keyword << "' line");
+            return false;
+        }
+    }
+    return true;
+}
+
+void PoiBatch::evaluate(const Job& job, const VolumeBase* volume, bool withPaths, std::vector<Result>& results) const {
+    // the surface data comes from the module's cache, shared with the other processors on the same volume
+    std::shared_ptr<const FhpRaycaster> raycaster = PoiTools::getSurfaceCache().getRaycaster(volume, isoValue_.get());
+    const FhpRaycaster::View view = FhpRaycaster::createView(job.camera, job.viewport);
+    auto getFhp = [&raycaster, &view](tgt::ivec2 pos) { return raycaster ? raycaster->getFhp(view, pos) : tgt::vec4(0.0f); };
+    tgt::mat4 textureToWorld = volume->getTextureToWorldMatrix();
+    std::shared_ptr<const GeodesicEngine> geodesic;
+    GeodesicEngine::QueryState queryState;
+    poitools::PathSampler sampler;
+
+    results.assign(job.records.size(), Result());
+    for (size_t i = 0; i < job.records.size(); ++i) {
+        const Record& record = job.records[i];
+        Result& result = results[i];
+        tgt::ivec2 a(static_cast<int>(record.a.x), static_cast<int>(record.a.y));
+        tgt::ivec2 b(static_cast<int>(record.b.x), static_cast<int>(record.b.y));
+
+        switch (record.type) {
+        case Record::PICK: {
+            tgt::vec4 fhp = getFhp(a);
+            if (length(fhp) > 0.0f) {
+                result.valid = true;
+                result.a = textureToWorld * fhp.xyz();
+            }
+            break;
+        }
+        case Record::POINT:
+            result.valid = true;
+            result.a = record.a;
+            break;
+        case Record::PAIR: {
+            tgt::vec4 start = getFhp(a);
+            tgt::vec4 end = getFhp(b);
+            if (length(start) > 0.0f && length(end) > 0.0f) {
+                result.valid = true;
+                result.a = textureToWorld * start.xyz();
+                result.b = textureToWorld * end.xyz();
+                auto lookup = [&getFhp](poitools::IVec2 p) { return toCore(getFhp(toTgt(p)).xyz()); };
+                result.distance = sampler.measure(toCore(a), toCore(b), toCore(textureToWorld), lookup);
+                if (withPaths)
+                    result.path = sampler.getPath();
+            }
+            break;
+        }
+        case Record::GEODESIC: {
+            if (!geodesic)
+                geodesic = PoiTools::getSurfaceCache().getGeodesicEngine(volume, isoValue_.get(), geodesicStride_.get(),
+                                                                         static_cast<size_t>(extractionMemory_.get()) << 20);
+            std::vector<tgt::vec3> path;
+            result.a = record.a;
+            result.b = record.b;
+            result.distance = geodesic->query(queryState, record.a, record.b, withPaths ? &path : 0);
+            result.valid = result.distance >= 0.0f;
+            for (size_t p = 0; p < path.size(); ++p)
+                result.path.push_back(toCore(path[p]));
+            break;
+        }
+        }
+    }
+}
+
+void PoiBatch::writeTable(const Job& job, const std::vector<Result>& results, std::ofstream& out) const {
+    static const char* typeNames[] = { "pick", "point", "pair", "geodesic" };
+    for (size_t i = 0; i < job.records.size(); ++i) {
+        const Record& record = job.records[i];
+        const Result& result = results[i];
+        out << job.volumePath << "," << record.label << "," << typeNames[record.type] << ",";
+        switch (record.type) {
+        case Record::PICK:
+        case Record::POINT:
+            if (result.valid)
+                out << result.a.x << "," << result.a.y << "," << result.a.z << ",,,,\n";
+            else
+                out << ",,,,,,\n";
+            break;
+        case Record::PAIR:
+            if (result.valid)
+                out << result.a.x << "," << result.a.y << "," << result.a.z << ","
+                    << result.b.x << "," << result.b.y << "," << result.b.z << "," << result.distance << "\n";
+            else
+                out << ",,,,,,\n";
+            break;
+        case Record::GEODESIC:
+            // the positions are those of the job, also if there is no path between them
+            out << result.a.x << "," << result.a.y << "," << result.a.z << ","
+                << result.b.x << "," << result.b.y << "," << result.b.z << ",";
+            if (result.valid)
+                out << result.distance;
+            out << "\n";
+            break;
+        }
+    }
+}
+
+void PoiBatch::writeExport(const Job& job, const std::vector<Result>& results, poitools::PointExporter& exporter) const {
+    exporter.setGroup(job.volumePath);
+    for (size_t i = 0; i < job.records.size(); ++i) {
+        const Record& record = job.records[i];
+        const Result& result = results[i];
+        if (!result.valid)
+            continue;
+        if (record.type == Record::PICK || record.type == Record::POINT)
+            exporter.writePoint(record.label, toCore(result.a));
+        else
+            exporter.writePath(record.label, result.distance, result.path);
+    }
+}
+
+void PoiBatch::runBatch() {
+    if (jobFile_.get() == "" || outputFile_.get() == "") {
+        LERROR("Job file and output file have to be set");
+        return;
+    }
+
+    std::vector<Job> jobs;
+    if (!readJobs(jobs))
+        return;
+
+    // the CSV table keeps the end points of every record, binary exports the complete paths
+    const bool binary = poitools::getExportFormat(outputFile_.get()) == poitools::EXPORT_BINARY;
+    std::ofstream table;
+    poitools::PointExporter exporter;
+    if (binary)
+        exporter.open(outputFile_.get(), poitools::EXPORT_BINARY);
+    else
+        table.open(outputFile_.get());
+    if (binary ? !exporter.isOpen() : !table) {
+        LERROR("Cannot write " << outputFile_.get());
+        return;
+    }
+    if (!binary)
+        table << "volume,label,type,x0,y0,z0,x1,y1,z1,distance\n";
+
+    // load the next volume while the current one is evaluated
+    VolumePrefetcher prefetcher;
+    std::vector<Result> results;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        VolumeBase* volume = prefetcher.take(jobs[i].volumePath);
+        if (i + 1 < jobs.size())
+            prefetcher.prefetch(jobs[i + 1].volumePath);
+
+        if (!volume) {
+            LERROR("Skipping " << jobs[i].volumePath);
+            continue;
+        }
+        LINFO("Evaluating " << jobs[i].records.size() << " records on " << jobs[i].volumePath);
+        evaluate(jobs[i], volume, binary, results);
+        if (binary) {
+            writeExport(jobs[i], results, exporter);
+        } else {
+            writeTable(jobs[i], results, table);
+            table.flush();
+        }
+        delete volume;
+    }
+    if (binary && !exporter.close()) {
+        LERROR("Writing " << outputFile_.get() << " failed");
+        return;
+    }
+    LINFO("Wrote " << outputFile_.get());
+}
+
+} // namespace voreen
@@ -0,0 +1,113 @@
+#ifndef VRN_POITOOLS_POIBATCH_H
+#define VRN_POITOOLS_POIBATCH_H
+
+#include "voreen/core/processors/processor.h"
+#include "voreen/core/properties/boolproperty.h"
+#include "voreen/core/properties/buttonproperty.h"
+#include "voreen/core/properties/filedialogproperty.h"
+#include "voreen/core/properties/floatproperty.h"
+#include "voreen/core/properties/intproperty.h"
+
+#include "../core/pointexport.h"
+
+#include "tgt/camera.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+class VolumeBase;
+
+/**
+ * Applies picks and measurements from a job file to a list of volumes,
+ * without a GUI and without a GL context.
+ */
+class VRN_CORE_API PoiBatch : public Processor {
+public:
+    PoiBatch();
+    ~PoiBatch();
+    virtual Processor* create() const;
+
+    virtual std::string getCategory() const  { return "Utility";         }
+    virtual std::string getClassName() const { return "PoiBatch"; }
+    virtual CodeState getCodeState() const   { return CODE_STATE_TESTING; }
+    virtual bool isUtility() const           { return true; }
+
+    /// Runs all jobs of the job file and writes the results to the output file.
+    void runBatch();
+
+protected:
+    virtual void setDescriptions() {
+        setDescription(
+                "Applies picks and measurements to many volumes without user interaction. "
+                "The job file lists the volumes, each followed by the camera, the viewport and "
+                "the records to evaluate. Screen space picks are resolved by casting rays into "
+                "the volume at the given iso value, so no first-hit-point rendering is required. "
+                "Each record yields one line in the CSV output file. An output file ending in .poix "
+                "is written as a binary point export instead, which also contains the complete "
+                "measured paths. The next volume is loaded in the background while the current one "
+                "is evaluated."
+                );
+    }
+
+    void process();
+
+private:
+    struct Record {
+        enum Type {
+            PICK,       ///< screen position, resolved to the first-hit-point
+            POINT,      ///< world position, written as is
+            PAIR,       ///< screen positions, line integral as in SurfaceMeasure
+            GEODESIC    ///< world positions, shortest path on the isosurface
+        };
+        Type type;
+        std::string label;
+        tgt::vec3 a;    ///< first position, screen positions only use xy
+        tgt::vec3 b;    ///< second position of PAIR and GEODESIC
+    };
+
+    struct Result {
+        Result() : valid(false), distance(0.0f) {}
+
+        bool valid;                         ///< false if a pick missed the surface or there is no geodesic path
+        tgt::vec3 a;                        ///< world position of the record, or start of the path
+        tgt::vec3 b;                        ///< end of the path
+        float distance;
+        std::vector<poitools::Vec3> path;   ///< measured path of PAIR and GEODESIC, if requested
+    };
+
+    struct Job {
+        std::string volumePath;
+        tgt::Camera camera;
+        tgt::ivec2 viewport;
+        std::vector<Record> records;
+    };
+
+    /// Parses the job file, returns false (and logs) on syntax errors.
+    bool readJobs(std::vector<Job>& jobs) const;
+
+    /// Evaluates all records of job on volume, the paths are only kept withPaths.
+    void evaluate(const Job& job, const VolumeBase* volume, bool withPaths, std::vector<Result>& results) const;
+
+    /// Appends a CSV line per record to out.
+    void writeTable(const Job& job, const std::vector<Result>& results, std::ofstream& out) const;
+
+    /// Writes the points and paths of the valid records, grouped by volume.
+    void writeExport(const Job& job, const std::vector<Result>& results, poitools::PointExporter& exporter) const;
+
+    FileDialogProperty jobFile_;        ///< job list, see setDescriptions()
+    FileDialogProperty outputFile_;     ///< CSV file or binary export (.poix) the results are streamed to
+    FloatProperty isoValue_;            ///< iso value of the surface picks are resolved on
+    IntProperty geodesicStride_;        ///< voxel subsampling of the geodesic surface graph
+    IntProperty extractionMemory_;      ///< MiB of volume data read at a time while the surface graph is built
+    BoolProperty autoRun_;              ///< run when the network is evaluated, e.g. in voreentool
+    ButtonProperty runBatch_;
+
+    std::string lastRun_;               ///< job file of the last automatic run
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_POIBATCH_H
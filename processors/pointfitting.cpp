@@ -1,10 +1,15 @@
 #include "pointfitting.h"
 
+#include "../poitools.h"
+
 #include "voreen/core/voreenapplication.h"
 
 #include "tgt/textureunit.h"
 #include "tgt/filesystem.h"
 
+#include <algorithm>
+#include <iomanip>
+#include <limits>
 #include <sstream>
 
 using tgt::TextureUnit;
@@ -16,40 +21,101 @@ PointFitting::PointFitting()
     : ImageProcessor("pointfitting")
     , imgInport_(Port::INPORT, "image", "Image Input")
     , fhpInport_(Port::INPORT, "fhp", "First-hit-points Input", false, Processor::INVALID_PROGRAM, RenderPort::RENDERSIZE_DEFAULT, GL_RGBA16F)
+    , fhpDepthInport_(Port::INPORT, "fhp.depth", "First-hit Depth Input", false, Processor::INVALID_PROGRAM, RenderPort::RENDERSIZE_DEFAULT, GL_R32F, GL_DEPTH_COMPONENT32F)
     , refInport_(Port::INPORT, "refvol", "Reference Volume", false)
     , outport_(Port::OUTPORT, "image.output", "Image Output")
     , outportPicked_(Port::OUTPORT, "outport.picked", "Picked Points Geometry")
+    , outportTimings_(Port::OUTPORT, "outport.timings", "Stage Timings")
+    , outportDistances_(Port::OUTPORT, "outport.distances", "Landmark Distance Matrix")
     , pointListFile_("pointsFile", "Mandatory Points File", "Open Mandatory Points File", VoreenApplication::app()->getUserDataPath(), "Mandatory Points File (*.txt)")
     , mouseEventProp_("mouseEvent.measure", "Point Fitting", this, &PointFitting::measure, tgt::MouseEvent::MOUSE_BUTTON_LEFT, tgt::MouseEvent::PRESSED | tgt::MouseEvent::RELEASED, tgt::Event::ALT, false)
     , mouseUndoProp_("mouseEvent.undo", "Undo Point Fitting", this, &PointFitting::undo, tgt::MouseEvent::MOUSE_BUTTON_RIGHT, tgt::MouseEvent::PRESSED | tgt::MouseEvent::RELEASED, tgt::Event::ALT, false)    
+    , mouseRemoveProp_("mouseEvent.removeNearest", "Remove Nearest Point", this, &PointFitting::removeNearest, tgt::MouseEvent::MOUSE_BUTTON_RIGHT, tgt::MouseEvent::PRESSED | tgt::MouseEvent::RELEASED, tgt::Event::CTRL, false)
     , camera_("camera", "Camera", tgt::Camera(tgt::vec3(0.f, 0.f, 3.5f), tgt::vec3(0.f, 0.f, 0.f), tgt::vec3(0.f, 1.f, 0.f)))
     , renderSpheres_("renderSpheres", "Render Spheres", true)
+    , pickingMode_("pickingMode", "Picking")
+    , fhpFormat_("fhpFormat", "First-hit-point Input")
+    , nearbyPicks_("nearbyPicks", "Picks Near Existing Points")
+    , nearbyRadius_("nearbyRadius", "Nearby Point Radius", 1.0f, 0.0f, 100.0f)
+    , enableTimings_("enableTimings", "Measure Stage Timings", false)
+    , traceFile_("traceFile", "Timing Trace File", "Select Trace File", VoreenApplication::app()->getUserDataPath(), "Chrome Trace (*.json)", FileDialogProperty::SAVE_FILE)
+    , computeDistances_("computeDistances", "Compute Distance Matrix", false)
+    , isoValue_("isoValue", "Surface Iso Value", 0.5f, 0.0f, 1.0f)
+    , geodesicStride_("geodesicStride", "Surface Graph Subsampling", 2, 1, 8)
+    , extractionMemory_("extractionMemory", "Surface Extraction Memory (MiB)", 256, 16, 65536)
+    , advanceSession_("advanceSession", "Advance Session When Complete", false)
+    , exportDirectory_("exportDirectory", "Export Directory", "Select Export Directory", VoreenApplication::app()->getUserDataPath(), "", FileDialogProperty::DIRECTORY)
+    , finishedSubjects_("finishedSubjects", "Finished Subjects", 0, 0, 1000000)
+    , journalFile_("journalFile", "Session Journal", "Select Session Journal", VoreenApplication::app()->getUserDataPath(), "Session Journal (*.poij)", FileDialogProperty::SAVE_FILE)
+    , exportFile_("exportFile", "Point Export File", "Select Export File", VoreenApplication::app()->getUserDataPath(), "Point Export (*.csv *.poix)", FileDialogProperty::SAVE_FILE)
+    , exportPoints_("exportPoints", "Export Points")
     , font_(VoreenApplication::app()->getFontPath("VeraMono.ttf"), 16)
     , mouseCurPos2D_(0.0f)
     , mouseCurPos3D_(0.0f)
     , pointsList_()
     , numSelectedPoints_(0)
     , mouseDown_(false)
-    , mesh_()             //
+    , pointsGeneration_(0)
+    , publishedGeneration_(0)
+    , imageGeneration_(0)
+    , nextPointId_(0)
     , lightSource_()      // Are initialized below
     , material_()         //
     , mandatoryPoints_()  //
     , forceReload_(false)
+    , timer_("PointFitting")
+    , raycasterIsoValue_(-1.0f)
+    , distancesDirty_(false)
+    , resultTimer_(0)
+    , surfaceRevision_(0)
+    , journalDirty_(true)
 {
     addPort(imgInport_);
     addPort(fhpInport_);
+    addPort(fhpDepthInport_);
     addPort(refInport_);
     addPort(outport_);
     addPort(outportPicked_);
+    addPort(outportTimings_);
+    addPort(outportDistances_);
 
     pointListFile_.onChange(MemberFunctionCallback<PointFitting>(this, &PointFitting::forceReload));
 
     addProperty(camera_);
     addProperty(renderSpheres_);
+    pickingMode_.addOption("fhp", "First-hit-point Image");
+    pickingMode_.addOption("raycast", "CPU Ray Casting");
+    addProperty(pickingMode_);
+    fhpFormat_.addOption("positions", "Positions (RGBA)");
+    fhpFormat_.addOption("depth", "Depth Only");
+    addProperty(fhpFormat_);
+    nearbyPicks_.addOption("add", "Add");
+    nearbyPicks_.addOption("snap", "Snap to Existing Point");
+    nearbyPicks_.addOption("reject", "Reject");
+    addProperty(nearbyPicks_);
+    addProperty(nearbyRadius_);
     addProperty(pointListFile_);
+    addProperty(enableTimings_);
+    addProperty(traceFile_);
+    addProperty(computeDistances_);
+    addProperty(isoValue_);
+    addProperty(geodesicStride_);
+    addProperty(extractionMemory_);
+    addProperty(advanceSession_);
+    addProperty(exportDirectory_);
+    addProperty(finishedSubjects_);
+    addProperty(journalFile_);
+    journalFile_.onChange(MemberFunctionCallback<PointFitting>(this, &PointFitting::reopenJournal));
+    addProperty(exportFile_);
+    addProperty(exportPoints_);
+    exportPoints_.onChange(MemberFunctionCallback<PointFitting>(this, &PointFitting::exportPoints));
+    computeDistances_.onChange(MemberFunctionCallback<PointFitting>(this, &PointFitting::invalidateDistances));
+    isoValue_.onChange(MemberFunctionCallback<PointFitting>(this, &PointFitting::invalidateDistances));
+    geodesicStride_.onChange(MemberFunctionCallback<PointFitting>(this, &PointFitting::invalidateDistances));
 
     addEventProperty(&mouseEventProp_);
     addEventProperty(&mouseUndoProp_);
+    addEventProperty(&mouseRemoveProp_);
 
     // light parameters
     lightSource_.position = tgt::vec4(0,1,1,0);
@@ -60,9 +126,6 @@ PointFitting::PointFitting()
 
     // material parameters
     material_.shininess = 20.0f;
-
-    // initialize sphere geometry
-    mesh_.setSphereGeometry(1.0f, tgt::vec3::zero, tgt::vec4::one, 40);
 }
 
 PointFitting::~PointFitting() {
@@ -74,11 +137,36 @@ Processor* PointFitting::create() const {
 
 void PointFitting::initialize() {
     Processor::initialize();
+    markers_.initialize(generateHeader());
     forceReload_ = true;
+
+    // polls for the finished distance matrix, so it is published without waiting for the next event
+    resultTimer_ = VoreenApplication::app()->createTimer(&resultHandler_);
+    resultHandler_.addListenerToBack(this);
+}
+
+void PointFitting::deinitialize() {
+    worker_.stop();
+    raycasterWorker_.stop();
+    // the shared surface data may be dropped from the cache now
+    geodesic_.reset();
+    raycaster_.reset();
+    journal_.close();
+    journalDirty_ = true;
+    delete resultTimer_;
+    resultTimer_ = 0;
+    picker_.deinitialize();
+    markers_.deinitialize();
+    timer_.deinitialize();
+    ImageProcessor::deinitialize();
 }
 
 bool PointFitting::isReady() const {
-    if (!isInitialized() || !imgInport_.isReady() || !fhpInport_.isReady() || !outport_.isReady())
+    if (!isInitialized() || !imgInport_.isReady() || !outport_.isReady())
+        return false;
+
+    // ray casting picks without first-hit-point rendering
+    if (pickingMode_.isSelected("fhp") && !(fhpFormat_.isSelected("depth") ? fhpDepthInport_ : fhpInport_).isReady())
         return false;
 
     return true;
@@ -96,9 +184,27 @@ tgt::ivec2 PointFitting::clampToViewport(tgt::ivec2 mousePos) {
 
 void PointFitting::undo(tgt::MouseEvent* e) {
     if(e->action() & tgt::MouseEvent::PRESSED){
-        if(!pointsList_.empty()) {
+        // a point that has not been added yet is the last element, pending removals are kept
+        bool discarded = picker_.discardLast(PICK_ADD);
+        for (size_t i = queuedPicks_.size(); !discarded && i-- > 0;) {
+            if (queuedPicks_[i].first == PICK_ADD) {
+                queuedPicks_.erase(queuedPicks_.begin() + i);
+                discarded = true;
+            }
+        }
+
+        if(discarded) {
+            LINFO("Discarded pending pick");
+            e->accept();
+            invalidate();
+        } else if(!pointsList_.empty()) {
             LINFO("Removed last element");
+            pointIndex_.remove(pointIds_.back(), toCore(pointsList_.back()));
             pointsList_.pop_back();
+            pointIds_.pop_back();
+            pointsGeneration_++;
+            journal(poitools::POINT_UNDO);
+            distancesDirty_ = true;
             e->accept();
             invalidate();
             numSelectedPoints_--;
@@ -109,6 +215,7 @@ void PointFitting::undo(tgt::MouseEvent* e) {
 }
 
 void PointFitting::measure(tgt::MouseEvent* e) {
+    StageTimer::Scope scope(timer_, "mouse event");
     const VolumeBase* refVolume = refInport_.getData();
     if(!refVolume) {
         LERROR("No reference volume");
@@ -116,26 +223,210 @@ void PointFitting::measure(tgt::MouseEvent* e) {
     }
     if (e->action() & tgt::MouseEvent::PRESSED) {
         mouseCurPos2D_ = clampToViewport(tgt::ivec2(e->coord().x, e->viewport().y-e->coord().y));
-        tgt::vec3 pickedPos = fhpInport_.getRenderTarget()->getColorAtPos(mouseCurPos2D_).xyz();
-        if(pickedPos.x != 0 && pickedPos.y != 0 && pickedPos.z !=0){
-            mouseCurPos3D_ = refVolume->getTextureToWorldMatrix() * pickedPos;
-            mouseDown_ = true;
-            std::stringstream out;
-            out << mouseCurPos3D_.x << " " << mouseCurPos3D_.y << " " << mouseCurPos3D_.z;            
-            LINFO(out.str());
-            pointsList_.push_back(tgt::vec3(mouseCurPos3D_));
+
+        tgt::vec4 fhp;
+        if (pick(PICK_ADD, mouseCurPos2D_, fhp)) {
+            if (addPickedPoint(fhp))
+                e->accept();
+        } else {
+            // the point is added in process() once the readback has finished
             e->accept();
-            invalidate();
-            numSelectedPoints_++;
         }
-        fhpInport_.deactivateTarget();
+        invalidate();
     }
 }
 
+RenderPort& PointFitting::getFhpPort() {
+    return fhpFormat_.isSelected("depth") ? fhpDepthInport_ : fhpInport_;
+}
+
+void PointFitting::updateFhpFormat() {
+    FhpFormat format;
+    if (fhpFormat_.isSelected("depth"))
+        format = FhpFormat::createDepth(camera_.get(), getFhpPort().getSize(), refInport_.getData());
+    fhpCache_.setFormat(format);
+    picker_.setFormat(format);
+}
+
+bool PointFitting::pick(int tag, tgt::ivec2 pos, tgt::vec4& fhp) {
+    if (pickingMode_.isSelected("raycast")) {
+        // picks wait in order until the brick hierarchy has been built
+        if (!updateRaycaster() || !queuedPicks_.empty()) {
+            queuedPicks_.push_back(std::make_pair(tag, pos));
+            return false;
+        }
+        fhp = raycaster_->getFhp(FhpRaycaster::createView(camera_.get(), imgInport_.getSize()), pos);
+        return true;
+    }
+
+    if (getFhpPort().hasChanged())
+        fhpCache_.invalidate();
+    updateFhpFormat();
+
+    // answer from the host copy if possible, but never overtake queued readbacks
+    if (!picker_.isBusy() && fhpCache_.lookup(getFhpPort(), pos, fhp))
+        return true;
+    picker_.request(getFhpPort(), pos, tag, false);
+    return false;
+}
+
+bool PointFitting::updateRaycaster() {
+    const VolumeBase* refVolume = refInport_.getData();
+    if (!pickingMode_.isSelected("raycast") || !refVolume) {
+        raycaster_.reset();
+        queuedPicks_.clear();
+        return false;
+    }
+    if (raycaster_ && !raycaster_->isDetached() && raycaster_->getIsoValue() == isoValue_.get())
+        return true;
+
+    // the brick hierarchy is built once per volume and iso value, and shared with the other processors
+    raycaster_.reset();
+    const SurfaceCache::Request<FhpRaycaster> request = PoiTools::getSurfaceCache().requestRaycaster(refVolume, isoValue_.get());
+    if (request.isReady()) {
+        raycaster_ = request.get();
+        raycasterIsoValue_ = -1.0f;
+        return true;
+    }
+    if (raycasterWorker_.isBusy())
+        return false;
+
+    // the build for this iso value has finished without an entry, e.g. without a RAM representation
+    if (raycasterIsoValue_ == isoValue_.get()) {
+        LWARNING("No brick hierarchy for ray casting, picks are dropped");
+        raycasterIsoValue_ = -1.0f;
+        queuedPicks_.clear();
+        return false;
+    }
+    raycasterIsoValue_ = isoValue_.get();
+    raycasterWorker_.submit([request](const MeasureWorker::CancelFlag&, MeasureWorker::Result&) {
+        return static_cast<bool>(request.get());
+    });
+    if (resultTimer_ && resultTimer_->isStopped())
+        resultTimer_->start(RESULT_POLL_INTERVAL);
+    return false;
+}
+
+bool PointFitting::addPickedPoint(const tgt::vec4& fhp) {
+    const VolumeBase* refVolume = refInport_.getData();
+    if (!refVolume)
+        return false;
+
+    tgt::vec3 pickedPos = fhp.xyz();
+    if(poitools::isSurfaceHit(toCore(pickedPos))){
+        mouseCurPos3D_ = refVolume->getTextureToWorldMatrix() * pickedPos;
+        mouseDown_ = true;
+
+        // picks close to an existing point are dropped or moved onto it
+        updatePointIndex();
+        size_t nearestId = 0;
+        if (!nearbyPicks_.isSelected("add") && pointIndex_.findNearest(toCore(mouseCurPos3D_), nearbyRadius_.get(), nearestId)) {
+            const size_t nearest = findPoint(nearestId);
+            if (nearbyPicks_.isSelected("reject")) {
+                LINFO("Rejected pick next to point " << nearest + 1);
+                return false;
+            }
+            mouseCurPos3D_ = pointsList_[nearest];
+        }
+
+        std::stringstream out;
+        out << mouseCurPos3D_.x << " " << mouseCurPos3D_.y << " " << mouseCurPos3D_.z;
+        LINFO(out.str());
+        appendPoint(mouseCurPos3D_);
+        pointsGeneration_++;
+        journal(poitools::POINT_ADD, { mouseCurPos3D_.x, mouseCurPos3D_.y, mouseCurPos3D_.z });
+        numSelectedPoints_++;
+        distancesDirty_ = true;
+        return true;
+    }
+    return false;
+}
+
+void PointFitting::removeNearest(tgt::MouseEvent* e) {
+    if (!(e->action() & tgt::MouseEvent::PRESSED) || pointsList_.empty())
+        return;
+
+    // the point is removed once the first-hit-point under the cursor is known
+    tgt::ivec2 pos = clampToViewport(tgt::ivec2(e->coord().x, e->viewport().y-e->coord().y));
+    tgt::vec4 fhp;
+    if (pick(PICK_REMOVE, pos, fhp))
+        removeNearestPoint(fhp);
+    e->accept();
+    invalidate();
+}
+
+bool PointFitting::removeNearestPoint(const tgt::vec4& fhp) {
+    const VolumeBase* refVolume = refInport_.getData();
+    if (!refVolume || !poitools::isSurfaceHit(toCore(fhp.xyz())))
+        return false;
+
+    updatePointIndex();
+    tgt::vec3 pos = refVolume->getTextureToWorldMatrix() * fhp.xyz();
+    size_t nearestId = 0;
+    if (!pointIndex_.findNearest(toCore(pos), std::numeric_limits<float>::max(), nearestId))
+        return false;
+    const size_t nearest = findPoint(nearestId);
+
+    // the landmarks of a template are identified by their order, only free point sets may have gaps
+    if (!mandatoryPoints_.empty() && nearest + 1 != pointsList_.size()) {
+        LWARNING("Only the last landmark of a template can be removed, use undo to go back");
+        return false;
+    }
+
+    LINFO("Removed point " << nearest + 1);
+    pointIndex_.remove(nearestId, toCore(pointsList_[nearest]));
+    pointsList_.erase(pointsList_.begin() + nearest);
+    pointIds_.erase(pointIds_.begin() + nearest);
+    pointsGeneration_++;
+    journal(poitools::POINT_REMOVE, { static_cast<float>(nearest) });
+    numSelectedPoints_--;
+    distancesDirty_ = true;
+    return true;
+}
+
+void PointFitting::updatePointIndex() {
+    // cells of about the marker size keep both radius queries and nearest point queries local
+    const VolumeBase* refVolume = refInport_.getData();
+    if (refVolume)
+        pointIndex_.setCellSize(std::max(tgt::length(refVolume->getCubeSize()) * 0.02f, nearbyRadius_.get()));
+}
+
+void PointFitting::appendPoint(const tgt::vec3& pos) {
+    pointsList_.push_back(pos);
+    pointIds_.push_back(nextPointId_);
+    pointIndex_.insert(nextPointId_++, toCore(pos));
+}
+
+size_t PointFitting::findPoint(size_t id) const {
+    return std::lower_bound(pointIds_.begin(), pointIds_.end(), id) - pointIds_.begin();
+}
+
+void PointFitting::clearPoints() {
+    picker_.clear();
+    queuedPicks_.clear();
+    pointsList_.clear();
+    pointIds_.clear();
+    pointIndex_.clear();
+    numSelectedPoints_ = 0;
+    pointsGeneration_++;
+    distancesDirty_ = true;
+    journal(poitools::POINT_CLEAR);
+}
+
 void PointFitting::process() {
+    // restore the points of an interrupted session before anything else touches them
+    if (journalDirty_) {
+        openJournal();
+    } else if (journal_.hasFailed()) {
+        LERROR("Writing the session journal failed, it is closed");
+        journal_.close();
+    }
+
     if (pointListFile_.get() != "" && forceReload_) {
         try {
             readMandatoryPoints();
+            distancesDirty_ = true;
+            pointsGeneration_++;
         }
         catch (tgt::FileNotFoundException& f) {
             LERROR(f.what());
@@ -143,8 +434,35 @@ void PointFitting::process() {
         forceReload_=false;
     }
 
-    if (getInvalidationLevel() >= Processor::INVALID_PROGRAM)
+    if (getInvalidationLevel() >= Processor::INVALID_PROGRAM) {
         compile();
+        overlayKey_.clear();
+    }
+
+    // timings of the previous frames, gpu results arrive with a delay
+    timer_.setEnabled(enableTimings_.get());
+    timer_.setTraceFile(enableTimings_.get() ? traceFile_.get() : "");
+    timer_.collect();
+    if (timer_.isEnabled())
+        outportTimings_.setData(timer_.getReport());
+
+    if (imgInport_.hasChanged())
+        imageGeneration_++;
+
+    // the first-hit-points have been re-rendered, drop the host copy
+    if (getFhpPort().hasChanged())
+        fhpCache_.invalidate();
+    updateFhpFormat();
+
+    // a new volume needs a new surface graph, running jobs may still use the old one
+    if (refInport_.hasChanged()) {
+        worker_.cancel();
+        worker_.wait();
+        geodesic_.reset();
+        raycaster_.reset();
+        raycasterIsoValue_ = -1.0f;
+        distancesDirty_ = true;
+    }
 
     const VolumeBase* refVolume = refInport_.getData();
     if(!refVolume) {
@@ -152,29 +470,98 @@ void PointFitting::process() {
         return;
     }
 
+    // add the points picked since the last frame
+    {
+        StageTimer::Scope scope(timer_, "apply picks");
+        std::vector<AsyncFhpPicker::PickResult> picks = picker_.poll();
+        for (size_t i = 0; i < picks.size(); ++i) {
+            if (picks[i].tag == PICK_REMOVE)
+                removeNearestPoint(picks[i].fhp);
+            else
+                addPickedPoint(picks[i].fhp);
+        }
+
+        // the remaining readbacks are applied in one of the next renderings, see timerEvent()
+        if (picker_.isBusy() && resultTimer_ && resultTimer_->isStopped())
+            resultTimer_->start(RESULT_POLL_INTERVAL);
+
+        // ray casting picks wait for the brick hierarchy
+        if (!queuedPicks_.empty() && updateRaycaster()) {
+            const FhpRaycaster::View view = FhpRaycaster::createView(camera_.get(), imgInport_.getSize());
+            for (size_t i = 0; i < queuedPicks_.size(); ++i) {
+                const tgt::vec4 fhp = raycaster_->getFhp(view, queuedPicks_[i].second);
+                if (queuedPicks_[i].first == PICK_REMOVE)
+                    removeNearestPoint(fhp);
+                else
+                    addPickedPoint(fhp);
+            }
+            queuedPicks_.clear();
+        }
+    }
+
+    // the next subject is loaded in the background already, so it is requested right after the last landmark
+    if (advanceSession_.get() && !mandatoryPoints_.empty() && pointsList_.size() >= mandatoryPoints_.size()) {
+        StageTimer::Scope scope(timer_, "finish subject");
+        finishSubject(refVolume);
+    }
+
+    // distance matrix of the picked points, only the rows of new points are computed
+    if (computeDistances_.get() && distancesDirty_) {
+        StageTimer::Scope scope(timer_, "submit distances");
+        submitDistances();
+    }
+    MeasureWorker::Result result;
+    if (worker_.fetch(result))
+        outportDistances_.setData(result.text);
+
+
+    // the overlay is only rendered again if one of its inputs has changed, not for unrelated properties
+    const tgt::ivec2 size = outport_.getSize();
+    InputKey overlayKey;
+    overlayKey.add(imageGeneration_).add(size).add(camera_.get().getViewMatrix()).add(camera_.get().getProjectionMatrix(size))
+              .add(refVolume).add(refVolume->getCubeSize()).add(pointsGeneration_).add(numSelectedPoints_).add(renderSpheres_.get());
+    if (overlayKey != overlayKey_) {
+        overlayKey_ = overlayKey;
+        renderOverlay(refVolume);
+    }
 
+    // downstream processors only see a new geometry if the points have changed
+    if (publishedGeneration_ != pointsGeneration_ || !outportPicked_.hasData()) {
+        StageTimer::Scope scope(timer_, "geometry");
+        PointListGeometryVec3* positions = new PointListGeometryVec3();
+        positions->setData(pointsList_);
+        outportPicked_.setData(positions);
+        publishedGeneration_ = pointsGeneration_;
+    }
+}
+
+void PointFitting::renderOverlay(const VolumeBase* refVolume) {
     outport_.activateTarget();
     outport_.clearTarget();
 
-    TextureUnit colorUnit, depthUnit;
-    imgInport_.bindTextures(colorUnit.getEnum(), depthUnit.getEnum());
+    {
+        StageTimer::Scope scope(timer_, "composite", true);
+        TextureUnit colorUnit, depthUnit;
+        imgInport_.bindTextures(colorUnit.getEnum(), depthUnit.getEnum());
 
-    // initialize shader
-    program_->activate();
-    setGlobalShaderParameters(program_);
-    program_->setUniform("colorTex_", colorUnit.getUnitNumber());
-    program_->setUniform("depthTex_", depthUnit.getUnitNumber());
-    imgInport_.setTextureParameters(program_, "textureParameters_");
+        // initialize shader
+        program_->activate();
+        setGlobalShaderParameters(program_);
+        program_->setUniform("colorTex_", colorUnit.getUnitNumber());
+        program_->setUniform("depthTex_", depthUnit.getUnitNumber());
+        imgInport_.setTextureParameters(program_, "textureParameters_");
 
-    renderQuad();
+        renderQuad();
 
-    program_->deactivate();
-    TextureUnit::setZeroUnit();
+        program_->deactivate();
+        TextureUnit::setZeroUnit();
+    }
 
     // render text
     glDisable(GL_DEPTH_TEST);
 
     if(numSelectedPoints_ < mandatoryPoints_.size()){
+        StageTimer::Scope scope(timer_, "label", true);
         std::stringstream out;
         out << mandatoryPoints_.at(numSelectedPoints_);
         std::string label = out.str();
@@ -201,47 +588,110 @@ void PointFitting::process() {
     // render points in points list
     if(!pointsList_.empty()) {
         if(renderSpheres_.get()) {
-            IMode.setLightSource(lightSource_);
-            IMode.color(255.0f, 0.5f, 0.5f, 0.5f);
-            IMode.setMaterial(material_);
+            StageTimer::Scope scope(timer_, "markers", true);
             float sphereRadius = tgt::length(refVolume->getCubeSize())*0.005;
-
-            // set modelview and projection matrices
-            MatStack.matrixMode(tgt::MatrixStack::PROJECTION);
-            MatStack.pushMatrix();
-            MatStack.loadMatrix(camera_.get().getProjectionMatrix(outport_.getSize()));
-
-            MatStack.matrixMode(tgt::MatrixStack::MODELVIEW);
-            MatStack.pushMatrix();
-            MatStack.loadIdentity();
-            MatStack.loadMatrix(camera_.get().getViewMatrix());
-
-            for (auto point = pointsList_.begin(); point != pointsList_.end(); ++point) {
-                MatStack.pushMatrix();
-                MatStack.translate(point->x, point->y, point->z);
-                MatStack.scale(tgt::vec3(sphereRadius));
-                mesh_.render();
-                MatStack.popMatrix();
-            }
-
-            MatStack.popMatrix();
-
-            MatStack.matrixMode(tgt::MatrixStack::PROJECTION);
-            MatStack.popMatrix();
+            markers_.setPoints(pointsList_);
+            markers_.render(camera_.get().getViewMatrix(), camera_.get().getProjectionMatrix(outport_.getSize()),
+                            sphereRadius, tgt::vec4(1.0f, 0.5f, 0.5f, 0.5f), lightSource_, material_);
         }
-
-            MatStack.matrixMode(tgt::MatrixStack::MODELVIEW);
-            IMode.color(1.0f, 1.0f, 1.0f, 1.0f);
     }
 
 
     outport_.deactivateTarget();
     LGL_ERROR;
+}
+
+void PointFitting::invalidateDistances() {
+    distancesDirty_ = true;
+    if (!computeDistances_.get()) {
+        worker_.cancel();
+        outportDistances_.clear();
+    }
+    invalidate();
+}
+
+void PointFitting::submitDistances() {
+    const VolumeBase* refVolume = refInport_.getData();
+    if (!refVolume)
+        return;
+    distancesDirty_ = false;
+
+    std::vector<poitools::Vec3> points;
+    for (size_t i = 0; i < pointsList_.size(); ++i)
+        points.push_back(toCore(pointsList_[i]));
+    const std::vector<std::string> names = mandatoryPoints_;
+    const size_t extractionBudget = static_cast<size_t>(extractionMemory_.get()) << 20;
+    const SurfaceCache::Request<GeodesicEngine> engine = PoiTools::getSurfaceCache().requestGeodesicEngine(refVolume, isoValue_.get(),
+        geodesicStride_.get(), extractionBudget);
+
+    worker_.submit([this, points, names, engine](const MeasureWorker::CancelFlag& cancel, MeasureWorker::Result& result) {
+        std::function<bool()> cancelled = [&cancel]() { return cancel.isCancelled(); };
+        poitools::ThreadPool& pool = poitools::ThreadPool::getShared();
+        queryStates_.resize(pool.getNumThreads());
+
+        // the surface graph is built once per volume, a new graph invalidates all surface distances
+        geodesic_ = engine.get();
+        if (!geodesic_)
+            return false;
+        if (geodesic_->getRevision() != surfaceRevision_) {
+            surface_.clear();
+            surfaceRevision_ = geodesic_->getRevision();
+        }
+
+        // the rows of the surface distances run in parallel, one search per source landmark
+        std::vector<tgt::vec3> targets;
+        std::vector<int> targetVertices;
+        for (size_t i = 0; i < points.size(); ++i) {
+            targets.push_back(toTgt(points[i]));
+            targetVertices.push_back(geodesic_->findNearestVertex(targets.back()));
+        }
+        poitools::DistanceMatrix::RowFunction surfaceRows = [&](size_t source, size_t thread, float* row) {
+            geodesic_->queryAll(queryStates_[thread], targets[source], targets, targetVertices, row, cancelled);
+        };
+
+        if (!euclidean_.update(points, poitools::euclideanRows(points), pool, cancelled)
+            || !surface_.update(points, surfaceRows, pool, cancelled))
+            return false;
+
+        // one comma separated table per matrix, negative surface distances mark unconnected points
+        std::ostringstream out;
+        out << std::setprecision(6);
+        const poitools::DistanceMatrix* matrices[] = { &euclidean_, &surface_ };
+        const char* titles[] = { "euclidean", "surface" };
+        for (int m = 0; m < 2; ++m) {
+            if (m > 0)
+                out << "\n";
+            out << titles[m];
+            for (size_t j = 0; j < points.size(); ++j)
+                out << "," << (j < names.size() ? names[j] : "P" + std::to_string(j + 1));
+            out << "\n";
+            for (size_t i = 0; i < points.size(); ++i) {
+                out << (i < names.size() ? names[i] : "P" + std::to_string(i + 1));
+                for (size_t j = 0; j < points.size(); ++j)
+                    out << "," << matrices[m]->get(i, j);
+                out << "\n";
+            }
+        }
+        result.text = out.str();
+        return true;
+    });
+
+    if (resultTimer_ && resultTimer_->isStopped())
+        resultTimer_->start(RESULT_POLL_INTERVAL);
+}
 
-    PointListGeometryVec3* positions = new PointListGeometryVec3();
-    positions->setData(pointsList_);
-    outportPicked_.setData(positions);
+void PointFitting::timerEvent(tgt::TimeEvent* /*e*/) {
+    // readbacks that are still in flight are polled by every rendering until they have arrived
+    if (picker_.isBusy()) {
+        invalidate();
+        return;
+    }
 
+    // publish the distance matrix and apply the queued picks as soon as the brick hierarchy is there
+    if (!worker_.isBusy() && !raycasterWorker_.isBusy()) {
+        resultTimer_->stop();
+        invalidate();
+    }
 }
 
 void PointFitting::readMandatoryPoints() {
@@ -255,20 +705,106 @@ void PointFitting::readMandatoryPoints() {
 
     LINFO("Reading Point List File " << pointListFile_.get());
 
-    std::string str;
-    std::ifstream pointListFile(pointListFile_.get());
-    while (std::getline(pointListFile, str))
-    {
-	// Line contains string of length > 0 then save it in vector
-	if(str.size() > 0)
-		mandatoryPoints_.push_back(str);
+    if (!poitools::readLandmarkTemplate(filename, mandatoryPoints_))
+        throw tgt::FileNotFoundException("File could not be opened", filename);
+}
+
+void PointFitting::finishSubject(const VolumeBase* refVolume) {
+    // named after the volume file, or numbered for volumes that have not been loaded from a file
+    std::string name = tgt::FileSystem::baseName(refVolume->getOrigin().getPath());
+    if (name.empty())
+        name = "subject_" + std::to_string(finishedSubjects_.get() + 1);
+    std::string path = (exportDirectory_.get().empty() ? VoreenApplication::app()->getUserDataPath() : exportDirectory_.get()) + "/" + name + ".txt";
+
+    std::vector<poitools::Vec3> points;
+    for (size_t i = 0; i < pointsList_.size(); ++i)
+        points.push_back(toCore(pointsList_[i]));
+    if (!poitools::writeLandmarks(path, points)) {
+        // the points are kept, so the subject can be finished again once the directory is fixed
+        LERROR("Cannot write " << path);
+        advanceSession_.set(false);
+        return;
+    }
+    LINFO("Exported " << points.size() << " points to " << path);
+
+    clearPoints();
+    finishedSubjects_.set(finishedSubjects_.get() + 1);
+}
+
+void PointFitting::exportPoints() {
+    if (exportFile_.get().empty()) {
+        LERROR("No point export file set");
+        return;
+    }
+    poitools::PointExporter exporter;
+    if (!exporter.open(exportFile_.get(), poitools::getExportFormat(exportFile_.get()))) {
+        LERROR("Cannot write " << exportFile_.get());
+        return;
+    }
+
+    // grouped by the volume file, the landmarks are labeled with the names of the mandatory points
+    const VolumeBase* refVolume = refInport_.getData();
+    if (refVolume)
+        exporter.setGroup(refVolume->getOrigin().getPath());
+    for (size_t i = 0; i < pointsList_.size(); ++i) {
+        std::string label = i < mandatoryPoints_.size() ? mandatoryPoints_[i] : "point_" + std::to_string(i + 1);
+        exporter.writePoint(label, toCore(pointsList_[i]));
     }
+    if (!exporter.close()) {
+        LERROR("Writing " << exportFile_.get() << " failed");
+        return;
+    }
+    LINFO("Exported " << pointsList_.size() << " points to " << exportFile_.get());
 }
 
 void PointFitting::forceReload() {
     forceReload_ = true;
-    pointsList_.clear();
+    clearPoints();
     invalidate();
 }
 
+void PointFitting::reopenJournal() {
+    journalDirty_ = true;
+    invalidate();
+}
+
+void PointFitting::openJournal() {
+    journalDirty_ = false;
+    journal_.close();
+    if (journalFile_.get().empty())
+        return;
+
+    // the points of the last session, including the index of the next mandatory point
+    StageTimer::Scope scope(timer_, "replay journal");
+    std::vector<poitools::JournalRecord> records;
+    long long validLength = 0;
+    if (!poitools::readJournal(journalFile_.get(), records, &validLength)) {
+        LERROR(journalFile_.get() << " is no session journal");
+        return;
+    }
+    if (!records.empty()) {
+        const std::vector<tgt::vec3> points = toTgt(poitools::replayPoints(records));
+        pointsList_.clear();
+        pointIds_.clear();
+        pointIndex_.clear();
+        updatePointIndex();
+        for (size_t i = 0; i < points.size(); ++i)
+            appendPoint(points[i]);
+        numSelectedPoints_ = pointsList_.size();
+        picker_.clear();
+        queuedPicks_.clear();
+        pointsGeneration_++;
+        distancesDirty_ = true;
+        LINFO("Restored " << pointsList_.size() << " points from " << records.size() << " journal records");
+    }
+
+    if (!journal_.open(journalFile_.get(), validLength))
+        LERROR("Cannot write session journal " << journalFile_.get());
+}
+
+void PointFitting::journal(poitools::JournalRecordType type, const std::vector<float>& values) {
+    if (journal_.isOpen())
+        journal_.append(poitools::JournalRecord(type, values));
+}
+
 } // namespace voreen
@@ -8,6 +8,8 @@
 #include "voreen/core/properties/floatproperty.h"
 #include "voreen/core/properties/intproperty.h"
 #include "voreen/core/properties/boolproperty.h"
+#include "voreen/core/properties/buttonproperty.h"
+#include "voreen/core/properties/optionproperty.h"
 #include "voreen/core/utils/stringutils.h"
 #include "voreen/core/datastructures/geometry/glmeshgeometry.h"
 
@@ -15,10 +17,36 @@
 #include "voreen/core/properties/filedialogproperty.h"
 
 #include "voreen/core/ports/volumeport.h"
-
+#include "voreen/core/ports/textport.h"
+
+#include "../core/distancematrix.h"
+#include "../core/journal.h"
+#include "../core/landmarks.h"
+#include "../core/measure.h"
+#include "../core/pointexport.h"
+#include "../core/pointindex.h"
+#include "../core/threadpool.h"
+#include "../utils/asyncfhppicker.h"
+#include "../utils/coreadapter.h"
+#include "../utils/fhpcache.h"
+#include "../utils/fhpformat.h"
+#include "../utils/fhpraycaster.h"
+#include "../utils/geodesicengine.h"
+#include "../utils/inputkey.h"
+#include "../utils/measureworker.h"
+#include "../utils/pointmarkerrenderer.h"
+#include "../utils/stagetimer.h"
+#include "../utils/surfacecache.h"
+
+#include "tgt/event/eventhandler.h"
 #include "tgt/font.h"
 #include "tgt/glmath.h"
 #include "tgt/immediatemode/immediatemode.h"
+#include "tgt/timer.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace voreen {
 
@@ -37,6 +65,7 @@ public:
 
     void measure(tgt::MouseEvent* e);
     void undo(tgt::MouseEvent* e);
+    void removeNearest(tgt::MouseEvent* e);
 
 protected:
     virtual void setDescriptions() {
@@ -44,24 +73,61 @@ protected:
                 "Allows to interactively fit points of interest on the surface rendered volumes. "
                 "This processor expects the rendered volume, a rendering of the first hitpoints "
                 "(use FHP compositing in a SingleVolumeRaycaster), and the volume that is currently "
-                "being rendered (for scaling information) as input."
+                "being rendered (for scaling information) as input. With CPU ray casting picking the "
+                "first-hit-points are computed from the volume and the camera, no FHP rendering is needed. "
+                "With the depth only input any rendering of the surface can be connected to the FHP depth port, "
+                "the positions are reconstructed from its depth. In a session (see SubjectQueue) the points "
+                "of a subject are exported once all mandatory points are placed, and the next subject is requested."
                 );
     }
 
     void process();
     virtual void initialize();
+    virtual void deinitialize();
+
+    virtual void timerEvent(tgt::TimeEvent* e);
 
 private:
+    enum PickTag {
+        PICK_ADD,
+        PICK_REMOVE
+    };
+
+    static const int RESULT_POLL_INTERVAL = 15; ///< ms between checks for a finished distance matrix
+
     tgt::ivec2 clampToViewport(tgt::ivec2 mousePos);
+    bool pick(int tag, tgt::ivec2 pos, tgt::vec4& fhp); ///< ray casts or reads the cache, false if the pick has been queued instead
+    bool updateRaycaster();                    ///< false while the brick hierarchy of raycaster_ is built on raycasterWorker_
+    void updateFhpFormat();                    ///< passes the format of the FHP input to the cache and the picker
+    RenderPort& getFhpPort();                  ///< FHP input of the selected format, the depth input in depth format
+    bool addPickedPoint(const tgt::vec4& fhp); ///< appends the picked point unless it is background or rejected
+    bool removeNearestPoint(const tgt::vec4& fhp); ///< removes the picked point closest to the first-hit-point
+    void updatePointIndex();                   ///< adapts the grid to the volume, rebuilds it if necessary
+    void appendPoint(const tgt::vec3& pos);    ///< adds pos to pointsList_ and the index under a new id
+    size_t findPoint(size_t id) const;         ///< position of the point with id in pointsList_
+    void clearPoints();                        ///< drops all points, e.g. for the next subject
 
     void readMandatoryPoints(); // read mandatory points from file
     void forceReload(); // reload the mandatory points
+    void finishSubject(const VolumeBase* refVolume); ///< exports the points and requests the next subject
+    void exportPoints();    ///< writes the labeled points to exportFile_
+    void reopenJournal();   ///< the journal is replayed and opened in the next process()
+    void openJournal();     ///< restores the points from the journal file and appends to it from now on
+    void journal(poitools::JournalRecordType type, const std::vector<float>& values = std::vector<float>());
+
+    void renderOverlay(const VolumeBase* refVolume); ///< image, label and markers into outport_
+
+    void invalidateDistances();     ///< the distance matrix has to be updated in the next process()
+    void submitDistances();         ///< updates the distance matrix on the worker
 
     RenderPort imgInport_;
     RenderPort fhpInport_;
+    RenderPort fhpDepthInport_;     ///< any rendering of the surface, only its depth is read
     VolumePort refInport_;
     RenderPort outport_;
     GeometryPort outportPicked_;
+    TextPort outportTimings_;
+    TextPort outportDistances_;
     bool forceReload_;
 
     long unsigned int numSelectedPoints_;
@@ -69,17 +135,63 @@ private:
 
     EventProperty<PointFitting> mouseEventProp_;
     EventProperty<PointFitting> mouseUndoProp_;
+    EventProperty<PointFitting> mouseRemoveProp_;
     CameraProperty camera_;
     BoolProperty renderSpheres_;
+    StringOptionProperty pickingMode_;   ///< first-hit-point image or CPU ray casting
+    StringOptionProperty fhpFormat_;     ///< positions or depth in the FHP input
+    StringOptionProperty nearbyPicks_;   ///< what happens to picks close to an existing point
+    FloatProperty nearbyRadius_;         ///< world units
+    BoolProperty enableTimings_;         ///< publish per-stage timings on outportTimings_
+    FileDialogProperty traceFile_;       ///< optional chrome trace of the timings
+    BoolProperty computeDistances_;      ///< publish the distance matrix of the picked points
+    FloatProperty isoValue_;             ///< iso value of the surface used for surface distances and ray casting
+    IntProperty geodesicStride_;         ///< voxel subsampling of the geodesic surface graph
+    IntProperty extractionMemory_;       ///< MiB of volume data read at a time while the surface graph is built
+    BoolProperty advanceSession_;        ///< finish the subject once all mandatory points are placed
+    FileDialogProperty exportDirectory_; ///< the points of finished subjects are written to
+    IntProperty finishedSubjects_;       ///< link to the subject index of a SubjectQueue
+    FileDialogProperty journalFile_;     ///< every change of the points is appended to, empty for none
+    FileDialogProperty exportFile_;      ///< CSV or binary export (.poix) of the points
+    ButtonProperty exportPoints_;
 
     tgt::ivec2 mouseCurPos2D_;
     tgt::vec3 mouseCurPos3D_;
     bool mouseDown_;
 
     std::vector<tgt::vec3> pointsList_;
+    unsigned int pointsGeneration_;     ///< incremented whenever pointsList_ or the landmark names change
+    unsigned int publishedGeneration_;  ///< pointsGeneration_ of the geometry on outportPicked_
+    unsigned int imageGeneration_;      ///< incremented whenever imgInport_ has new data
+    InputKey overlayKey_;               ///< inputs of the current rendering in outport_
+    std::vector<size_t> pointIds_;      ///< id of every point in pointsList_, ascending
+    size_t nextPointId_;
+    poitools::PointIndex pointIndex_;   ///< pointsList_ by pointIds_, ids stay valid when points before them are removed
+
+    FhpCache fhpCache_; ///< host copy of the fhp target, refreshed when the FHP input changes
+    AsyncFhpPicker picker_; ///< non-blocking readbacks for picks the cache cannot answer
+    std::shared_ptr<const FhpRaycaster> raycaster_; ///< ray casting picking mode, from the module's cache
+    std::vector<std::pair<int, tgt::ivec2> > queuedPicks_; ///< ray casting picks waiting for the brick hierarchy
+    float raycasterIsoValue_;   ///< iso value of the build on raycasterWorker_, negative if there is none
+    poitools::JournalWriter journal_;   ///< writes and syncs on a thread of its own
+    bool journalDirty_;                 ///< journalFile_ has changed since the journal has been opened
+
+    bool distancesDirty_;
+    MeasureWorker worker_;    ///< computes the distance matrix
+    MeasureWorker raycasterWorker_; ///< builds the brick hierarchy of raycaster_, so the distances do not cancel it
+    tgt::EventHandler resultHandler_;
+    tgt::Timer* resultTimer_; ///< runs while a worker or a readback is busy, see timerEvent()
+
+    // owned by the worker thread while jobs are running
+    std::shared_ptr<const GeodesicEngine> geodesic_; ///< surface graph of the reference volume, from the module's cache
+    std::vector<GeodesicEngine::QueryState> queryStates_; ///< one per thread of the shared pool
+    poitools::DistanceMatrix euclidean_;
+    poitools::DistanceMatrix surface_;
+    unsigned int surfaceRevision_;  ///< revision of geodesic_ surface_ has been computed on
 
     tgt::Font font_;
-    GlMeshGeometryUInt16Normal mesh_;
+    PointMarkerRenderer markers_; ///< draws all picked points with one instanced draw call
+    StageTimer timer_;
     tgt::ImmediateMode::LightSource lightSource_;
     tgt::ImmediateMode::Material material_;
 
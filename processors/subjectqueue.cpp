@@ -0,0 +1,109 @@
+#include "subjectqueue.h"
+
+#include "voreen/core/voreenapplication.h"
+
+#include "tgt/filesystem.h"
+
+#include <fstream>
+
+namespace voreen {
+
+SubjectQueue::SubjectQueue()
+    : Processor()
+    , outport_(Port::OUTPORT, "volume.output", "Subject Volume", false)
+    , sessionFile_("sessionFile", "Session File", "Open Session File", VoreenApplication::app()->getUserDataPath(), "Session File (*.txt)")
+    , subject_("subject", "Subject", 0, 0, 1000000)
+    , nextSubject_("nextSubject", "Next Subject")
+    , subjectPath_("subjectPath", "Current Volume", "")
+    , loadedSubject_(-1)
+{
+    addPort(outport_);
+
+    addProperty(sessionFile_);
+    addProperty(subject_);
+    addProperty(nextSubject_);
+    addProperty(subjectPath_);
+    subjectPath_.setReadOnlyFlag(true);
+
+    sessionFile_.onChange(MemberFunctionCallback<SubjectQueue>(this, &SubjectQueue::readSubjects));
+    nextSubject_.onChange(MemberFunctionCallback<SubjectQueue>(this, &SubjectQueue::nextSubject));
+}
+
+SubjectQueue::~SubjectQueue() {
+}
+
+Processor* SubjectQueue::create() const {
+    return new SubjectQueue();
+}
+
+void SubjectQueue::initialize() {
+    Processor::initialize();
+    readSubjects();
+}
+
+void SubjectQueue::deinitialize() {
+    prefetcher_.clear();
+    outport_.clear();
+    Processor::deinitialize();
+}
+
+void SubjectQueue::readSubjects() {
+    subjects_.clear();
+    loadedSubject_ = -1;
+    prefetcher_.clear();
+
+    std::ifstream file(sessionFile_.get().c_str());
+    if (!file) {
+        if (sessionFile_.get() != "")
+            LERROR("Cannot read session file " << sessionFile_.get());
+        return;
+    }
+    const std::string directory = tgt::FileSystem::dirName(sessionFile_.get());
+    std::string line;
+    while (std::getline(file, line)) {
+        // tolerate files written on windows
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        if (line.empty() || line[0] == '#')
+            continue;
+        bool absolute = line[0] == '/' || line[0] == '\\' || (line.size() > 1 && line[1] == ':');
+        subjects_.push_back(absolute ? line : directory + "/" + line);
+    }
+    LINFO("Session with " << subjects_.size() << " subjects");
+    invalidate();
+}
+
+void SubjectQueue::nextSubject() {
+    subject_.set(subject_.get() + 1);
+}
+
+void SubjectQueue::process() {
+    const int index = subject_.get();
+    if (index == loadedSubject_)
+        return;
+    loadedSubject_ = index;
+
+    if (index >= static_cast<int>(subjects_.size())) {
+        if (!subjects_.empty())
+            LINFO("Session finished");
+        outport_.clear();
+        subjectPath_.set("");
+        return;
+    }
+
+    // usually the volume has been prefetched while the previous subject was fitted
+    VolumeBase* volume = prefetcher_.take(subjects_[index]);
+    if (index + 1 < static_cast<int>(subjects_.size()))
+        prefetcher_.prefetch(subjects_[index + 1]);
+
+    subjectPath_.set(subjects_[index]);
+    if (!volume) {
+        LERROR("Cannot load " << subjects_[index]);
+        outport_.clear();
+        return;
+    }
+    LINFO("Subject " << index + 1 << "/" << subjects_.size() << ": " << subjects_[index]);
+    outport_.setData(volume, true);
+}
+
+} // namespace voreen
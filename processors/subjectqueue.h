@@ -0,0 +1,65 @@
+#ifndef VRN_POITOOLS_SUBJECTQUEUE_H
+#define VRN_POITOOLS_SUBJECTQUEUE_H
+
+#include "voreen/core/processors/processor.h"
+#include "voreen/core/properties/buttonproperty.h"
+#include "voreen/core/properties/filedialogproperty.h"
+#include "voreen/core/properties/intproperty.h"
+#include "voreen/core/properties/stringproperty.h"
+#include "voreen/core/ports/volumeport.h"
+
+#include "../utils/volumeprefetcher.h"
+
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Provides the volumes of a fitting session one after another. The volume of
+ * the next subject is loaded in the background while the current one is fitted.
+ */
+class VRN_CORE_API SubjectQueue : public Processor {
+public:
+    SubjectQueue();
+    ~SubjectQueue();
+    virtual Processor* create() const;
+
+    virtual std::string getCategory() const  { return "Input";        }
+    virtual std::string getClassName() const { return "SubjectQueue"; }
+    virtual CodeState getCodeState() const   { return CODE_STATE_TESTING; }
+
+protected:
+    virtual void setDescriptions() {
+        setDescription(
+                "Outputs the volumes listed in a session file one after another, e.g. to fit the same "
+                "landmarks on a series of scans. The session file holds one volume path per line, relative "
+                "paths refer to the directory of the session file. The next volume is loaded and decoded in "
+                "the background while the current one is shown. Link the subject index to the finished "
+                "subjects of a PointFitting processor to advance once all landmarks are placed."
+                );
+    }
+
+    void process();
+    virtual void initialize();
+    virtual void deinitialize();
+
+private:
+    void readSubjects();    ///< reads the session file
+    void nextSubject();
+
+    VolumePort outport_;
+
+    FileDialogProperty sessionFile_;    ///< volume paths, one per line
+    IntProperty subject_;               ///< index of the current subject
+    ButtonProperty nextSubject_;
+    StringProperty subjectPath_;        ///< path of the current subject, read only
+
+    std::vector<std::string> subjects_;
+    int loadedSubject_;                 ///< subject on the outport, -1 for none
+    VolumePrefetcher prefetcher_;       ///< the subject after the loaded one
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_SUBJECTQUEUE_H
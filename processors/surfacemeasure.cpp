@@ -1,9 +1,12 @@
 #include "surfacemeasure.h"
 
+#include "../poitools.h"
+
 #include "voreen/core/voreenapplication.h"
 
 #include "tgt/textureunit.h"
 
+#include <iomanip>
 #include <sstream>
 
 using tgt::TextureUnit;
@@ -15,37 +18,96 @@ SurfaceMeasure::SurfaceMeasure()
     : ImageProcessor("pointfitting")
     , imgInport_(Port::INPORT, "image", "Image Input")
     , fhpInport_(Port::INPORT, "fhp", "First-hit-points Input", false, Processor::INVALID_PROGRAM, RenderPort::RENDERSIZE_DEFAULT, GL_RGBA16F)
+    , fhpDepthInport_(Port::INPORT, "fhp.depth", "First-hit Depth Input", false, Processor::INVALID_PROGRAM, RenderPort::RENDERSIZE_DEFAULT, GL_R32F, GL_DEPTH_COMPONENT32F)
     , refInport_(Port::INPORT, "refvol", "Reference Volume", false)
     , outport_(Port::OUTPORT, "image.output", "Image Output")
     , outportDistance_(Port::OUTPORT, "outport.distance", "Points on the surface")
     , outportDistanceText_(Port::OUTPORT, "outport.distancetext", "Calculated distance as Text")
+    , outportTimings_(Port::OUTPORT, "outport.timings", "Stage Timings")
     , mouseEventProp_("mouseEvent.measure", "Surface measure", this, &SurfaceMeasure::measure, tgt::MouseEvent::MOUSE_BUTTON_LEFT, tgt::MouseEvent::MOTION | tgt::MouseEvent::PRESSED | tgt::MouseEvent::RELEASED, tgt::Event::ALT, false)
     , mouseUndoProp_("mouseEvent.undo", "Undo Surface measure", this, &SurfaceMeasure::undo, tgt::MouseEvent::MOUSE_BUTTON_RIGHT, tgt::MouseEvent::PRESSED | tgt::MouseEvent::RELEASED, tgt::Event::ALT, false)
     , camera_("camera", "Camera", tgt::Camera(tgt::vec3(0.f, 0.f, 3.5f), tgt::vec3(0.f, 0.f, 0.f), tgt::vec3(0.f, 1.f, 0.f)))
     , renderSpheres_("renderSpheres", "Render Spheres", true)
+    , pickingMode_("pickingMode", "Picking")
+    , fhpFormat_("fhpFormat", "First-hit-point Input")
+    , distanceMode_("distanceMode", "Distance Mode")
+    , isoValue_("isoValue", "Surface Iso Value", 0.5f, 0.0f, 1.0f)
+    , geodesicStride_("geodesicStride", "Surface Graph Subsampling", 2, 1, 8)
+    , extractionMemory_("extractionMemory", "Surface Extraction Memory (MiB)", 256, 16, 65536)
+    , subPixelSampling_("subPixelSampling", "Sub-pixel Path Sampling", false)
+    , livePreview_("livePreview", "Live Distance Preview", true)
+    , showDistanceLabel_("showDistanceLabel", "Show Distance Label", true)
+    , showPath_("showPath", "Show Path", true)
+    , polylineMode_("polylineMode", "Polyline Measurement", false)
+    , clearPolyline_("clearPolyline", "Clear Polyline")
+    , enableTimings_("enableTimings", "Measure Stage Timings", false)
+    , traceFile_("traceFile", "Timing Trace File", "Select Trace File", VoreenApplication::app()->getUserDataPath(), "Chrome Trace (*.json)", FileDialogProperty::SAVE_FILE)
+    , journalFile_("journalFile", "Session Journal", "Select Session Journal", VoreenApplication::app()->getUserDataPath(), "Session Journal (*.poij)", FileDialogProperty::SAVE_FILE)
+    , exportFile_("exportFile", "Path Export File", "Select Export File", VoreenApplication::app()->getUserDataPath(), "Point Export (*.csv *.poix)", FileDialogProperty::SAVE_FILE)
+    , exportPath_("exportPath", "Export Path")
     , font_(VoreenApplication::app()->getFontPath("VeraMono.ttf"), 16)
     , mouseCurPos2D_(0.0f)
     , mouseCurPos3D_(0.0f)
     , mouseStartPos2D_(0.0f)
     , mouseStartPos3D_(0.0f)
     , mouseDown_(false)
+    , releasePending_(false)
+    , pathDirty_(false)
     , distance_(0)
     , mesh_()           //
     , lightSource_()    // Are initialized below
     , material_()       //
-    , pointsListX_()
-    , pointsListY_()
+    , raycasterIsoValue_(-1.0f)
+    , timer_("SurfaceMeasure")
+    , resultTimer_(0)
+    , finalJob_(0)
+    , journalDirty_(true)
+    , imageGeneration_(0)
+    , pathGeneration_(0)
 {
     addPort(imgInport_);
     addPort(fhpInport_);
+    addPort(fhpDepthInport_);
     addPort(refInport_);
     addPort(outport_);
     addPort(outportDistance_);
     addPort(outportDistanceText_);
+    addPort(outportTimings_);
 
     addProperty(camera_);
     addProperty(renderSpheres_);
 
+    pickingMode_.addOption("fhp", "First-hit-point Image");
+    pickingMode_.addOption("raycast", "CPU Ray Casting");
+    addProperty(pickingMode_);
+    fhpFormat_.addOption("positions", "Positions (RGBA)");
+    fhpFormat_.addOption("depth", "Depth Only");
+    addProperty(fhpFormat_);
+
+    distanceMode_.addOption("screen", "Screen Space Line");
+    distanceMode_.addOption("geodesic", "Geodesic Surface Path");
+    distanceMode_.addOption("circumference", "Plane Circumference");
+    addProperty(distanceMode_);
+    addProperty(isoValue_);
+    addProperty(geodesicStride_);
+    addProperty(extractionMemory_);
+    addProperty(subPixelSampling_);
+    addProperty(livePreview_);
+    addProperty(showDistanceLabel_);
+    addProperty(showPath_);
+    addProperty(polylineMode_);
+    addProperty(clearPolyline_);
+    polylineMode_.onChange(MemberFunctionCallback<SurfaceMeasure>(this, &SurfaceMeasure::clearPolyline));
+    distanceMode_.onChange(MemberFunctionCallback<SurfaceMeasure>(this, &SurfaceMeasure::clearPolyline));
+    clearPolyline_.onChange(MemberFunctionCallback<SurfaceMeasure>(this, &SurfaceMeasure::clearPolyline));
+    addProperty(enableTimings_);
+    addProperty(traceFile_);
+    addProperty(journalFile_);
+    journalFile_.onChange(MemberFunctionCallback<SurfaceMeasure>(this, &SurfaceMeasure::reopenJournal));
+    addProperty(exportFile_);
+    addProperty(exportPath_);
+    exportPath_.onChange(MemberFunctionCallback<SurfaceMeasure>(this, &SurfaceMeasure::exportPath));
+
     addEventProperty(&mouseEventProp_);
     addEventProperty(&mouseUndoProp_);
 
@@ -65,12 +127,47 @@ SurfaceMeasure::SurfaceMeasure()
 SurfaceMeasure::~SurfaceMeasure() {
 }
 
+std::string SurfaceMeasure::generateHeader(const tgt::GpuCapabilities::GlVersion* version) {
+    // the compositing shader also draws the path
+    std::string header = ImageProcessor::generateHeader(version);
+    header += "#define SCREEN_OVERLAY\n";
+    return header;
+}
+
+void SurfaceMeasure::initialize() {
+    ImageProcessor::initialize();
+
+    // polls for finished measurements, so they are shown without waiting for the next mouse event
+    resultTimer_ = VoreenApplication::app()->createTimer(&resultHandler_);
+    resultHandler_.addListenerToBack(this);
+}
+
+void SurfaceMeasure::deinitialize() {
+    worker_.stop();
+    raycasterWorker_.stop();
+    // the shared surface data may be dropped from the cache now
+    geodesic_.reset();
+    raycaster_.reset();
+    journal_.close();
+    journalDirty_ = true;
+    delete resultTimer_;
+    resultTimer_ = 0;
+    overlay_.deinitialize();
+    picker_.deinitialize();
+    timer_.deinitialize();
+    ImageProcessor::deinitialize();
+}
+
 Processor* SurfaceMeasure::create() const {
     return new SurfaceMeasure();
 }
 
 bool SurfaceMeasure::isReady() const {
-    if (!isInitialized() || !imgInport_.isReady() || !fhpInport_.isReady() || !outport_.isReady() || !outportDistanceText_.isReady())
+    if (!isInitialized() || !imgInport_.isReady() || !outport_.isReady() || !outportDistanceText_.isReady())
+        return false;
+
+    // ray casting picks without first-hit-point rendering
+    if (pickingMode_.isSelected("fhp") && !(fhpFormat_.isSelected("depth") ? fhpDepthInport_ : fhpInport_).isReady())
         return false;
 
     return true;
@@ -96,170 +193,556 @@ void SurfaceMeasure::undo(tgt::MouseEvent* e) {
         mouseCurPos3D_ = tgt::vec4(0.0f);
         mouseStartPos3D_ = tgt::vec4(0.0f);
         distance_ = 0.0f;
+        releasePending_ = false;
+        picker_.clear();
+        queuedPicks_.clear();
+        worker_.cancel();
+
+        // in polyline mode only the last segment is removed
+        if (polylineMode_.get() && !segments_.empty()) {
+            segments_.pop_back();
+            if (distanceMode_.isSelected("circumference"))
+                finalJob_ = submitCircumference(getPlanePoints(false));
+            else
+                finalJob_ = submitPolyline(segments_);
+        } else {
+            path_.clear();
+            setOverlayPath(std::vector<tgt::vec3>());
+            if (journal_.isOpen())
+                journal_.append(poitools::JournalRecord(poitools::MEASURE_CLEAR, std::vector<float>()));
+        }
         invalidate();
         e->accept();
     }
 }
 
 void SurfaceMeasure::measure(tgt::MouseEvent* e) {
+    StageTimer::Scope scope(timer_, "mouse event");
     const VolumeBase* refVolume = refInport_.getData();
     if(!refVolume) {
         LERROR("No reference volume");
         return;
     }
 
+    if (getFhpPort().hasChanged())
+        fhpCache_.invalidate();
+    updateFhpFormat();
+    updateRaycaster();
+
     // left mouse button clicked for the first time
     if (e->action() & tgt::MouseEvent::PRESSED) {
-        mouseStartPos2D_ = clampToViewport(tgt::ivec2(e->coord().x, e->viewport().y-e->coord().y));
-        tgt::vec4 fhp;
-        fhpInport_.activateTarget();
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glReadPixels(mouseStartPos2D_.x, mouseStartPos2D_.y, 1, 1, GL_RGBA, GL_FLOAT, &fhp);
-        if (length(fhp) > 0.0f) {
-            mouseDown_ = true;
-            distance_ = 0.0f;
-            mouseStartPos3D_ = refVolume->getTextureToWorldMatrix() * fhp;
-            e->accept();
-        }
-        fhpInport_.deactivateTarget();
+        tgt::ivec2 pos = clampToViewport(tgt::ivec2(e->coord().x, e->viewport().y-e->coord().y));
+        picker_.clear();
+        queuedPicks_.clear();
+        worker_.cancel();
+        releasePending_ = false;
+        mouseDown_ = true;
+        distance_ = 0.0f;
+        requestPick(PICK_START, pos);
+        e->accept();
     }
 
     // mouse movement
     if (e->action() & tgt::MouseEvent::MOTION) {
         if (mouseDown_) {
-            // check domain
-            tgt::ivec2 oldMouseCurPos2D_ = mouseCurPos2D_;
-            mouseCurPos2D_ = clampToViewport(tgt::ivec2(e->coord().x, e->viewport().y-e->coord().y));
-            tgt::vec4 fhp;
-            fhpInport_.activateTarget();
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-            glReadPixels(mouseCurPos2D_.x, mouseCurPos2D_.y, 1, 1, GL_RGBA, GL_FLOAT, &fhp);
-            if (length(fhp) > 0.0f) {
-                mouseCurPos3D_ = refVolume->getTextureToWorldMatrix() * fhp;
-                invalidate();
-            } else {
-                mouseCurPos2D_ = oldMouseCurPos2D_;
-            }
+            requestPick(PICK_CURRENT, clampToViewport(tgt::ivec2(e->coord().x, e->viewport().y-e->coord().y)));
             e->accept();
-            fhpInport_.deactivateTarget();
         }
     }
 
     //mouse released
     if (e->action() & tgt::MouseEvent::RELEASED) {
         if (mouseDown_) {
-            distance_ = surfaceDistance();
+            // the distance is computed in process(), once all queued picks have been applied
+            releasePending_ = true;
             invalidate();
             e->accept();
         }
     }
 }
 
-  float SurfaceMeasure::measureX() {
+void SurfaceMeasure::requestPick(int tag, tgt::ivec2 pos) {
+    // ray casting picks wait for the brick hierarchy in order, a newer current position replaces a queued one
+    if (pickingMode_.isSelected("raycast")) {
+        if (raycaster_ && queuedPicks_.empty())
+            applyPick(tag, pos, raycaster_->getFhp(*rayView_, pos));
+        else if (tag == PICK_CURRENT && !queuedPicks_.empty() && queuedPicks_.back().first == PICK_CURRENT)
+            queuedPicks_.back().second = pos;
+        else
+            queuedPicks_.push_back(std::make_pair(tag, pos));
+        invalidate();
+        return;
+    }
+
+    // answer from the host copy if possible, but never overtake queued readbacks
+    tgt::vec4 fhp;
+    if (!picker_.isBusy() && fhpCache_.lookup(getFhpPort(), pos, fhp))
+        applyPick(tag, pos, fhp);
+    else
+        picker_.request(getFhpPort(), pos, tag, tag == PICK_CURRENT);
+    invalidate();
+}
+
+void SurfaceMeasure::applyPick(int tag, tgt::ivec2 pos, const tgt::vec4& fhp) {
     const VolumeBase* refVolume = refInport_.getData();
-    if(!refVolume) {
-      // this could never happen due to the test in the previous function,
-      // but we never know...
-      LERROR("No reference volume");
-      return 0;
+    if (!refVolume || !mouseDown_)
+        return;
+
+    if (tag == PICK_START) {
+        if (length(fhp) > 0.0f) {
+            mouseStartPos2D_ = pos;
+            mouseStartPos3D_ = refVolume->getTextureToWorldMatrix() * fhp;
+            mouseCurPos2D_ = mouseStartPos2D_;
+            mouseCurPos3D_ = mouseStartPos3D_;
+        } else {
+            // clicked onto the background, ignore the rest of this drag
+            mouseDown_ = false;
+            releasePending_ = false;
+        }
+    } else if (tag == PICK_CURRENT) {
+        if (length(fhp) > 0.0f) {
+            mouseCurPos2D_ = pos;
+            mouseCurPos3D_ = refVolume->getTextureToWorldMatrix() * fhp;
+            pathDirty_ = true;
+        }
     }
-    float dist=0;
-    tgt::vec3 tmp, tmp1, derivate;
-    tgt::vec3 one = tgt::vec3(1.0f);
-    tgt::ivec2 start, end;
+}
+
+RenderPort& SurfaceMeasure::getFhpPort() {
+    return fhpFormat_.isSelected("depth") ? fhpDepthInport_ : fhpInport_;
+}
+
+void SurfaceMeasure::updateFhpFormat() {
+    FhpFormat format;
+    if (fhpFormat_.isSelected("depth"))
+        format = FhpFormat::createDepth(camera_.get(), getFhpPort().getSize(), refInport_.getData());
+    fhpCache_.setFormat(format);
+    picker_.setFormat(format);
+}
+
+bool SurfaceMeasure::updateRaycaster() {
+    const VolumeBase* refVolume = refInport_.getData();
+    if (!pickingMode_.isSelected("raycast") || !refVolume) {
+        raycaster_.reset();
+        rayView_.reset();
+        queuedPicks_.clear();
+        return false;
+    }
+
+    // the brick hierarchy is built once per volume and iso value and shared, jobs keep the previous one alive
+    if (!raycaster_ || raycaster_->isDetached() || raycaster_->getIsoValue() != isoValue_.get()) {
+        raycaster_.reset();
+        rayView_.reset();
+        const SurfaceCache::Request<FhpRaycaster> request = PoiTools::getSurfaceCache().requestRaycaster(refVolume, isoValue_.get());
+        if (!request.isReady()) {
+            if (raycasterWorker_.isBusy())
+                return false;
+
+            // the build for this iso value has finished without an entry, e.g. without a RAM representation
+            if (raycasterIsoValue_ == isoValue_.get()) {
+                LWARNING("No brick hierarchy for ray casting, picks are dropped");
+                raycasterIsoValue_ = -1.0f;
+                queuedPicks_.clear();
+                return false;
+            }
+            raycasterIsoValue_ = isoValue_.get();
+            raycasterWorker_.submit([request](const MeasureWorker::CancelFlag&, MeasureWorker::Result&) {
+                return static_cast<bool>(request.get());
+            });
+            if (resultTimer_ && resultTimer_->isStopped())
+                resultTimer_->start(RESULT_POLL_INTERVAL);
+            return false;
+        }
+        raycaster_ = request.get();
+        raycasterIsoValue_ = -1.0f;
+    }
+    FhpRaycaster::View view = FhpRaycaster::createView(camera_.get(), imgInport_.getSize());
+    if (!rayView_ || rayView_->viewport != view.viewport || rayView_->screenToWorld != view.screenToWorld)
+        rayView_.reset(new FhpRaycaster::View(view));
+    return true;
+}
 
-    if (mouseStartPos2D_.x > mouseCurPos2D_.x){
-      start = mouseCurPos2D_;
-      end = mouseStartPos2D_;
+FhpSource SurfaceMeasure::getFhpSource(tgt::ivec2 lower, tgt::ivec2 upper) {
+    FhpSource source;
+    if (raycaster_) {
+        source.raycaster = raycaster_;
+        source.view = rayView_;
     } else {
-      start = mouseStartPos2D_;
-      end = mouseCurPos2D_;
+        fhpCache_.prefetch(getFhpPort(), lower, upper);
+        source.image = fhpCache_.getSnapshot();
     }
+    return source;
+}
 
-    float m = ((float)end.y - (float)start.y) / ((float)end.x - (float)start.x);
-    float b = start.y-m*start.x;
+void SurfaceMeasure::submitMeasurement(bool final) {
+    const VolumeBase* refVolume = refInport_.getData();
+    if(!refVolume) {
+      LERROR("No reference volume");
+      return;
+    }
+    pathDirty_ = false;
+
+    // in polyline mode the picks of all segments define the plane, a third one replaces the view direction
+    if (distanceMode_.isSelected("circumference")) {
+        if (polylineMode_.get() && final) {
+            PolylineEvaluator::Segment segment;
+            segment.start2D = mouseStartPos2D_;
+            segment.end2D = mouseCurPos2D_;
+            segment.start3D = mouseStartPos3D_.xyz();
+            segment.end3D = mouseCurPos3D_.xyz();
+            segments_.push_back(segment);
+            finalJob_ = submitCircumference(getPlanePoints(false));
+        } else {
+            unsigned int job = submitCircumference(getPlanePoints(true));
+            if (final)
+                finalJob_ = job;
+        }
+        return;
+    }
 
+    if (polylineMode_.get()) {
+        // the segment refers to the first-hit-points of the current view
+        PolylineEvaluator::Segment segment;
+        segment.start2D = mouseStartPos2D_;
+        segment.end2D = mouseCurPos2D_;
+        segment.start3D = mouseStartPos3D_.xyz();
+        segment.end3D = mouseCurPos3D_.xyz();
+        if (distanceMode_.isSelected("screen")) {
+            if (final)
+                segment.fhp = getFhpSource(tgt::min(mouseStartPos2D_, mouseCurPos2D_), tgt::max(mouseStartPos2D_, mouseCurPos2D_));
+            else
+                segment.fhp = getFhpSource(tgt::ivec2(0), getFhpPort().getSize() - 1);
+        }
 
+        std::vector<PolylineEvaluator::Segment> segments = segments_;
+        segments.push_back(segment);
+        if (final)
+            segments_ = segments;
+        unsigned int job = submitPolyline(segments);
+        if (final)
+            finalJob_ = job;
+        return;
+    }
 
+    // the jobs only use copies of the processor state, sampler_ and geodesic_ belong to the worker
+    if (distanceMode_.isSelected("geodesic")) {
+        const SurfaceCache::Request<GeodesicEngine> engine = requestGeodesicEngine();
+        const tgt::vec3 start = mouseStartPos3D_.xyz();
+        const tgt::vec3 end = mouseCurPos3D_.xyz();
+        unsigned int job = worker_.submit([this, engine, start, end](const MeasureWorker::CancelFlag& cancel, MeasureWorker::Result& result) {
+            // the surface graph is built once per volume and shared with the other processors
+            geodesic_ = engine.get();
+            if (!geodesic_)
+                return false;
+            float dist = geodesic_->query(queryState_, start, end, &result.path, [&cancel]() { return cancel.isCancelled(); });
+            if (cancel.isCancelled())
+                return false;
+            result.distance = std::max(dist, 0.0f);
+            result.hasPath = true;
+            return true;
+        });
+        if (final)
+            finalJob_ = job;
+    } else {
+        // while dragging the whole target is read back once per rendering, so following moves only
+        // touch the host copy, a single measurement only needs the segment's bounding box
+        FhpSource source;
+        if (final)
+            source = getFhpSource(tgt::min(mouseStartPos2D_, mouseCurPos2D_), tgt::max(mouseStartPos2D_, mouseCurPos2D_));
+        else
+            source = getFhpSource(tgt::ivec2(0), getFhpPort().getSize() - 1);
+
+        const poitools::Mat4 textureToWorld = toCore(refVolume->getTextureToWorldMatrix());
+        const poitools::IVec2 start = toCore(mouseStartPos2D_);
+        const poitools::IVec2 end = toCore(mouseCurPos2D_);
+        const bool bilinear = subPixelSampling_.get();
+        unsigned int job = worker_.submit([this, source, textureToWorld, start, end, bilinear, final](const MeasureWorker::CancelFlag&, MeasureWorker::Result& result) {
+            // the samples kept from the previous job are only valid for the same first-hit-points
+            if (source.getKey() != samplerSource_.getKey()) {
+                sampler_.invalidate();
+                samplerSource_ = source;
+            }
 
-    for(float i=start.x+1;i!=end.x;++i){
-      // calculate difference quotient
-      tmp  = fhpInport_.getRenderTarget()->getColorAtPos(tgt::ivec2(i,   m*i+b)).xyz();
-      tmp1 = fhpInport_.getRenderTarget()->getColorAtPos(tgt::ivec2(i+1, m*(i+1)+b)).xyz();
-      tmp  = refVolume->getTextureToWorldMatrix() * tmp;
-      tmp1 = refVolume->getTextureToWorldMatrix() * tmp1;
-      derivate = (tmp1-tmp)/one;
+            // only the samples that differ from the previous position of the drag are looked up
+            sampler_.setBilinear(bilinear);
+            result.distance = source.update(sampler_, textureToWorld, start, end);
+            if (final) {
+                result.path = toTgt(sampler_.getPath());
+                result.hasPath = true;
+            }
+            return true;
+        });
+        if (final)
+            finalJob_ = job;
+    }
 
-      // add the current point to the points list
-      pointsListX_.push_back(tmp);
+    if (resultTimer_ && resultTimer_->isStopped())
+        resultTimer_->start(RESULT_POLL_INTERVAL);
+}
 
-      // integrate over the square root of the difference quotient of the elements
-      dist+=sqrt(derivate.x*derivate.x+derivate.y*derivate.y+derivate.z*derivate.z);
+unsigned int SurfaceMeasure::submitPolyline(const std::vector<PolylineEvaluator::Segment>& segments) {
+    const VolumeBase* refVolume = refInport_.getData();
+    if(!refVolume) {
+      LERROR("No reference volume");
+      return 0;
     }
-    return dist;
+
+    PolylineEvaluator::Settings settings;
+    settings.geodesic = distanceMode_.isSelected("geodesic");
+    settings.bilinear = subPixelSampling_.get();
+    settings.textureToWorld = toCore(refVolume->getTextureToWorldMatrix());
+    SurfaceCache::Request<GeodesicEngine> engine;
+    if (settings.geodesic)
+        engine = requestGeodesicEngine();
+
+    // only the segments that have changed since the last job are measured, in parallel
+    unsigned int job = worker_.submit([this, segments, settings, engine](const MeasureWorker::CancelFlag& cancel, MeasureWorker::Result& result) {
+        PolylineEvaluator::Settings current = settings;
+        if (current.geodesic) {
+            geodesic_ = engine.get();
+            if (!geodesic_)
+                return false;
+            current.engine = geodesic_.get();
+            current.engineRevision = geodesic_->getRevision();
+        }
+        if (!polyline_.evaluate(segments, current, [&cancel]() { return cancel.isCancelled(); }))
+            return false;
+
+        result.distance = polyline_.getTotalLength();
+        for (size_t i = 0; i < polyline_.getNumSegments(); ++i)
+            result.segmentLengths.push_back(polyline_.getLength(i));
+        result.path = polyline_.getCombinedPath();
+        result.hasPath = true;
+        return true;
+    });
+
+    if (resultTimer_ && resultTimer_->isStopped())
+        resultTimer_->start(RESULT_POLL_INTERVAL);
+    return job;
+}
+
+SurfaceCache::Request<GeodesicEngine> SurfaceMeasure::requestGeodesicEngine() const {
+    const size_t extractionBudget = static_cast<size_t>(extractionMemory_.get()) << 20;
+    return PoiTools::getSurfaceCache().requestGeodesicEngine(refInport_.getData(), isoValue_.get(), geodesicStride_.get(),
+                                                             extractionBudget);
 }
 
-  float SurfaceMeasure::measureY() {
+unsigned int SurfaceMeasure::submitCircumference(const std::vector<tgt::vec3>& points) {
     const VolumeBase* refVolume = refInport_.getData();
     if(!refVolume) {
-      // this could never happen due to the test in the previous function,
-      // but we never know...
       LERROR("No reference volume");
       return 0;
     }
-    tgt::ivec2 start, end;
-    float dist=0;
-    tgt::vec3 tmp, tmp1, derivate;
-    tgt::vec3 one = tgt::vec3(1.0f);
 
-    if(mouseStartPos2D_.y > mouseCurPos2D_.y) {
-      start = mouseCurPos2D_;
-      end = mouseStartPos2D_;
-    } else {
-      start = mouseStartPos2D_;
-      end = mouseCurPos2D_;
+    // no points (everything undone) give an empty result, which clears the path
+    const tgt::vec3 normal = PlaneSection::getNormal(points, camera_.get().getLook(), camera_.get().getStrafe());
+    const tgt::vec3 point = points.empty() ? tgt::vec3(0.0f) : points[points.size() < 3 ? 0 : points.size() - 3];
+    const float isoValue = isoValue_.get();
+    const std::shared_ptr<const VolumeBrickReader> volume = PoiTools::getSurfaceCache().pinVolume(refVolume, 1, true);
+    unsigned int job = worker_.submit([this, volume, isoValue, point, normal](const MeasureWorker::CancelFlag& cancel, MeasureWorker::Result& result) {
+        // the slice is extracted in parallel, so the contour follows the plane while dragging
+        float length = section_.measure(*volume, isoValue, point, normal, &result.path, [&cancel]() { return cancel.isCancelled(); });
+        if (length < 0.0f)
+            return false;
+        result.distance = length;
+        result.hasPath = true;
+        return true;
+    });
+
+    if (resultTimer_ && resultTimer_->isStopped())
+        resultTimer_->start(RESULT_POLL_INTERVAL);
+    return job;
+}
+
+std::vector<tgt::vec3> SurfaceMeasure::getPlanePoints(bool withCurrent) const {
+    std::vector<tgt::vec3> points;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        points.push_back(segments_[i].start3D);
+        if (segments_[i].end2D != segments_[i].start2D)
+            points.push_back(segments_[i].end3D);
     }
-    float m = ((float)end.x - (float)start.x) / ((float)end.y - (float)start.y);
-    float b = start.x-m*start.y;
+    if (withCurrent) {
+        points.push_back(mouseStartPos3D_.xyz());
+        if (mouseCurPos2D_ != mouseStartPos2D_)
+            points.push_back(mouseCurPos3D_.xyz());
+    }
+    return points;
+}
 
+void SurfaceMeasure::clearPolyline() {
+    worker_.cancel();
+    segments_.clear();
+    segmentLengths_.clear();
+    distance_ = 0.0f;
+    outportDistance_.clear();
+    path_.clear();
+    setOverlayPath(std::vector<tgt::vec3>());
+    if (journal_.isOpen())
+        journal_.append(poitools::JournalRecord(poitools::MEASURE_CLEAR, std::vector<float>()));
+    invalidate();
+}
 
-    for(float i=start.y+1;i!=end.y;++i){
-        // calculate difference quotient
-        tmp  = fhpInport_.getRenderTarget()->getColorAtPos(tgt::ivec2(m*i+b,   i)).xyz();
-        tmp1 = fhpInport_.getRenderTarget()->getColorAtPos(tgt::ivec2(m*(i+1)+b, i+1)).xyz();
-        tmp  = refVolume->getTextureToWorldMatrix() * tmp;
-        tmp1 = refVolume->getTextureToWorldMatrix() * tmp1;
-        derivate = (tmp1-tmp)/one;
+void SurfaceMeasure::reopenJournal() {
+    journalDirty_ = true;
+    invalidate();
+}
 
-        // add the current point to the points list
-        pointsListY_.push_back(tmp);
+void SurfaceMeasure::openJournal() {
+    journalDirty_ = false;
+    journal_.close();
+    if (journalFile_.get().empty())
+        return;
 
-        // integrate over the square root of the difference quotient of the elements
-        dist+=sqrt(derivate.x*derivate.x+derivate.y*derivate.y+derivate.z*derivate.z);
+    // the result of the last session, screen space segments cannot be measured again without their view
+    StageTimer::Scope scope(timer_, "replay journal");
+    std::vector<poitools::JournalRecord> records;
+    long long validLength = 0;
+    if (!poitools::readJournal(journalFile_.get(), records, &validLength)) {
+        LERROR(journalFile_.get() << " is no session journal");
+        return;
+    }
+    float distance = 0.0f;
+    std::vector<float> segmentLengths;
+    std::vector<poitools::Vec3> path;
+    if (poitools::replayMeasurement(records, distance, segmentLengths, path)) {
+        distance_ = distance;
+        segmentLengths_ = segmentLengths;
+        publishPath(toTgt(path));
+        LINFO("Restored the measurement of " << distance_ << " from " << records.size() << " journal records");
     }
-    return dist;
-}
 
-float SurfaceMeasure::surfaceDistance(){
-    LDEBUG("Started New Points");
-    pointsListX_.clear();
-    pointsListY_.clear();
-    float xval = measureX();
-    float max = std::max(xval, measureY());
+    if (!journal_.open(journalFile_.get(), validLength))
+        LERROR("Cannot write session journal " << journalFile_.get());
+}
 
+void SurfaceMeasure::publishPath(const std::vector<tgt::vec3>& path) {
     PointListGeometryVec3* positions = new PointListGeometryVec3();
-    if (max == xval)
-        positions->setData(pointsListX_);
-    else
-        positions->setData(pointsListY_);
-    
+    positions->setData(path);
     outportDistance_.setData(positions);
-    return max;
+    path_ = path;
+    setOverlayPath(path);
+}
+
+void SurfaceMeasure::exportPath() {
+    if (exportFile_.get().empty()) {
+        LERROR("No path export file set");
+        return;
+    }
+    poitools::PointExporter exporter;
+    if (!exporter.open(exportFile_.get(), poitools::getExportFormat(exportFile_.get()))) {
+        LERROR("Cannot write " << exportFile_.get());
+        return;
+    }
+
+    // grouped by the volume file, labeled with the distance mode
+    const VolumeBase* refVolume = refInport_.getData();
+    if (refVolume)
+        exporter.setGroup(refVolume->getOrigin().getPath());
+    std::vector<poitools::Vec3> path;
+    path.reserve(path_.size());
+    for (size_t i = 0; i < path_.size(); ++i)
+        path.push_back(toCore(path_[i]));
+    exporter.writePath(distanceMode_.get(), distance_, path);
+    if (!exporter.close()) {
+        LERROR("Writing " << exportFile_.get() << " failed");
+        return;
+    }
+    LINFO("Exported a path of " << path.size() << " points to " << exportFile_.get());
+}
+
+void SurfaceMeasure::timerEvent(tgt::TimeEvent* /*e*/) {
+    // readbacks that are still in flight are polled by every rendering until they have arrived
+    if (picker_.isBusy()) {
+        invalidate();
+        return;
+    }
+
+    // render the result of the worker and apply the queued picks as soon as the brick hierarchy is there
+    if (!worker_.isBusy() && !raycasterWorker_.isBusy()) {
+        resultTimer_->stop();
+        invalidate();
+    }
+}
+
+void SurfaceMeasure::setOverlayPath(const std::vector<tgt::vec3>& path) {
+    // geodesic paths run on the subsampled surface graph and may lie below the rendered surface
+    float tolerance = 0.0f;
+    if (const VolumeBase* refVolume = refInport_.getData()) {
+        tolerance = tgt::max(refVolume->getSpacing());
+        if (distanceMode_.isSelected("geodesic"))
+            tolerance *= static_cast<float>(geodesicStride_.get() + 1);
+    }
+    overlay_.setPath(path, tolerance);
+    pathGeneration_++;
+}
+
+void SurfaceMeasure::renderDistanceLabel() {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << distance_;
+    std::string label = out.str();
+
+    glDisable(GL_DEPTH_TEST);
+    MatStack.matrixMode(tgt::MatrixStack::MODELVIEW);
+    MatStack.pushMatrix();
+    MatStack.loadIdentity();
+    MatStack.translate(-1.0f, -1.0f, 0.0f);
+    float scaleFactorX = 2.0f / static_cast<float>(imgInport_.getSize().x);
+    float scaleFactorY = 2.0f / static_cast<float>(imgInport_.getSize().y);
+    MatStack.scale(scaleFactorX, scaleFactorY, 1);
+    tgt::ivec2 screensize = imgInport_.getSize();
+
+    // next to the end of the segment, moved inside the viewport near the upper and right border
+    tgt::vec3 pos(static_cast<float>(mouseCurPos2D_.x + 12), static_cast<float>(mouseCurPos2D_.y + 12), 0.0f);
+    pos.x = std::min(pos.x, static_cast<float>(screensize.x - 12 * static_cast<int>(label.size()) - 10));
+    pos.y = std::min(pos.y, static_cast<float>(screensize.y - 26));
+
+    font_.setFontColor(tgt::vec4(0.0f, 0.0f, 0.0f, 1.f));
+    font_.render(pos + tgt::vec3(1.0f, -1.0f, 0.0f), label, screensize);
+    font_.setFontColor(tgt::vec4(1.0f, 1.0f, 0.0f, 1.f));
+    font_.render(pos, label, screensize);
+
+    MatStack.popMatrix();
+    glEnable(GL_DEPTH_TEST);
 }
 
 void SurfaceMeasure::process() {
-    if (getInvalidationLevel() >= Processor::INVALID_PROGRAM)
+    if (getInvalidationLevel() >= Processor::INVALID_PROGRAM) {
         compile();
+        overlayKey_.clear();
+    }
+
+    // restore the measurement of an interrupted session
+    if (journalDirty_) {
+        openJournal();
+    } else if (journal_.hasFailed()) {
+        LERROR("Writing the session journal failed, it is closed");
+        journal_.close();
+    }
+
+    // timings of the previous frames, gpu results arrive with a delay
+    timer_.setEnabled(enableTimings_.get());
+    timer_.setTraceFile(enableTimings_.get() ? traceFile_.get() : "");
+    timer_.collect();
+    if (timer_.isEnabled())
+        outportTimings_.setData(timer_.getReport());
+
+    if (imgInport_.hasChanged())
+        imageGeneration_++;
+
+    // the first-hit-points have been re-rendered, drop the host copy
+    if (getFhpPort().hasChanged())
+        fhpCache_.invalidate();
+    updateFhpFormat();
+
+    // a new volume needs a new surface graph, running jobs may still use the old one
+    if (refInport_.hasChanged()) {
+        worker_.cancel();
+        worker_.wait();
+        geodesic_.reset();
+        raycaster_.reset();
+        rayView_.reset();
+        raycasterIsoValue_ = -1.0f;
+    }
 
     const VolumeBase* refVolume = refInport_.getData();
     if(!refVolume) {
@@ -267,14 +750,89 @@ void SurfaceMeasure::process() {
         return;
     }
 
+    // apply the picks queued by the mouse handler
+    {
+        StageTimer::Scope scope(timer_, "apply picks");
+        std::vector<AsyncFhpPicker::PickResult> picks = picker_.poll();
+        for (size_t i = 0; i < picks.size(); ++i)
+            applyPick(picks[i].tag, picks[i].pos, picks[i].fhp);
+
+        // ray casting picks wait for the brick hierarchy
+        if (!queuedPicks_.empty() && updateRaycaster()) {
+            for (size_t i = 0; i < queuedPicks_.size(); ++i)
+                applyPick(queuedPicks_[i].first, queuedPicks_[i].second, raycaster_->getFhp(*rayView_, queuedPicks_[i].second));
+            queuedPicks_.clear();
+        }
+
+        // the remaining readbacks are applied in one of the next renderings, see timerEvent()
+        if (picker_.isBusy() && resultTimer_ && resultTimer_->isStopped())
+            resultTimer_->start(RESULT_POLL_INTERVAL);
+    }
+
+    // follow the mouse while dragging, every new position supersedes the previous job
+    if ((livePreview_.get() || distanceMode_.isSelected("geodesic")) && mouseDown_ && pathDirty_ && !releasePending_) {
+        StageTimer::Scope scope(timer_, "submit preview");
+        submitMeasurement(false);
+    }
+
+    if (releasePending_ && !picker_.isBusy() && queuedPicks_.empty()) {
+        StageTimer::Scope scope(timer_, "submit distance");
+        releasePending_ = false;
+        if (mouseDown_)
+            submitMeasurement(true);
+    }
+
+    // publish the newest finished measurement
+    MeasureWorker::Result result;
+    if (worker_.fetch(result)) {
+        distance_ = result.distance;
+        segmentLengths_ = result.segmentLengths;
+        if (result.hasPath)
+            publishPath(result.path);
+
+        // only finished measurements are journaled, on the journal's thread
+        if (result.id == finalJob_ && journal_.isOpen()) {
+            std::vector<poitools::Vec3> path;
+            for (size_t i = 0; i < result.path.size(); ++i)
+                path.push_back(toCore(result.path[i]));
+            journal_.append(poitools::encodeMeasurement(result.distance, result.segmentLengths, path));
+        }
+    }
+
+    // the total length first, in polyline mode followed by one line per segment
     std::ostringstream ss;
     ss << distance_;
-    outportDistanceText_.setData(ss.str());
+    if (polylineMode_.get()) {
+        for (size_t i = 0; i < segmentLengths_.size(); ++i)
+            ss << "\n" << (i + 1) << ": " << segmentLengths_[i];
+    }
+    // the text port only triggers its successors if the text has changed
+    if (ss.str() != distanceText_) {
+        distanceText_ = ss.str();
+        outportDistanceText_.setData(distanceText_);
+    }
+
+    // the overlay is only rendered again if one of its inputs has changed, not for unrelated properties
+    const bool showLabel = showDistanceLabel_.get() && (mouseDown_ || distance_ > 0.0f);
+    InputKey overlayKey;
+    const bool showPath = showPath_.get() && !overlay_.isEmpty();
+    overlayKey.add(imageGeneration_).add(outport_.getSize()).add(showLabel).add(showPath);
+    if (showLabel)
+        overlayKey.add(distance_).add(mouseCurPos2D_);
+    if (showPath)
+        overlayKey.add(pathGeneration_).add(camera_.get().getViewMatrix()).add(camera_.get().getProjectionMatrix(outport_.getSize()));
+    if (overlayKey != overlayKey_) {
+        overlayKey_ = overlayKey;
+        renderOverlay(showLabel);
+    }
+}
 
+void SurfaceMeasure::renderOverlay(bool showLabel) {
+    StageTimer::Scope scope(timer_, "composite", true);
     outport_.activateTarget();
     outport_.clearTarget();
 
-    TextureUnit colorUnit, depthUnit;
+    TextureUnit colorUnit, depthUnit, overlayUnit, overlayTileUnit;
     imgInport_.bindTextures(colorUnit.getEnum(), depthUnit.getEnum());
 
     // initialize shader
@@ -283,15 +841,21 @@ void SurfaceMeasure::process() {
     program_->setUniform("colorTex_", colorUnit.getUnitNumber());
     program_->setUniform("depthTex_", depthUnit.getUnitNumber());
     imgInport_.setTextureParameters(program_, "textureParameters_");
+    overlay_.setUniforms(program_, overlayUnit, overlayTileUnit, camera_.get(), outport_.getSize(), tgt::vec4(1.0f, 1.0f, 0.0f, 0.9f),
+                         showPath_.get());
 
     renderQuad();
 
     program_->deactivate();
     TextureUnit::setZeroUnit();
 
+    if (showLabel) {
+        StageTimer::Scope labelScope(timer_, "label", true);
+        renderDistanceLabel();
+    }
+
     outport_.deactivateTarget();
     LGL_ERROR;
-
 }
 
 } // namespace voreen
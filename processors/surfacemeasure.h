@@ -8,6 +8,9 @@
 #include "voreen/core/properties/floatproperty.h"
 #include "voreen/core/properties/intproperty.h"
 #include "voreen/core/properties/boolproperty.h"
+#include "voreen/core/properties/buttonproperty.h"
+#include "voreen/core/properties/filedialogproperty.h"
+#include "voreen/core/properties/optionproperty.h"
 #include "voreen/core/utils/stringutils.h"
 #include "voreen/core/datastructures/geometry/glmeshgeometry.h"
 
@@ -15,11 +18,34 @@
 #include "voreen/core/ports/volumeport.h"
 #include "voreen/core/ports/textport.h"
 
+#include "../core/journal.h"
+#include "../core/measure.h"
+#include "../core/pointexport.h"
+#include "../utils/asyncfhppicker.h"
+#include "../utils/coreadapter.h"
+#include "../utils/fhpcache.h"
+#include "../utils/fhpformat.h"
+#include "../utils/fhpraycaster.h"
+#include "../utils/fhpsource.h"
+#include "../utils/geodesicengine.h"
+#include "../utils/inputkey.h"
+#include "../utils/measureworker.h"
+#include "../utils/planesection.h"
+#include "../utils/polylineevaluator.h"
+#include "../utils/screenoverlay.h"
+#include "../utils/stagetimer.h"
+#include "../utils/surfacecache.h"
+
+#include "tgt/event/eventhandler.h"
 #include "tgt/font.h"
 #include "tgt/glmath.h"
 #include "tgt/immediatemode/immediatemode.h"
+#include "tgt/timer.h"
 
 #include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace voreen {
 
@@ -45,46 +71,143 @@ protected:
                 "Allows to interactively measure distances on the surface rendered volumes. "
                 "This processor expects the rendered volume, a rendering of the first hitpoints "
                 "(use FHP compositing in a SingleVolumeRaycaster), and the volume that is currently "
-                "being rendered (for scaling information) as input."
+                "being rendered (for scaling information) as input. With CPU ray casting picking the "
+                "first-hit-points are computed from the volume and the camera, no FHP rendering is needed. "
+                "With the depth only input any rendering of the surface can be connected to the FHP depth port, "
+                "the positions are reconstructed from its depth. The plane circumference mode cuts the surface "
+                "of the reference volume with the plane through the picked points and measures the contour, "
+                "e.g. for a head circumference."
                 );
     }
 
     void process();
+    virtual std::string generateHeader(const tgt::GpuCapabilities::GlVersion* version = 0);
+    virtual void initialize();
+    virtual void deinitialize();
+
+    virtual void timerEvent(tgt::TimeEvent* e);
 
 private:
+    enum PickTag {
+        PICK_START,
+        PICK_CURRENT
+    };
+
+    static const int RESULT_POLL_INTERVAL = 15; ///< ms between checks for finished measurements
+
     tgt::ivec2 clampToViewport(tgt::ivec2 mousePos);
 
+    void requestPick(int tag, tgt::ivec2 pos);                      ///< picks from the cache or queues a readback
+    void applyPick(int tag, tgt::ivec2 pos, const tgt::vec4& fhp);  ///< updates the start/current position
+
+    /// Passes the format of the FHP input to the cache and the picker.
+    void updateFhpFormat();
+    /// FHP input of the selected format, the depth input in depth format.
+    RenderPort& getFhpPort();
+    /**
+     * Updates the ray caster and its view if volume, iso value or camera have changed.
+     * Returns false while the brick hierarchy is built on raycasterWorker_.
+     */
+    bool updateRaycaster();
+    /// First-hit-points of the current view, the image is read back at least between lower and upper.
+    FhpSource getFhpSource(tgt::ivec2 lower, tgt::ivec2 upper);
+
     RenderPort imgInport_;
     RenderPort fhpInport_;
+    RenderPort fhpDepthInport_;     ///< any rendering of the surface, only its depth is read
     VolumePort refInport_;
     RenderPort outport_;
     GeometryPort outportDistance_;
     TextPort outportDistanceText_;
-
-    std::vector<tgt::vec3> pointsListX_;
-    std::vector<tgt::vec3> pointsListY_;
+    TextPort outportTimings_;
 
     EventProperty<SurfaceMeasure> mouseEventProp_;
     EventProperty<SurfaceMeasure> mouseUndoProp_;
     CameraProperty camera_;
     BoolProperty renderSpheres_;
+    StringOptionProperty pickingMode_;   ///< first-hit-point image or CPU ray casting
+    StringOptionProperty fhpFormat_;     ///< positions or depth in the FHP input
+    StringOptionProperty distanceMode_;  ///< screen space line integral, geodesic surface path or plane circumference
+    FloatProperty isoValue_;             ///< iso value of the surface used for geodesic paths and ray casting
+    IntProperty geodesicStride_;         ///< voxel subsampling of the geodesic surface graph
+    IntProperty extractionMemory_;       ///< MiB of volume data read at a time while the surface graph is built
+    BoolProperty subPixelSampling_;      ///< interpolate the first-hit-points along screen space paths
+    BoolProperty livePreview_;           ///< update screen space distances while dragging
+    BoolProperty showDistanceLabel_;     ///< render the distance next to the cursor
+    BoolProperty showPath_;              ///< draw the measured path onto the image
+    BoolProperty polylineMode_;          ///< keep all segments instead of only the last one
+    ButtonProperty clearPolyline_;
+    BoolProperty enableTimings_;         ///< publish per-stage timings on outportTimings_
+    FileDialogProperty traceFile_;       ///< optional chrome trace of the timings
+    FileDialogProperty journalFile_;     ///< every finished measurement is appended to, empty for none
+    FileDialogProperty exportFile_;      ///< CSV or binary export (.poix) of the measured path
+    ButtonProperty exportPath_;
 
     tgt::ivec2 mouseCurPos2D_;
     tgt::vec4 mouseCurPos3D_;
     tgt::ivec2 mouseStartPos2D_;
     tgt::vec4 mouseStartPos3D_;
     bool mouseDown_;
-
-    float distance_;
+    bool releasePending_; ///< mouse has been released, distance is computed once all picks are in
+    bool pathDirty_;      ///< current position changed since the last distance query
+
+    float distance_;                        ///< total length in polyline mode
+    std::vector<float> segmentLengths_;     ///< polyline mode
+    std::vector<PolylineEvaluator::Segment> segments_;  ///< finished segments of the polyline
+    std::vector<tgt::vec3> path_;           ///< path on outportDistance_, world coordinates
+
+    FhpCache fhpCache_; ///< host copy of the fhp target, refreshed when the FHP input changes
+    AsyncFhpPicker picker_; ///< non-blocking readbacks for picks the cache cannot answer
+    std::shared_ptr<const FhpRaycaster> raycaster_;         ///< ray casting picking mode
+    std::shared_ptr<const FhpRaycaster::View> rayView_;     ///< replaced whenever the camera changes
+    std::vector<std::pair<int, tgt::ivec2> > queuedPicks_;  ///< ray casting picks waiting for the brick hierarchy
+    float raycasterIsoValue_; ///< iso value of the build on raycasterWorker_, negative if there is none
+    MeasureWorker worker_;    ///< runs the measurements, only the newest one is kept
+    MeasureWorker raycasterWorker_; ///< builds the brick hierarchy of raycaster_, so measurements do not cancel it
+    tgt::EventHandler resultHandler_;
+    tgt::Timer* resultTimer_; ///< runs while a worker or a readback is busy, see timerEvent()
+    unsigned int finalJob_;   ///< id of the last job whose result is journaled, previews are not
+    poitools::JournalWriter journal_;   ///< writes and syncs on a thread of its own
+    bool journalDirty_;                 ///< journalFile_ has changed since the journal has been opened
+
+    // owned by the worker thread while jobs are running
+    std::shared_ptr<const GeodesicEngine> geodesic_; ///< surface graph of the reference volume, from the module's cache
+    GeodesicEngine::QueryState queryState_;         ///< scratch buffers of the geodesic queries
+    poitools::PathSampler sampler_; ///< screen space path, keeps the samples of the previous drag position
+    FhpSource samplerSource_; ///< first-hit-points the samples of sampler_ are from
+    PolylineEvaluator polyline_; ///< results of the segments of the last polyline measurement
+    PlaneSection section_;       ///< contours of the circumference mode
+    StageTimer timer_;
+
+    unsigned int imageGeneration_;  ///< incremented whenever imgInport_ has new data
+    unsigned int pathGeneration_;   ///< incremented whenever the path of overlay_ changes
+    ScreenOverlay overlay_;         ///< the path on outportDistance_, drawn by the compositing shader
+    InputKey overlayKey_;           ///< inputs of the current rendering in outport_
+    std::string distanceText_;      ///< published on outportDistanceText_
 
     tgt::Font font_;
     GlMeshGeometryUInt16Normal mesh_;
     tgt::ImmediateMode::LightSource lightSource_;
     tgt::ImmediateMode::Material material_;
 
-    float surfaceDistance();
-    float measureX();
-    float measureY();
+    /// Measures the current segment on the worker, final also publishes the path.
+    void submitMeasurement(bool final);
+    /// Measures the polyline made of segments on the worker, returns the id of the job.
+    unsigned int submitPolyline(const std::vector<PolylineEvaluator::Segment>& segments);
+    /// Measures the contour in the plane through the last three of points on the worker, returns the id of the job.
+    unsigned int submitCircumference(const std::vector<tgt::vec3>& points);
+    /// Surface graph of the reference volume for a job, built by the first job that needs it.
+    SurfaceCache::Request<GeodesicEngine> requestGeodesicEngine() const;
+    /// Picked points of the finished segments, and of the current one if withCurrent, clicks count once.
+    std::vector<tgt::vec3> getPlanePoints(bool withCurrent) const;
+    void clearPolyline();
+    void reopenJournal();   ///< the journal is replayed and opened in the next process()
+    void openJournal();     ///< restores the last measurement from the journal file and appends to it from now on
+    void publishPath(const std::vector<tgt::vec3>& path);   ///< on outportDistance_ and the overlay
+    void exportPath();      ///< writes the published path and its length to exportFile_
+    void renderDistanceLabel();
+    void renderOverlay(bool showLabel); ///< image, path and distance label into outport_
+    void setOverlayPath(const std::vector<tgt::vec3>& path);
 };
 
 } // namespace
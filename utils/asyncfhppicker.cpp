@@ -0,0 +1,164 @@
+#include "asyncfhppicker.h"
+
+#include "tgt/logmanager.h"
+
+namespace voreen {
+
+const std::string AsyncFhpPicker::loggerCat_("voreen.poitools.AsyncFhpPicker");
+
+AsyncFhpPicker::AsyncFhpPicker()
+    : inFlight_()
+    , freeBuffers_()
+    , hasDeferred_(false)
+{
+}
+
+AsyncFhpPicker::~AsyncFhpPicker() {
+    if (!inFlight_.empty() || !freeBuffers_.empty())
+        LWARNING("Pixel buffer objects have not been released (deinitialize() not called)");
+}
+
+void AsyncFhpPicker::deinitialize() {
+    clear();
+    if (!freeBuffers_.empty())
+        glDeleteBuffers(static_cast<GLsizei>(freeBuffers_.size()), freeBuffers_.data());
+    freeBuffers_.clear();
+    LGL_ERROR;
+}
+
+void AsyncFhpPicker::clear() {
+    for (size_t i = 0; i < inFlight_.size(); ++i) {
+        glDeleteSync(inFlight_[i].fence);
+        freeBuffers_.push_back(inFlight_[i].pbo);
+    }
+    inFlight_.clear();
+    hasDeferred_ = false;
+}
+
+bool AsyncFhpPicker::discardLast(int tag) {
+    // the coalesced request is newer than the one it waits for
+    if (hasDeferred_ && deferred_.tag == tag) {
+        hasDeferred_ = false;
+        return true;
+    }
+    for (size_t i = inFlight_.size(); i-- > 0;) {
+        if (inFlight_[i].tag == tag) {
+            glDeleteSync(inFlight_[i].fence);
+            freeBuffers_.push_back(inFlight_[i].pbo);
+            inFlight_.erase(inFlight_.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsyncFhpPicker::isBusy() const {
+    return hasDeferred_ || !inFlight_.empty();
+}
+
+GLuint AsyncFhpPicker::acquireBuffer() {
+    if (!freeBuffers_.empty()) {
+        GLuint pbo = freeBuffers_.back();
+        freeBuffers_.pop_back();
+        return pbo;
+    }
+
+    GLuint pbo = 0;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(tgt::vec4), 0, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return pbo;
+}
+
+void AsyncFhpPicker::request(RenderPort& port, tgt::ivec2 pos, int tag, bool coalesce) {
+    if (coalesce) {
+        for (size_t i = 0; i < inFlight_.size(); ++i) {
+            if (inFlight_[i].coalesce) {
+                deferred_.port = &port;
+                deferred_.pos = pos;
+                deferred_.tag = tag;
+                deferred_.format = format_;
+                hasDeferred_ = true;
+                return;
+            }
+        }
+    }
+    issue(port, pos, tag, coalesce, format_);
+}
+
+void AsyncFhpPicker::issue(RenderPort& port, tgt::ivec2 pos, int tag, bool coalesce, const FhpFormat& format) {
+    tgt::ivec2 size = port.getSize();
+    if (pos.x < 0 || pos.y < 0 || pos.x >= size.x || pos.y >= size.y)
+        return;
+
+    Slot slot;
+    slot.pbo = acquireBuffer();
+    slot.tag = tag;
+    slot.pos = pos;
+    slot.coalesce = coalesce;
+    slot.format = format;
+
+    port.activateTarget();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(pos.x, pos.y, 1, 1, format.depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    port.deactivateTarget();
+    LGL_ERROR;
+
+    inFlight_.push_back(slot);
+}
+
+std::vector<AsyncFhpPicker::PickResult> AsyncFhpPicker::poll(bool wait) {
+    std::vector<PickResult> results;
+    const GLuint64 timeout = wait ? 1000000000 : 0; // one second in ns when waiting
+
+    // results are handed out in request order, so stop at the first unfinished readback
+    while (!inFlight_.empty()) {
+        Slot& slot = inFlight_.front();
+        GLenum state = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (state == GL_TIMEOUT_EXPIRED)
+            break;
+        if (state == GL_WAIT_FAILED)
+            LERROR("Waiting for first-hit-point readback failed");
+
+        PickResult result;
+        result.tag = slot.tag;
+        result.pos = slot.pos;
+        result.fhp = tgt::vec4(0.0f);
+        if (state != GL_WAIT_FAILED) {
+            float pixel[4];
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(float) * slot.format.getChannels(), pixel);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            result.fhp = slot.format.toFhp(slot.pos, pixel);
+        }
+        results.push_back(result);
+
+        glDeleteSync(slot.fence);
+        freeBuffers_.push_back(slot.pbo);
+        inFlight_.pop_front();
+    }
+    LGL_ERROR;
+
+    // the predecessor of the coalesced request is done, issue it now
+    if (hasDeferred_) {
+        bool blocked = false;
+        for (size_t i = 0; i < inFlight_.size(); ++i)
+            blocked |= inFlight_[i].coalesce;
+        if (!blocked) {
+            hasDeferred_ = false;
+            issue(*deferred_.port, deferred_.pos, deferred_.tag, true, deferred_.format);
+            if (wait) {
+                std::vector<PickResult> tail = poll(true);
+                results.insert(results.end(), tail.begin(), tail.end());
+            }
+        }
+    }
+
+    return results;
+}
+
+} // namespace voreen
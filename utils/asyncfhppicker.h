@@ -0,0 +1,103 @@
+#ifndef VRN_POITOOLS_ASYNCFHPPICKER_H
+#define VRN_POITOOLS_ASYNCFHPPICKER_H
+
+#include "voreen/core/ports/renderport.h"
+
+#include "fhpformat.h"
+
+#include "tgt/tgt_gl.h"
+#include "tgt/vector.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Non-blocking single pixel readback of a first-hit-point render target.
+ *
+ * Each request copies the pixel into a pixel buffer object and inserts a fence,
+ * so the mouse handler returns immediately. Finished readbacks are collected
+ * with poll(), usually from the owning processor's process(). Requests marked
+ * as coalescable (mouse motion) that arrive while another coalescable request
+ * is still in flight replace each other, so at most one of them waits.
+ * Requests are read in the format set at the time of the request.
+ *
+ * All methods have to be called with the processor's GL context being active.
+ */
+class AsyncFhpPicker {
+public:
+    struct PickResult {
+        int tag;            ///< caller defined request type, e.g. the mouse action
+        tgt::ivec2 pos;     ///< viewport position that has been read
+        tgt::vec4 fhp;      ///< first-hit-point at pos (zero for background)
+    };
+
+    AsyncFhpPicker();
+    ~AsyncFhpPicker();
+
+    /// Releases all buffer objects and fences. Has to be called before the GL context is destroyed.
+    void deinitialize();
+
+    /// Format of the render target for the following requests.
+    void setFormat(const FhpFormat& format) { format_ = format; }
+
+    /**
+     * Queues the readback of the pixel at pos.
+     *
+     * @param coalesce if true and a coalescable request is still in flight, the
+     *      request is only remembered and replaces any other remembered one.
+     */
+    void request(RenderPort& port, tgt::ivec2 pos, int tag, bool coalesce);
+
+    /**
+     * Returns all finished readbacks in request order.
+     *
+     * @param wait if true, blocks until every outstanding request (including a coalesced
+     *      one) has been read. Processors poll without waiting and render again while
+     *      isBusy(), so a slow readback never stalls process().
+     */
+    std::vector<PickResult> poll(bool wait = false);
+
+    /// True if readbacks are in flight or waiting to be issued.
+    bool isBusy() const;
+
+    /// Drops all outstanding requests.
+    void clear();
+
+    /// Drops the newest outstanding request with tag, returns false if there is none.
+    bool discardLast(int tag);
+
+private:
+    struct Slot {
+        GLuint pbo;
+        GLsync fence;
+        int tag;
+        tgt::ivec2 pos;
+        bool coalesce;
+        FhpFormat format;
+    };
+
+    struct Deferred {
+        RenderPort* port;
+        tgt::ivec2 pos;
+        int tag;
+        FhpFormat format;
+    };
+
+    void issue(RenderPort& port, tgt::ivec2 pos, int tag, bool coalesce, const FhpFormat& format);
+    GLuint acquireBuffer();
+
+    std::deque<Slot> inFlight_;         ///< readbacks in request order
+    std::vector<GLuint> freeBuffers_;   ///< recycled pixel buffer objects
+    FhpFormat format_;
+    bool hasDeferred_;
+    Deferred deferred_;                 ///< latest coalesced request, issued when its predecessor is done
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_ASYNCFHPPICKER_H
@@ -0,0 +1,46 @@
+#ifndef VRN_POITOOLS_COREADAPTER_H
+#define VRN_POITOOLS_COREADAPTER_H
+
+#include "../core/types.h"
+
+#include "tgt/matrix.h"
+#include "tgt/vector.h"
+
+#include <vector>
+
+namespace voreen {
+
+// Conversions between tgt and the types of the GL-free measurement core.
+
+inline poitools::Vec3 toCore(const tgt::vec3& v) {
+    return poitools::Vec3(v.x, v.y, v.z);
+}
+
+inline poitools::IVec2 toCore(const tgt::ivec2& v) {
+    return poitools::IVec2(v.x, v.y);
+}
+
+inline poitools::Mat4 toCore(const tgt::mat4& m) {
+    // both are row-major
+    return poitools::Mat4(m.elem);
+}
+
+inline tgt::vec3 toTgt(const poitools::Vec3& v) {
+    return tgt::vec3(v.x, v.y, v.z);
+}
+
+inline tgt::ivec2 toTgt(const poitools::IVec2& v) {
+    return tgt::ivec2(v.x, v.y);
+}
+
+inline std::vector<tgt::vec3> toTgt(const std::vector<poitools::Vec3>& points) {
+    std::vector<tgt::vec3> result;
+    result.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        result.push_back(toTgt(points[i]));
+    return result;
+}
+
+} // namespace
+
+#endif // VRN_POITOOLS_COREADAPTER_H
@@ -0,0 +1,119 @@
+#include "fhpcache.h"
+
+#include "coreadapter.h"
+
+#include "tgt/logmanager.h"
+#include "tgt/tgt_gl.h"
+
+namespace voreen {
+
+const std::string FhpCache::loggerCat_("voreen.poitools.FhpCache");
+
+FhpCache::FhpCache()
+    : pixels_()
+    , offset_(0)
+    , size_(0)
+    , targetSize_(0)
+    , valid_(false)
+{
+}
+
+void FhpCache::invalidate() {
+    valid_ = false;
+}
+
+void FhpCache::setFormat(const FhpFormat& format) {
+    if (format != format_) {
+        format_ = format;
+        valid_ = false;
+    }
+}
+
+bool FhpCache::covers(tgt::ivec2 llf, tgt::ivec2 urb) const {
+    if (!valid_)
+        return false;
+
+    return llf.x >= offset_.x && llf.y >= offset_.y
+        && urb.x < offset_.x + size_.x && urb.y < offset_.y + size_.y;
+}
+
+void FhpCache::prefetch(RenderPort& port, tgt::ivec2 llf, tgt::ivec2 urb) {
+    tgt::ivec2 portSize = port.getSize();
+    if (portSize.x <= 0 || portSize.y <= 0)
+        return;
+
+    // a resized target invalidates everything we have
+    if (portSize != targetSize_)
+        valid_ = false;
+
+    llf = tgt::clamp(tgt::min(llf, urb), tgt::ivec2(0), portSize - 1);
+    urb = tgt::clamp(tgt::max(llf, urb), tgt::ivec2(0), portSize - 1);
+
+    if (covers(llf, urb))
+        return;
+
+    if (valid_) {
+        llf = tgt::min(llf, offset_);
+        urb = tgt::max(urb, offset_ + size_ - 1);
+    }
+
+    offset_ = llf;
+    size_ = urb - llf + 1;
+    targetSize_ = portSize;
+    // snapshots keep their pixels, the new ones go to a buffer of our own
+    if (!pixels_ || pixels_.use_count() > 1)
+        pixels_ = std::make_shared<std::vector<float> >();
+    pixels_->resize(static_cast<size_t>(size_.x) * static_cast<size_t>(size_.y) * format_.getChannels());
+
+    port.activateTarget();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(offset_.x, offset_.y, size_.x, size_.y, format_.depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, pixels_->data());
+    port.deactivateTarget();
+    LGL_ERROR;
+
+    valid_ = true;
+}
+
+tgt::vec4 FhpCache::getFhp(RenderPort& port, tgt::ivec2 pos) {
+    if (!covers(pos, pos) || port.getSize() != targetSize_)
+        prefetch(port, tgt::ivec2(0), port.getSize() - 1);
+
+    if (!covers(pos, pos))
+        return tgt::vec4(0.0f);
+
+    return getCached(pos);
+}
+
+bool FhpCache::lookup(RenderPort& port, tgt::ivec2 pos, tgt::vec4& fhp) const {
+    if (!covers(pos, pos) || port.getSize() != targetSize_)
+        return false;
+
+    fhp = getCached(pos);
+    return true;
+}
+
+tgt::vec4 FhpCache::getCached(tgt::ivec2 pos) const {
+    tgt::ivec2 p = pos - offset_;
+    size_t index = static_cast<size_t>(p.y) * size_.x + p.x;
+    return format_.toFhp(pos, pixels_->data() + index * format_.getChannels());
+}
+
+poitools::FhpBuffer FhpCache::getBuffer() const {
+    if (!valid_)
+        return poitools::FhpBuffer();
+    poitools::IVec2 offset(offset_.x, offset_.y);
+    if (format_.depth)
+        return poitools::FhpBuffer::fromDepth(pixels_->data(), size_.x, size_.y, offset, toCore(format_.windowToTexture));
+    return poitools::FhpBuffer(pixels_->data(), size_.x, size_.y, offset);
+}
+
+FhpCache::Snapshot FhpCache::getSnapshot() const {
+    Snapshot snapshot;
+    if (valid_) {
+        snapshot.pixels = pixels_;
+        snapshot.buffer = getBuffer();
+    }
+    return snapshot;
+}
+
+} // namespace voreen
@@ -0,0 +1,82 @@
+#ifndef VRN_POITOOLS_FHPCACHE_H
+#define VRN_POITOOLS_FHPCACHE_H
+
+#include "voreen/core/ports/renderport.h"
+
+#include "../core/types.h"
+#include "fhpformat.h"
+
+#include "tgt/vector.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Host side copy of a first-hit-point render target.
+ *
+ * The first time a pixel is requested the (partial) render target is read back
+ * with a single glReadPixels call, all further lookups are served from memory
+ * until the cache is invalidated. The owning processor has to call invalidate()
+ * whenever the FHP port receives new data.
+ *
+ * Snapshots share the pixels with the cache. A readback never overwrites pixels
+ * a snapshot refers to, so snapshots can be handed to worker threads.
+ *
+ * In depth format (see FhpFormat) only the depth attachment is read back.
+ */
+class FhpCache {
+public:
+    /// Immutable copy of the cached region, see getSnapshot().
+    struct Snapshot {
+        std::shared_ptr<const std::vector<float> > pixels;
+        poitools::FhpBuffer buffer;     ///< view of pixels
+    };
+
+    FhpCache();
+
+    /// Drops the cached pixels, the next lookup triggers a new readback.
+    void invalidate();
+
+    /// Sets the format of the render target, the cache is invalidated if it differs from the current one.
+    void setFormat(const FhpFormat& format);
+
+    /**
+     * Makes sure the pixels between llf and urb (inclusive) are available on the host.
+     * Already cached pixels are kept, i.e. the cached region grows to the bounding box
+     * of the old and the requested region.
+     */
+    void prefetch(RenderPort& port, tgt::ivec2 llf, tgt::ivec2 urb);
+
+    /// Returns the first-hit-point at pos, reading back the whole target on a cache miss.
+    tgt::vec4 getFhp(RenderPort& port, tgt::ivec2 pos);
+
+    /// Returns true and sets fhp if pos is cached, never touches the GPU.
+    bool lookup(RenderPort& port, tgt::ivec2 pos, tgt::vec4& fhp) const;
+
+    /// View of the cached region for the measurement core, empty if nothing is cached.
+    poitools::FhpBuffer getBuffer() const;
+
+    /// The cached region, stays valid after the cache has been invalidated or refreshed.
+    Snapshot getSnapshot() const;
+
+private:
+    bool covers(tgt::ivec2 llf, tgt::ivec2 urb) const;
+
+    tgt::vec4 getCached(tgt::ivec2 pos) const;
+
+    FhpFormat format_;
+    std::shared_ptr<std::vector<float> > pixels_; ///< cached region, row by row starting at offset_
+    tgt::ivec2 offset_;             ///< lower left pixel of the cached region
+    tgt::ivec2 size_;               ///< size of the cached region
+    tgt::ivec2 targetSize_;         ///< size of the render target the region was read from
+    bool valid_;
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_FHPCACHE_H
@@ -0,0 +1,53 @@
+#include "fhpformat.h"
+
+#include "coreadapter.h"
+#include "../core/measure.h"
+
+#include "tgt/logmanager.h"
+
+namespace voreen {
+
+const std::string FhpFormat::loggerCat_("voreen.poitools.FhpFormat");
+
+FhpFormat::FhpFormat()
+    : depth(false)
+    , windowToTexture(tgt::mat4::identity)
+{
+}
+
+FhpFormat FhpFormat::createDepth(const tgt::Camera& camera, tgt::ivec2 viewport, const VolumeBase* volume) {
+    FhpFormat format;
+    format.depth = true;
+    if (!volume || viewport.x <= 0 || viewport.y <= 0)
+        return format;
+
+    // window coordinates and depth in [0,1] to normalized device coordinates
+    tgt::mat4 windowToNdc = tgt::mat4::createTranslation(tgt::vec3(-1.0f))
+        * tgt::mat4::createScale(tgt::vec3(2.0f / viewport.x, 2.0f / viewport.y, 2.0f));
+    tgt::mat4 ndcToWorld;
+    tgt::mat4 viewProjection = camera.getProjectionMatrix(viewport) * camera.getViewMatrix();
+    if (!viewProjection.invert(ndcToWorld)) {
+        LERROR("Camera matrix is not invertible");
+        return format;
+    }
+    format.windowToTexture = volume->getWorldToTextureMatrix() * ndcToWorld * windowToNdc;
+    return format;
+}
+
+bool FhpFormat::operator==(const FhpFormat& f) const {
+    if (depth != f.depth)
+        return false;
+    return !depth || windowToTexture == f.windowToTexture;
+}
+
+tgt::vec4 FhpFormat::toFhp(tgt::ivec2 pos, const float* pixel) const {
+    if (!depth)
+        return tgt::vec4(pixel[0], pixel[1], pixel[2], pixel[3]);
+
+    poitools::Vec3 fhp = poitools::unprojectDepth(toCore(windowToTexture), toCore(pos), pixel[0]);
+    if (!poitools::isSurfaceHit(fhp))
+        return tgt::vec4(0.0f);
+    return tgt::vec4(toTgt(fhp), 1.0f);
+}
+
+} // namespace voreen
@@ -0,0 +1,48 @@
+#ifndef VRN_POITOOLS_FHPFORMAT_H
+#define VRN_POITOOLS_FHPFORMAT_H
+
+#include "voreen/core/datastructures/volume/volumebase.h"
+
+#include "tgt/camera.h"
+#include "tgt/matrix.h"
+#include "tgt/vector.h"
+
+#include <string>
+
+namespace voreen {
+
+/**
+ * How the first-hit-points are stored in the render target of the FHP inport.
+ *
+ * By default the target holds positions (texture coordinates in RGB, as written
+ * by FHP compositing). In depth format only the depth attachment of any
+ * rendering of the surface, connected to a separate depth inport, is read, a
+ * single float per pixel instead of four, and the positions are reconstructed
+ * from the camera and the volume matrices. This also avoids the 16 bit float
+ * precision of the RGBA16F target.
+ */
+struct FhpFormat {
+    FhpFormat();
+
+    /// Depth format for the given camera, viewport and volume.
+    static FhpFormat createDepth(const tgt::Camera& camera, tgt::ivec2 viewport, const VolumeBase* volume);
+
+    bool operator==(const FhpFormat& f) const;
+    bool operator!=(const FhpFormat& f) const { return !(*this == f); }
+
+    /// Floats per pixel in a readback.
+    int getChannels() const { return depth ? 1 : 4; }
+
+    /// Converts a pixel read back at pos to a first-hit-point as stored in the RGBA format.
+    tgt::vec4 toFhp(tgt::ivec2 pos, const float* pixel) const;
+
+    bool depth;
+    tgt::mat4 windowToTexture;  ///< maps (x + 0.5, y + 0.5, depth) of a pixel to texture coordinates
+
+private:
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_FHPFORMAT_H
@@ -0,0 +1,224 @@
+#include "fhpraycaster.h"
+
+#include "../core/threadpool.h"
+#include "volumesampling.h"
+
+#include "tgt/logmanager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace voreen {
+
+const std::string FhpRaycaster::loggerCat_("voreen.poitools.FhpRaycaster");
+
+FhpRaycaster::FhpRaycaster(const std::shared_ptr<const VolumeBrickReader>& volume, float isoValue)
+    : volume_(volume)
+    , ram_(0)
+    , dims_(0)
+    , isoValue_(isoValue)
+    , worldToTexture_(tgt::mat4::identity)
+    , stepSize_(0.0f)
+{
+    if (!volume || !volume->isValid())
+        return;
+
+    ram_ = volume->getRam();
+    if (!ram_) {
+        LERROR("Ray casting needs a RAM representation of the volume");
+        return;
+    }
+    dims_ = volume->getDimensions();
+    worldToTexture_ = volume->getWorldToTextureMatrix();
+
+    // half a voxel along the largest dimension, refined by bisection on a hit
+    stepSize_ = 0.5f / static_cast<float>(tgt::max(dims_));
+
+    const VolumeBrickReader::Access access(*volume);
+    if (access)
+        buildHierarchy();
+}
+
+size_t FhpRaycaster::getMemoryUsage() const {
+    size_t bytes = sizeof(FhpRaycaster);
+    for (size_t l = 0; l < levels_.size(); ++l)
+        bytes += levels_[l].max.capacity() * sizeof(float);
+    return bytes;
+}
+
+void FhpRaycaster::buildHierarchy() {
+    // a brick also contains the first voxel of its successor, which trilinear
+    // samples close to its upper border interpolate with
+    Level level;
+    level.brickSize = BRICK_SIZE;
+    level.dims = tgt::max((dims_ - 1 + BRICK_SIZE - 1) / BRICK_SIZE, tgt::ivec3(1));
+    level.max.resize(static_cast<size_t>(tgt::hmul(level.dims)));
+
+    poitools::ThreadPool::getShared().parallelFor(static_cast<size_t>(level.dims.z), [&](size_t bz, size_t) {
+        tgt::ivec3 brick(0, 0, static_cast<int>(bz));
+        for (brick.y = 0; brick.y < level.dims.y; ++brick.y) {
+            for (brick.x = 0; brick.x < level.dims.x; ++brick.x) {
+                tgt::ivec3 lower = brick * BRICK_SIZE;
+                tgt::ivec3 upper = tgt::min(lower + BRICK_SIZE, dims_ - 1);
+                float max = 0.0f;
+                for (int z = lower.z; z <= upper.z; ++z)
+                    for (int y = lower.y; y <= upper.y; ++y)
+                        for (int x = lower.x; x <= upper.x; ++x)
+                            max = std::max(max, ram_->getVoxelNormalized(static_cast<size_t>(x), static_cast<size_t>(y), static_cast<size_t>(z)));
+                level.max[(brick.z * level.dims.y + brick.y) * level.dims.x + brick.x] = max;
+            }
+        }
+    });
+    levels_.push_back(level);
+
+    // coarser levels combine 2x2x2 bricks, up to a single brick
+    while (tgt::hmul(levels_.back().dims) > 1) {
+        const Level& fine = levels_.back();
+        Level coarse;
+        coarse.brickSize = fine.brickSize * 2;
+        coarse.dims = (fine.dims + 1) / 2;
+        coarse.max.assign(static_cast<size_t>(tgt::hmul(coarse.dims)), 0.0f);
+        for (int z = 0; z < fine.dims.z; ++z) {
+            for (int y = 0; y < fine.dims.y; ++y) {
+                for (int x = 0; x < fine.dims.x; ++x) {
+                    float& max = coarse.max[((z / 2) * coarse.dims.y + y / 2) * coarse.dims.x + x / 2];
+                    max = std::max(max, fine.max[(z * fine.dims.y + y) * fine.dims.x + x]);
+                }
+            }
+        }
+        levels_.push_back(coarse);
+    }
+}
+
+FhpRaycaster::View FhpRaycaster::createView(const tgt::Camera& camera, tgt::ivec2 viewport) {
+    View view;
+    view.viewport = viewport;
+    tgt::mat4 viewProjection = camera.getProjectionMatrix(viewport) * camera.getViewMatrix();
+    if (!viewProjection.invert(view.screenToWorld))
+        LERROR("Camera matrix is not invertible");
+    return view;
+}
+
+void FhpRaycaster::setView(const tgt::Camera& camera, tgt::ivec2 viewport) {
+    view_ = createView(camera, viewport);
+}
+
+tgt::vec4 FhpRaycaster::getFhp(tgt::ivec2 pos) const {
+    return getFhp(view_, pos);
+}
+
+tgt::vec4 FhpRaycaster::getFhp(const View& view, tgt::ivec2 pos) const {
+    if (pos.x < 0 || pos.y < 0 || pos.x >= view.viewport.x || pos.y >= view.viewport.y)
+        return tgt::vec4(0.0f);
+
+    tgt::vec2 ndc = (tgt::vec2(pos) + 0.5f) / tgt::vec2(view.viewport) * 2.0f - 1.0f;
+    tgt::vec4 nearPos = view.screenToWorld * tgt::vec4(ndc, -1.0f, 1.0f);
+    tgt::vec4 farPos = view.screenToWorld * tgt::vec4(ndc, 1.0f, 1.0f);
+    tgt::vec3 origin = nearPos.xyz() / nearPos.w;
+    return castRay(origin, farPos.xyz() / farPos.w - origin);
+}
+
+float FhpRaycaster::sample(const tgt::vec3& pos) const {
+    return sampleTrilinear(ram_, dims_, pos);
+}
+
+float FhpRaycaster::skipEmpty(const tgt::vec3& start, const tgt::vec3& dir, float t) const {
+    tgt::vec3 voxel = tgt::clamp(start + t * dir, tgt::vec3(0.0f), tgt::vec3(dims_ - 1));
+    for (size_t l = levels_.size(); l-- > 0; ) {
+        const Level& level = levels_[l];
+        tgt::ivec3 brick = tgt::clamp(tgt::ivec3(tgt::floor(voxel / static_cast<float>(level.brickSize))),
+                                      tgt::ivec3(0), level.dims - 1);
+        if (level.max[(brick.z * level.dims.y + brick.y) * level.dims.x + brick.x] >= isoValue_)
+            continue;
+
+        // leave the brick
+        float exit = std::numeric_limits<float>::max();
+        for (int i = 0; i < 3; ++i) {
+            if (std::abs(dir[i]) < 1e-12f)
+                continue;
+            float border = static_cast<float>((dir[i] > 0.0f ? brick[i] + 1 : brick[i]) * level.brickSize);
+            exit = std::min(exit, (border - start[i]) / dir[i]);
+        }
+        return std::max(exit, t);
+    }
+    return t;
+}
+
+tgt::vec4 FhpRaycaster::castRay(const tgt::vec3& origin, const tgt::vec3& direction) const {
+    if (!ram_ || levels_.empty())
+        return tgt::vec4(0.0f);
+    const VolumeBrickReader::Access access(*volume_);
+    if (!access)
+        return tgt::vec4(0.0f);
+
+    // ray in texture coordinates, clipped against the unit cube
+    tgt::vec3 start = worldToTexture_ * origin;
+    tgt::vec3 dir = worldToTexture_ * (origin + direction) - start;
+    float tNear = 0.0f;
+    float tFar = std::numeric_limits<float>::max();
+    for (int i = 0; i < 3; ++i) {
+        if (std::abs(dir[i]) < 1e-12f) {
+            if (start[i] < 0.0f || start[i] > 1.0f)
+                return tgt::vec4(0.0f);
+            continue;
+        }
+        float t0 = -start[i] / dir[i];
+        float t1 = (1.0f - start[i]) / dir[i];
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar = std::min(tFar, std::max(t0, t1));
+    }
+    if (tNear > tFar)
+        return tgt::vec4(0.0f);
+
+    // the same ray in voxel coordinates for the brick hierarchy
+    tgt::vec3 voxelStart = start * tgt::vec3(dims_) - 0.5f;
+    tgt::vec3 voxelDir = dir * tgt::vec3(dims_);
+
+    float length = tgt::length(dir);
+    float dt = stepSize_ / length;
+    float previous = tNear;     ///< last parameter known to be below the iso value
+    float t = tNear;
+    while (t <= tFar) {
+        float next = skipEmpty(voxelStart, voxelDir, t);
+        if (next > t) {
+            previous = t;
+            t = next;
+            continue;
+        }
+
+        float value = sample(start + t * dir);
+        if (value >= isoValue_) {
+            if (t <= tNear)
+                return tgt::vec4(start + t * dir, 1.0f);
+
+            // bisect between the last sample below and the first sample above the iso value,
+            // down to 1/256 of the sampling distance
+            float lo = previous;
+            float hi = t;
+            float loValue = sample(start + lo * dir);
+            float hiValue = value;
+            while ((hi - lo) * 256.0f > dt) {
+                float mid = 0.5f * (lo + hi);
+                float midValue = sample(start + mid * dir);
+                if (midValue >= isoValue_) {
+                    hi = mid;
+                    hiValue = midValue;
+                } else {
+                    lo = mid;
+                    loValue = midValue;
+                }
+            }
+            // the remaining interval is nearly linear
+            float hit = hi;
+            if (hiValue > loValue)
+                hit = lo + (isoValue_ - loValue) / (hiValue - loValue) * (hi - lo);
+            return tgt::vec4(start + tgt::clamp(hit, lo, hi) * dir, 1.0f);
+        }
+        previous = t;
+        t += dt;
+    }
+    return tgt::vec4(0.0f);
+}
+
+} // namespace voreen
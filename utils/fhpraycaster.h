@@ -0,0 +1,110 @@
+#ifndef VRN_POITOOLS_FHPRAYCASTER_H
+#define VRN_POITOOLS_FHPRAYCASTER_H
+
+#include "volumebrickreader.h"
+
+#include "tgt/camera.h"
+#include "tgt/matrix.h"
+#include "tgt/vector.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Computes first-hit-points on the CPU by casting rays into the RAM
+ * representation of a volume.
+ *
+ * The result has the same layout as a pixel of the FHP render target of a
+ * SingleVolumeRaycaster: the texture coordinates of the first sample whose
+ * normalized intensity reaches the iso value in xyz, and zero for rays that
+ * miss the surface. This allows picking without a GL context, and without
+ * rendering a first-hit-point image at all.
+ *
+ * Empty space is skipped with a hierarchy of the maximum intensity of bricks:
+ * a ray leaves any brick whose maximum is below the iso value in one step,
+ * using the coarsest such brick. Hits are refined by bisection and a final
+ * linear interpolation, i.e. to sub-voxel accuracy. The hierarchy is built
+ * once in the constructor, all const methods may be called concurrently.
+ *
+ * The volume is read through a pinned VolumeBrickReader, so the hierarchy
+ * can be built on a worker (see SurfaceCache::requestRaycaster()). Rays cast
+ * after the reader has been detached miss.
+ */
+class FhpRaycaster {
+public:
+    /// Camera and viewport picks refer to.
+    struct View {
+        View() : screenToWorld(tgt::mat4::identity), viewport(0) {}
+
+        tgt::mat4 screenToWorld;    ///< inverse view projection
+        tgt::ivec2 viewport;
+    };
+
+    /**
+     * @param volume the volume data, pinned with a RAM representation (see SurfaceCache::pinVolume())
+     * @param isoValue iso value in normalized intensity [0,1]
+     */
+    FhpRaycaster(const std::shared_ptr<const VolumeBrickReader>& volume, float isoValue);
+
+    /// False if the hierarchy could not be built, e.g. because the reader has been detached meanwhile.
+    bool isValid() const { return !levels_.empty(); }
+
+    float getIsoValue() const { return isoValue_; }
+
+    /// True once the volume has changed or is gone, rays miss then.
+    bool isDetached() const { return !volume_ || volume_->isDetached(); }
+
+    /// Bytes of the brick hierarchy.
+    size_t getMemoryUsage() const;
+
+    static View createView(const tgt::Camera& camera, tgt::ivec2 viewport);
+
+    /// Sets the view used by getFhp(pos).
+    void setView(const tgt::Camera& camera, tgt::ivec2 viewport);
+
+    /// Returns the first-hit-point of the ray through the center of pixel pos.
+    tgt::vec4 getFhp(tgt::ivec2 pos) const;
+    tgt::vec4 getFhp(const View& view, tgt::ivec2 pos) const;
+
+    /// Returns the first-hit-point of a ray given in world coordinates.
+    tgt::vec4 castRay(const tgt::vec3& origin, const tgt::vec3& direction) const;
+
+private:
+    static const int BRICK_SIZE = 8;    ///< voxels per brick edge on the finest level
+
+    /// Maximum intensities of the bricks of one level, a brick of level l has BRICK_SIZE * 2^l voxels per edge.
+    struct Level {
+        tgt::ivec3 dims;
+        int brickSize;
+        std::vector<float> max;
+    };
+
+    void buildHierarchy();
+
+    /**
+     * If pos (voxel coordinates) lies in a brick below the iso value, returns the
+     * ray parameter where the ray (voxel coordinates) leaves the largest such brick, otherwise t.
+     */
+    float skipEmpty(const tgt::vec3& start, const tgt::vec3& dir, float t) const;
+
+    /// Trilinear intensity at pos (texture coordinates).
+    float sample(const tgt::vec3& pos) const;
+
+    std::shared_ptr<const VolumeBrickReader> volume_;
+    const VolumeRAM* ram_;
+    tgt::ivec3 dims_;
+    float isoValue_;
+    tgt::mat4 worldToTexture_;
+    View view_;                 ///< used by getFhp(pos)
+    float stepSize_;            ///< sampling distance in texture coordinates
+    std::vector<Level> levels_; ///< finest first
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_FHPRAYCASTER_H
@@ -0,0 +1,49 @@
+#ifndef VRN_POITOOLS_FHPSOURCE_H
+#define VRN_POITOOLS_FHPSOURCE_H
+
+#include "../core/measure.h"
+#include "coreadapter.h"
+#include "fhpcache.h"
+#include "fhpraycaster.h"
+
+#include <memory>
+
+namespace voreen {
+
+/**
+ * The first-hit-points of one view, either a snapshot of the first-hit-point
+ * image or a ray caster that computes them on demand (CPU picking).
+ *
+ * Sources are copied into measurement jobs. Both kinds only hold shared,
+ * immutable data, so a copy stays valid on the worker thread.
+ */
+struct FhpSource {
+    FhpCache::Snapshot image;                           ///< used if raycaster is not set
+    std::shared_ptr<const FhpRaycaster> raycaster;
+    std::shared_ptr<const FhpRaycaster::View> view;     ///< camera the raycaster picks from
+
+    /// Sources with equal keys have equal first-hit-points.
+    const void* getKey() const {
+        if (raycaster)
+            return view.get();
+        return image.pixels.get();
+    }
+
+    /// PathSampler::update() on these first-hit-points.
+    float update(poitools::PathSampler& sampler, const poitools::Mat4& textureToWorld,
+                 poitools::IVec2 start, poitools::IVec2 end) const
+    {
+        if (!raycaster)
+            return sampler.update(image.buffer, textureToWorld, start, end);
+
+        const FhpRaycaster& caster = *raycaster;
+        const FhpRaycaster::View& v = *view;
+        return sampler.update(start, end, textureToWorld, [&caster, &v](poitools::IVec2 p) {
+            return toCore(caster.getFhp(v, toTgt(p)).xyz());
+        });
+    }
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_FHPSOURCE_H
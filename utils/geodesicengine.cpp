@@ -0,0 +1,367 @@
+#include "geodesicengine.h"
+
+#include "coreadapter.h"
+#include "volumebrickreader.h"
+
+#include "tgt/logmanager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <thread>
+
+namespace voreen {
+
+const std::string GeodesicEngine::loggerCat_("voreen.poitools.GeodesicEngine");
+
+GeodesicEngine::GeodesicEngine()
+    : cellDims_(0)
+    , worldToCell_(tgt::mat4::identity)
+    , state_()
+    , revision_(0)
+{
+}
+
+void GeodesicEngine::clear() {
+    // engines are shared and replaced, so revisions must not repeat between them
+    static std::atomic<unsigned int> nextRevision(1);
+    revision_ = nextRevision++;
+    positions_.clear();
+    cellIds_.clear();
+    adjOffsets_.clear();
+    adjacency_.clear();
+    state_ = QueryState();
+}
+
+size_t GeodesicEngine::getNumVertices() const {
+    return positions_.size();
+}
+
+size_t GeodesicEngine::getNumEdges() const {
+    return adjacency_.size() / 2;
+}
+
+size_t GeodesicEngine::getMemoryUsage() const {
+    return positions_.capacity() * sizeof(tgt::vec3) + cellIds_.capacity() * sizeof(size_t)
+        + adjOffsets_.capacity() * sizeof(size_t) + adjacency_.capacity() * sizeof(unsigned int)
+        + state_.cost.capacity() * sizeof(float) + (state_.predecessor.capacity() + state_.visited.capacity()
+        + state_.closed.capacity()) * sizeof(unsigned int);
+}
+
+bool GeodesicEngine::build(const VolumeBrickReader& reader, float isoValue, size_t memoryBudget,
+                           const poitools::BrickSummary* summary)
+{
+    clear();
+    if (!reader.isValid()) {
+        LERROR("No volume data for surface extraction");
+        return false;
+    }
+    const int stride = reader.getStride();
+    const poitools::BrickLayout layout = reader.getLayout(memoryBudget);
+    const poitools::IVec3 gridDims = layout.gridDims;
+    cellDims_ = tgt::ivec3(gridDims.x - 1, gridDims.y - 1, gridDims.z - 1);
+    if (tgt::hmul(cellDims_) <= 0) {
+        LWARNING("Volume is too small for surface extraction");
+        return true;
+    }
+
+    // vertices come sorted by cell, positions in grid coordinates
+    {
+        poitools::SurfaceNets nets;
+        if (!nets.extract(layout, reader.getReader(), isoValue, summary)) {
+            if (!reader.isDetached())
+                LERROR("Failed to read the volume for surface extraction");
+            clear();
+            return false;
+        }
+        LDEBUG("Read " << nets.getNumBricksRead() << " of " << layout.getNumBricks() << " bricks of "
+               << layout.brickSize << "^3 cells" << (reader.isOutOfCore() ? " from disk" : ""));
+
+        const tgt::mat4 gridToWorld = reader.getVoxelToWorldMatrix() * tgt::mat4::createScale(tgt::vec3(static_cast<float>(stride)));
+        const std::vector<poitools::Vec3>& gridPositions = nets.getPositions();
+        positions_.resize(gridPositions.size());
+        for (size_t v = 0; v < gridPositions.size(); ++v)
+            positions_[v] = gridToWorld * toTgt(gridPositions[v]);
+        cellIds_ = nets.getCellIds();
+    }
+
+    worldToCell_ = tgt::mat4::createScale(tgt::vec3(1.0f / stride)) * reader.getWorldToVoxelMatrix();
+
+    const size_t numVertices = positions_.size();
+
+    // first vertex of every cell slice
+    const size_t sliceSize = static_cast<size_t>(cellDims_.x) * cellDims_.y;
+    std::vector<size_t> sliceStart(cellDims_.z + 1);
+    for (int z = 0; z <= cellDims_.z; ++z)
+        sliceStart[z] = std::lower_bound(cellIds_.begin(), cellIds_.end(), z * sliceSize) - cellIds_.begin();
+
+    // connect each vertex to its 13 forward neighbors, the backward ones are added by symmetry
+    static const int forward[13][3] = {
+        { 1, 0, 0},
+        {-1, 1, 0}, { 0, 1, 0}, { 1, 1, 0},
+        {-1,-1, 1}, { 0,-1, 1}, { 1,-1, 1},
+        {-1, 0, 1}, { 0, 0, 1}, { 1, 0, 1},
+        {-1, 1, 1}, { 0, 1, 1}, { 1, 1, 1}
+    };
+    // every thread needs two dense slice maps, as many threads as the budget permits
+    const size_t fitting = std::min<size_t>(memoryBudget / (2 * sliceSize * sizeof(int)), 1024);
+    const int numThreads = std::max(1, std::min(std::min(static_cast<int>(std::thread::hardware_concurrency()), cellDims_.z),
+                                                static_cast<int>(fitting)));
+    std::vector<std::vector<std::pair<unsigned int, unsigned int> > > slabEdges(numThreads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < numThreads; ++t) {
+        int zBegin = cellDims_.z * t / numThreads;
+        int zEnd = cellDims_.z * (t + 1) / numThreads;
+        workers.push_back(std::thread([this, zBegin, zEnd, sliceSize, &sliceStart, &slabEdges, t]() {
+            // dense vertex lookup for the current and the next slice
+            std::vector<int> maps[2] = { std::vector<int>(sliceSize, -1), std::vector<int>(sliceSize, -1) };
+            for (int z = zBegin; z < zEnd; ++z) {
+                for (int s = 0; s < 2 && z + s < cellDims_.z; ++s)
+                    for (size_t v = sliceStart[z + s]; v < sliceStart[z + s + 1]; ++v)
+                        maps[s][cellIds_[v] - (z + s) * sliceSize] = static_cast<int>(v);
+
+                for (size_t v = sliceStart[z]; v < sliceStart[z + 1]; ++v) {
+                    int x = static_cast<int>(cellIds_[v] % cellDims_.x);
+                    int y = static_cast<int>((cellIds_[v] / cellDims_.x) % cellDims_.y);
+                    for (int n = 0; n < 13; ++n) {
+                        int nx = x + forward[n][0];
+                        int ny = y + forward[n][1];
+                        int dz = forward[n][2];
+                        if (nx < 0 || ny < 0 || nx >= cellDims_.x || ny >= cellDims_.y || z + dz >= cellDims_.z)
+                            continue;
+                        int neighbor = maps[dz][static_cast<size_t>(ny) * cellDims_.x + nx];
+                        if (neighbor >= 0)
+                            slabEdges[t].push_back(std::make_pair(static_cast<unsigned int>(v), static_cast<unsigned int>(neighbor)));
+                    }
+                }
+
+                for (int s = 0; s < 2 && z + s < cellDims_.z; ++s)
+                    for (size_t v = sliceStart[z + s]; v < sliceStart[z + s + 1]; ++v)
+                        maps[s][cellIds_[v] - (z + s) * sliceSize] = -1;
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+
+    // compressed adjacency lists
+    adjOffsets_.assign(numVertices + 1, 0);
+    for (int t = 0; t < numThreads; ++t) {
+        for (size_t e = 0; e < slabEdges[t].size(); ++e) {
+            adjOffsets_[slabEdges[t][e].first + 1]++;
+            adjOffsets_[slabEdges[t][e].second + 1]++;
+        }
+    }
+    for (size_t v = 0; v < numVertices; ++v)
+        adjOffsets_[v + 1] += adjOffsets_[v];
+    adjacency_.resize(adjOffsets_[numVertices]);
+    std::vector<size_t> fill(adjOffsets_.begin(), adjOffsets_.end() - 1);
+    for (int t = 0; t < numThreads; ++t) {
+        for (size_t e = 0; e < slabEdges[t].size(); ++e) {
+            adjacency_[fill[slabEdges[t][e].first]++] = slabEdges[t][e].second;
+            adjacency_[fill[slabEdges[t][e].second]++] = slabEdges[t][e].first;
+        }
+    }
+
+    LINFO("Extracted surface graph with " << numVertices << " vertices and " << getNumEdges() << " edges");
+    return true;
+}
+
+int GeodesicEngine::findNearestVertex(const tgt::vec3& pos) const {
+    static const int radius = 3;
+
+    tgt::vec3 cellPos = worldToCell_ * pos;
+    tgt::ivec3 cell(static_cast<int>(std::floor(cellPos.x)), static_cast<int>(std::floor(cellPos.y)), static_cast<int>(std::floor(cellPos.z)));
+
+    int best = -1;
+    float bestDistance = std::numeric_limits<float>::max();
+    for (int z = cell.z - radius; z <= cell.z + radius; ++z) {
+        for (int y = cell.y - radius; y <= cell.y + radius; ++y) {
+            for (int x = cell.x - radius; x <= cell.x + radius; ++x) {
+                if (x < 0 || y < 0 || z < 0 || x >= cellDims_.x || y >= cellDims_.y || z >= cellDims_.z)
+                    continue;
+                size_t id = (static_cast<size_t>(z) * cellDims_.y + y) * cellDims_.x + x;
+                std::vector<size_t>::const_iterator it = std::lower_bound(cellIds_.begin(), cellIds_.end(), id);
+                if (it == cellIds_.end() || *it != id)
+                    continue;
+                int v = static_cast<int>(it - cellIds_.begin());
+                float d = tgt::distance(positions_[v], pos);
+                if (d < bestDistance) {
+                    bestDistance = d;
+                    best = v;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+float GeodesicEngine::query(const tgt::vec3& start, const tgt::vec3& end, std::vector<tgt::vec3>* path,
+                            const std::function<bool()>& cancelled)
+{
+    return query(state_, start, end, path, cancelled);
+}
+
+unsigned int GeodesicEngine::beginSearch(QueryState& state) const {
+    // the buffers of a state that has been used with another graph are reset
+    const size_t numVertices = positions_.size();
+    if (state.visited.size() != numVertices) {
+        state.cost.resize(numVertices);
+        state.predecessor.resize(numVertices);
+        state.visited.assign(numVertices, 0);
+        state.closed.assign(numVertices, 0);
+        state.stamp = 0;
+    }
+    if (++state.stamp == 0) {
+        std::fill(state.visited.begin(), state.visited.end(), 0);
+        std::fill(state.closed.begin(), state.closed.end(), 0);
+        state.stamp = 1;
+    }
+    return state.stamp;
+}
+
+float GeodesicEngine::query(QueryState& state, const tgt::vec3& start, const tgt::vec3& end, std::vector<tgt::vec3>* path,
+                            const std::function<bool()>& cancelled) const
+{
+    if (path)
+        path->clear();
+    if (positions_.empty())
+        return -1.0f;
+
+    int source = findNearestVertex(start);
+    int target = findNearestVertex(end);
+    if (source < 0 || target < 0)
+        return -1.0f;
+
+    const unsigned int stamp = beginSearch(state);
+    std::vector<float>& cost = state.cost;
+    std::vector<unsigned int>& predecessor = state.predecessor;
+    std::vector<unsigned int>& visited = state.visited;
+    std::vector<unsigned int>& closed = state.closed;
+
+    // A* with the euclidean distance as (consistent) heuristic
+    typedef std::pair<float, unsigned int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+    const tgt::vec3 goal = positions_[target];
+
+    cost[source] = 0.0f;
+    predecessor[source] = static_cast<unsigned int>(source);
+    visited[source] = stamp;
+    open.push(Entry(tgt::distance(positions_[source], goal), static_cast<unsigned int>(source)));
+
+    bool found = false;
+    size_t numPopped = 0;
+    while (!open.empty()) {
+        if (cancelled && (++numPopped & 1023) == 0 && cancelled())
+            return -1.0f;
+
+        unsigned int u = open.top().second;
+        open.pop();
+        if (closed[u] == stamp)
+            continue;
+        closed[u] = stamp;
+        if (u == static_cast<unsigned int>(target)) {
+            found = true;
+            break;
+        }
+
+        for (size_t i = adjOffsets_[u]; i < adjOffsets_[u + 1]; ++i) {
+            unsigned int v = adjacency_[i];
+            if (closed[v] == stamp)
+                continue;
+            float c = cost[u] + tgt::distance(positions_[u], positions_[v]);
+            if (visited[v] != stamp || c < cost[v]) {
+                visited[v] = stamp;
+                cost[v] = c;
+                predecessor[v] = u;
+                open.push(Entry(c + tgt::distance(positions_[v], goal), v));
+            }
+        }
+    }
+
+    if (!found) {
+        LWARNING("Start and end point are not connected on the surface");
+        return -1.0f;
+    }
+
+    if (path) {
+        path->push_back(end);
+        for (unsigned int v = static_cast<unsigned int>(target); ; v = predecessor[v]) {
+            path->push_back(positions_[v]);
+            if (v == static_cast<unsigned int>(source))
+                break;
+        }
+        path->push_back(start);
+        std::reverse(path->begin(), path->end());
+    }
+
+    return tgt::distance(start, positions_[source]) + cost[target] + tgt::distance(positions_[target], end);
+}
+
+bool GeodesicEngine::queryAll(QueryState& state, const tgt::vec3& start, const std::vector<tgt::vec3>& targets,
+                              const std::vector<int>& targetVertices, float* distances,
+                              const std::function<bool()>& cancelled) const
+{
+    std::fill(distances, distances + targets.size(), -1.0f);
+    int source = positions_.empty() ? -1 : findNearestVertex(start);
+    if (source < 0)
+        return true;
+
+    // Dijkstra until all targets are settled
+    std::vector<int> remaining;
+    for (size_t i = 0; i < targetVertices.size(); ++i)
+        if (targetVertices[i] >= 0)
+            remaining.push_back(targetVertices[i]);
+    std::sort(remaining.begin(), remaining.end());
+    remaining.erase(std::unique(remaining.begin(), remaining.end()), remaining.end());
+    size_t numRemaining = remaining.size();
+
+    const unsigned int stamp = beginSearch(state);
+    std::vector<float>& cost = state.cost;
+    std::vector<unsigned int>& visited = state.visited;
+    std::vector<unsigned int>& closed = state.closed;
+
+    typedef std::pair<float, unsigned int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+    cost[source] = 0.0f;
+    visited[source] = stamp;
+    open.push(Entry(0.0f, static_cast<unsigned int>(source)));
+
+    size_t numPopped = 0;
+    while (!open.empty() && numRemaining > 0) {
+        if (cancelled && (++numPopped & 1023) == 0 && cancelled())
+            return false;
+
+        unsigned int u = open.top().second;
+        open.pop();
+        if (closed[u] == stamp)
+            continue;
+        closed[u] = stamp;
+        if (std::binary_search(remaining.begin(), remaining.end(), static_cast<int>(u)))
+            numRemaining--;
+
+        for (size_t i = adjOffsets_[u]; i < adjOffsets_[u + 1]; ++i) {
+            unsigned int v = adjacency_[i];
+            if (closed[v] == stamp)
+                continue;
+            float c = cost[u] + tgt::distance(positions_[u], positions_[v]);
+            if (visited[v] != stamp || c < cost[v]) {
+                visited[v] = stamp;
+                cost[v] = c;
+                open.push(Entry(c, v));
+            }
+        }
+    }
+
+    const float startOffset = tgt::distance(start, positions_[source]);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        int t = targetVertices[i];
+        if (t >= 0 && closed[t] == stamp)
+            distances[i] = startOffset + cost[t] + tgt::distance(positions_[t], targets[i]);
+    }
+    return true;
+}
+
+} // namespace voreen
@@ -0,0 +1,128 @@
+#ifndef VRN_POITOOLS_GEODESICENGINE_H
+#define VRN_POITOOLS_GEODESICENGINE_H
+
+#include "../core/surfacenets.h"
+
+#include "tgt/matrix.h"
+#include "tgt/vector.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+class VolumeBrickReader;
+
+/**
+ * Computes shortest paths on the isosurface of a volume.
+ *
+ * build() extracts the surface with a surface nets scheme: every cell of the
+ * (optionally subsampled) voxel grid that is crossed by the isosurface gets one
+ * vertex at the mean of its edge crossings, and vertices of 26-adjacent cells
+ * are connected. The volume is read brick by brick (see VolumeBrickReader),
+ * so volumes that only exist on disk are never loaded as a whole.
+ *
+ * The resulting graph is stored in compressed adjacency lists and queried
+ * with an A* search (Dijkstra with the euclidean distance to the target as
+ * heuristic), so paths follow the surface regardless of the view.
+ */
+class GeodesicEngine {
+public:
+    /**
+     * Scratch buffers of a query. They are reused between queries to avoid
+     * resetting them every time, concurrent queries need one each.
+     */
+    struct QueryState {
+        QueryState() : stamp(0) {}
+
+        std::vector<float> cost;
+        std::vector<unsigned int> predecessor;
+        std::vector<unsigned int> visited;  ///< query stamp that last touched the vertex
+        std::vector<unsigned int> closed;   ///< query stamp that settled the vertex
+        unsigned int stamp;
+    };
+
+    static const size_t DEFAULT_EXTRACTION_BUDGET = size_t(256) << 20;
+
+    GeodesicEngine();
+
+    /**
+     * Extracts the surface graph.
+     *
+     * @param reader the volume data, read from RAM or from disk with its stride,
+     *      only every stride-th voxel is sampled
+     * @param isoValue iso value in normalized intensity [0,1]
+     * @param memoryBudget bytes of volume data held at a time while extracting,
+     *      the graph itself depends on the size of the surface only
+     * @param summary value ranges of the bricks, e.g. from SurfaceCache::getBrickSummary(),
+     *      lets the extraction skip the bricks the surface does not cross without reading them
+     * @return false if the volume could not be read, e.g. because the reader has been detached
+     */
+    bool build(const VolumeBrickReader& reader, float isoValue, size_t memoryBudget = DEFAULT_EXTRACTION_BUDGET,
+               const poitools::BrickSummary* summary = 0);
+
+    /// Drops the graph, e.g. because the volume has changed.
+    void clear();
+
+    /// Changes whenever the graph is built or cleared, unique among all engines, so results computed on it can be told apart.
+    unsigned int getRevision() const { return revision_; }
+
+    size_t getNumVertices() const;
+    size_t getNumEdges() const;
+
+    /// Bytes of the graph and the scratch buffers of query().
+    size_t getMemoryUsage() const;
+
+    /**
+     * Computes the length of the shortest surface path between two world positions.
+     * Both positions are snapped to the closest surface vertex.
+     *
+     * @param path if not null, receives the path in world coordinates from start to end
+     * @param cancelled if set, polled during the search, which is aborted once it returns true
+     * @return the path length in world units, or a negative value if the
+     *      positions are not on the surface or not connected or the query has been cancelled
+     */
+    float query(const tgt::vec3& start, const tgt::vec3& end, std::vector<tgt::vec3>* path,
+                const std::function<bool()>& cancelled = std::function<bool()>());
+
+    /// query() with the caller's scratch buffers, may run concurrently with other queries of this kind.
+    float query(QueryState& state, const tgt::vec3& start, const tgt::vec3& end, std::vector<tgt::vec3>* path,
+                const std::function<bool()>& cancelled = std::function<bool()>()) const;
+
+    /**
+     * Surface distances from start to all targets with a single search, as query()
+     * would compute them one by one. May run concurrently like the query above.
+     *
+     * @param targetVertices findNearestVertex() of every target, so it is not repeated for every start
+     * @param distances receives one distance per target, negative if not connected
+     * @return false if it has been cancelled
+     */
+    bool queryAll(QueryState& state, const tgt::vec3& start, const std::vector<tgt::vec3>& targets,
+                  const std::vector<int>& targetVertices, float* distances,
+                  const std::function<bool()>& cancelled = std::function<bool()>()) const;
+
+    /// Returns the vertex closest to pos (world coordinates) or -1 if there is none nearby.
+    int findNearestVertex(const tgt::vec3& pos) const;
+
+private:
+    /// Prepares the scratch buffers for a new search and returns its stamp.
+    unsigned int beginSearch(QueryState& state) const;
+
+    tgt::ivec3 cellDims_;                   ///< number of cells of the subsampled grid
+    tgt::mat4 worldToCell_;
+
+    std::vector<tgt::vec3> positions_;      ///< vertex positions in world coordinates
+    std::vector<size_t> cellIds_;           ///< linear cell index of each vertex, ascending
+    std::vector<size_t> adjOffsets_;        ///< start of each vertex' neighbors in adjacency_
+    std::vector<unsigned int> adjacency_;   ///< neighbor lists of all vertices
+
+    QueryState state_;                      ///< scratch buffers of query()
+    unsigned int revision_;
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_GEODESICENGINE_H
@@ -0,0 +1,45 @@
+#ifndef VRN_POITOOLS_INPUTKEY_H
+#define VRN_POITOOLS_INPUTKEY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * The inputs an output has been produced from, used to skip redundant work in process().
+ *
+ * A processor builds the key of an output from everything the output depends
+ * on (port generations, camera matrices, counters, property values) and only
+ * recomputes the output if the key differs from the one of the last time.
+ * Values are compared bytewise, so only add types without padding.
+ */
+class InputKey {
+public:
+    template<typename T>
+    InputKey& add(const T& value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        bytes_.insert(bytes_.end(), bytes, bytes + sizeof(T));
+        return *this;
+    }
+
+    InputKey& add(const std::string& value) {
+        add(value.size());
+        bytes_.insert(bytes_.end(), value.begin(), value.end());
+        return *this;
+    }
+
+    bool operator==(const InputKey& key) const { return bytes_ == key.bytes_; }
+    bool operator!=(const InputKey& key) const { return bytes_ != key.bytes_; }
+
+    /// An empty key never equals a key with inputs, use it to force an update.
+    void clear() { bytes_.clear(); }
+
+private:
+    std::vector<unsigned char> bytes_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_INPUTKEY_H
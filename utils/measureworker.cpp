@@ -0,0 +1,116 @@
+#include "measureworker.h"
+
+#include "tgt/logmanager.h"
+
+#include <exception>
+
+namespace voreen {
+
+const std::string MeasureWorker::loggerCat_("voreen.poitools.MeasureWorker");
+
+MeasureWorker::MeasureWorker()
+    : queuedId_(0)
+    , running_(false)
+    , quit_(false)
+    , current_(0)
+    , hasResult_(false)
+{
+}
+
+MeasureWorker::~MeasureWorker() {
+    stop();
+}
+
+unsigned int MeasureWorker::submit(const Job& job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+        quit_ = false;
+        thread_ = std::thread(&MeasureWorker::run, this);
+    }
+    queuedId_ = current_.load() + 1;
+    current_.store(queuedId_);
+    queued_ = job;
+    wakeup_.notify_one();
+    return queuedId_;
+}
+
+void MeasureWorker::cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_.store(current_.load() + 1);
+    queued_ = Job();
+    hasResult_ = false;
+}
+
+void MeasureWorker::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return !running_ && !queued_; });
+}
+
+void MeasureWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_.store(current_.load() + 1);
+        queued_ = Job();
+        hasResult_ = false;
+        quit_ = true;
+        wakeup_.notify_one();
+    }
+    if (thread_.joinable())
+        thread_.join();
+}
+
+bool MeasureWorker::isBusy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_ || queued_;
+}
+
+bool MeasureWorker::fetch(Result& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!hasResult_)
+        return false;
+    result = std::move(result_);
+    hasResult_ = false;
+    return true;
+}
+
+void MeasureWorker::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wakeup_.wait(lock, [this]() { return quit_ || queued_; });
+        if (quit_)
+            break;
+
+        Job job;
+        job.swap(queued_);
+        unsigned int id = queuedId_;
+        running_ = true;
+        lock.unlock();
+
+        Result result;
+        result.id = id;
+        result.distance = 0.0f;
+        result.hasPath = false;
+        CancelFlag cancel(current_, id);
+        bool finished = false;
+        try {
+            finished = job(cancel, result);
+        }
+        catch (std::exception& e) {
+            LERROR("Measurement failed: " << e.what());
+        }
+
+        lock.lock();
+        running_ = false;
+        // a job that has been superseded while finishing must not overwrite the newer state
+        if (finished && !cancel.isCancelled()) {
+            result_ = std::move(result);
+            hasResult_ = true;
+        }
+        if (!queued_)
+            idle_.notify_all();
+    }
+    running_ = false;
+    idle_.notify_all();
+}
+
+} // namespace voreen
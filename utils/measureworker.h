@@ -0,0 +1,92 @@
+#ifndef VRN_POITOOLS_MEASUREWORKER_H
+#define VRN_POITOOLS_MEASUREWORKER_H
+
+#include "tgt/vector.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Runs distance measurements on a worker thread.
+ *
+ * Only the newest job matters: submitting a job cancels the running one and
+ * replaces a queued one. Jobs work on data they own (snapshots), the processor
+ * picks up the result of the last finished job with fetch() in process().
+ * Jobs are expected to poll the cancel flag in long loops and return early.
+ */
+class MeasureWorker {
+public:
+    struct Result {
+        unsigned int id;            ///< returned by submit()
+        float distance;
+        std::vector<tgt::vec3> path;
+        bool hasPath;               ///< false for previews that only compute the distance
+        std::vector<float> segmentLengths;  ///< polyline measurements only
+        std::string text;                   ///< jobs with a textual result, e.g. a distance table
+    };
+
+    /// Tells a job whether it has been superseded.
+    class CancelFlag {
+    public:
+        CancelFlag(const std::atomic<unsigned int>& current, unsigned int id) : current_(current), id_(id) {}
+        bool isCancelled() const { return current_.load(std::memory_order_relaxed) != id_; }
+
+    private:
+        const std::atomic<unsigned int>& current_;
+        unsigned int id_;
+    };
+
+    /// Fills the result and returns true, or returns false if it has been cancelled or its volume is gone.
+    typedef std::function<bool(const CancelFlag& cancel, Result& result)> Job;
+
+    MeasureWorker();
+    ~MeasureWorker();
+
+    /// Queues job, cancelling all previous ones. Starts the thread on first use.
+    unsigned int submit(const Job& job);
+
+    /// Cancels the running and the queued job, a pending result is dropped.
+    void cancel();
+
+    /// Blocks until the worker is idle.
+    void wait();
+
+    /// Cancels everything and joins the thread.
+    void stop();
+
+    /// True while a job is queued or running.
+    bool isBusy() const;
+
+    /// Moves the result of the newest finished job to result, returns false if there is none.
+    bool fetch(Result& result);
+
+private:
+    void run();
+
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable idle_;
+
+    Job queued_;
+    unsigned int queuedId_;
+    bool running_;
+    bool quit_;
+    std::atomic<unsigned int> current_;   ///< id of the newest job, older ones are cancelled
+
+    Result result_;
+    bool hasResult_;
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_MEASUREWORKER_H
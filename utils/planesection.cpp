@@ -0,0 +1,121 @@
+#include "planesection.h"
+
+#include "coreadapter.h"
+#include "volumesampling.h"
+
+#include "voreen/core/datastructures/volume/volumeram.h"
+
+#include "tgt/logmanager.h"
+
+#include <cmath>
+#include <limits>
+
+namespace voreen {
+
+const std::string PlaneSection::loggerCat_("voreen.poitools.PlaneSection");
+
+float PlaneSection::measure(const VolumeBrickReader& volume, float isoValue, const tgt::vec3& point, const tgt::vec3& normal,
+                            std::vector<tgt::vec3>* contour, const std::function<bool()>& cancelled)
+{
+    if (contour)
+        contour->clear();
+    if (!volume.isValid() || tgt::length(normal) == 0.0f)
+        return 0.0f;
+    const VolumeRAM* ram = volume.getRam();
+    if (!ram) {
+        LERROR("Plane sections need a RAM representation of the volume");
+        return 0.0f;
+    }
+    const VolumeBrickReader::Access access(volume);
+    if (!access)
+        return -1.0f;
+    const tgt::ivec3 dims = volume.getDimensions();
+    const tgt::mat4 textureToWorld = volume.getTextureToWorldMatrix();
+    const tgt::mat4 worldToTexture = volume.getWorldToTextureMatrix();
+
+    // orthonormal basis of the plane
+    const tgt::vec3 n = tgt::normalize(normal);
+    const tgt::vec3 u = tgt::normalize(tgt::cross(n, std::abs(n.x) < 0.9f ? tgt::vec3(1.0f, 0.0f, 0.0f) : tgt::vec3(0.0f, 1.0f, 0.0f)));
+    const tgt::vec3 v = tgt::cross(n, u);
+
+    // the grid covers the projection of the volume's bounding box, plus one sample for contours along its border
+    tgt::vec2 lower(std::numeric_limits<float>::max());
+    tgt::vec2 upper(-std::numeric_limits<float>::max());
+    float step = std::numeric_limits<float>::max();
+    for (int i = 0; i < 8; ++i) {
+        tgt::vec4 corner((i & 1) ? 1.0f : 0.0f, (i & 2) ? 1.0f : 0.0f, (i & 4) ? 1.0f : 0.0f, 1.0f);
+        tgt::vec3 world = (textureToWorld * corner).xyz() - point;
+        tgt::vec2 projected(tgt::dot(world, u), tgt::dot(world, v));
+        lower = tgt::min(lower, projected);
+        upper = tgt::max(upper, projected);
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        tgt::vec4 edge(0.0f);
+        edge[axis] = 1.0f / static_cast<float>(dims[axis]);
+        step = std::min(step, tgt::length((textureToWorld * edge).xyz()));
+    }
+    tgt::vec2 extent = upper - lower;
+    float samples = (extent.x / step + 3.0f) * (extent.y / step + 3.0f);
+    if (samples > static_cast<float>(MAX_SAMPLES))
+        step *= std::sqrt(samples / static_cast<float>(MAX_SAMPLES));
+
+    poitools::PlaneContour::Grid grid;
+    grid.origin = toCore(point + u * (lower.x - step) + v * (lower.y - step));
+    grid.u = toCore(u * step);
+    grid.v = toCore(v * step);
+    grid.width = static_cast<int>(std::ceil(extent.x / step)) + 3;
+    grid.height = static_cast<int>(std::ceil(extent.y / step)) + 3;
+
+    // rows are walked in texture coordinates, samples outside the volume are empty
+    const tgt::vec3 texOrigin = (worldToTexture * tgt::vec4(toTgt(grid.origin), 1.0f)).xyz();
+    const tgt::vec3 texU = (worldToTexture * tgt::vec4(u * step, 0.0f)).xyz();
+    const tgt::vec3 texV = (worldToTexture * tgt::vec4(v * step, 0.0f)).xyz();
+    const poitools::PlaneContour::RowSampler sample = [&](int j, size_t, float* values) {
+        const tgt::vec3 row = texOrigin + texV * static_cast<float>(j);
+        for (int i = 0; i < grid.width; ++i) {
+            tgt::vec3 pos = row + texU * static_cast<float>(i);
+            bool inside = pos.x >= 0.0f && pos.y >= 0.0f && pos.z >= 0.0f && pos.x <= 1.0f && pos.y <= 1.0f && pos.z <= 1.0f;
+            values[i] = inside ? sampleTrilinear(ram, dims, pos) : 0.0f;
+        }
+    };
+
+    if (!slice_.extract(grid, isoValue, sample, poitools::ThreadPool::getShared(), cancelled))
+        return -1.0f;
+
+    int nearest = slice_.findNearest(toCore(point));
+    if (nearest < 0)
+        return 0.0f;
+    const poitools::PlaneContour::Contour& result = slice_.getContours()[nearest];
+    if (contour) {
+        *contour = toTgt(result.points);
+        if (result.closed && !contour->empty())
+            contour->push_back(contour->front());
+    }
+    return result.length;
+}
+
+tgt::vec3 PlaneSection::getNormal(const std::vector<tgt::vec3>& points, const tgt::vec3& viewDirection, const tgt::vec3& screenRight) {
+    if (points.empty())
+        return tgt::vec3(0.0f);
+
+    const size_t first = points.size() < 3 ? 0 : points.size() - 3;
+    const tgt::vec3 a = points[first];
+    const tgt::vec3 c = points.back();
+    if (points.size() - first == 3) {
+        const tgt::vec3 b = points[first + 1];
+        tgt::vec3 normal = tgt::cross(b - a, c - a);
+        if (tgt::length(normal) > 1e-6f * tgt::length(b - a) * tgt::length(c - a))
+            return tgt::normalize(normal);
+        // collinear, the line between the outer ones is used as for two points
+    }
+
+    tgt::vec3 direction = c - a;
+    if (tgt::length(direction) < 1e-6f)
+        direction = screenRight;
+    tgt::vec3 normal = tgt::cross(direction, viewDirection);
+    if (tgt::length(normal) < 1e-6f * tgt::length(direction) * tgt::length(viewDirection))
+        return tgt::vec3(0.0f);
+    return tgt::normalize(normal);
+}
+
+} // namespace
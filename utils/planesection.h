@@ -0,0 +1,62 @@
+#ifndef VRN_POITOOLS_PLANESECTION_H
+#define VRN_POITOOLS_PLANESECTION_H
+
+#include "../core/planecontour.h"
+#include "../core/threadpool.h"
+
+#include "volumebrickreader.h"
+
+#include "tgt/vector.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Measures closed loops on the isosurface of a volume, e.g. a head
+ * circumference, by cutting the surface with a plane.
+ *
+ * The volume is resampled on a grid of the plane with about the smallest
+ * voxel size, and the contour of the iso value is extracted from the slice
+ * with marching squares (see poitools::PlaneContour), in parallel over bands
+ * of rows. Outside the volume the intensity is zero, so a surface that is cut
+ * off by the volume border is closed along it.
+ */
+class PlaneSection {
+public:
+    /**
+     * Cuts the surface with the plane through point (world coordinates) and
+     * measures the contour passing closest to point.
+     *
+     * @param volume the volume data, pinned with a RAM representation (see SurfaceCache::pinVolume())
+     * @param isoValue iso value in normalized intensity [0,1]
+     * @param contour if not null, receives the contour in world coordinates, closed contours end with their first point
+     * @param cancelled if set, polled during the extraction, which is aborted once it returns true
+     * @return the length of the contour in world units, 0 if the plane misses
+     *      the surface, or a negative value if it has been cancelled or the volume is gone
+     */
+    float measure(const VolumeBrickReader& volume, float isoValue, const tgt::vec3& point, const tgt::vec3& normal,
+                  std::vector<tgt::vec3>* contour, const std::function<bool()>& cancelled = std::function<bool()>());
+
+    /**
+     * Normal of the plane defined by picked points (world coordinates). The
+     * last three points span the plane. Two points define the plane that
+     * contains both and the view direction, i.e. the line between them on the
+     * screen, a single point the plane of the horizontal screen line through it.
+     * Returns zero if the points do not define a plane.
+     */
+    static tgt::vec3 getNormal(const std::vector<tgt::vec3>& points, const tgt::vec3& viewDirection, const tgt::vec3& screenRight);
+
+private:
+    static const int MAX_SAMPLES = 2048 * 2048;    ///< the grid is coarsened for larger slices
+
+    poitools::PlaneContour slice_;
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_PLANESECTION_H
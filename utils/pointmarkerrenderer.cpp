@@ -0,0 +1,134 @@
+#include "pointmarkerrenderer.h"
+
+#include "tgt/logmanager.h"
+
+#include <algorithm>
+
+namespace voreen {
+
+const std::string PointMarkerRenderer::loggerCat_("voreen.poitools.PointMarkerRenderer");
+
+PointMarkerRenderer::PointMarkerRenderer()
+    : shader_(0)
+    , vao_(0)
+    , cornerBuffer_(0)
+    , instanceBuffer_(0)
+    , bufferCapacity_(0)
+    , points_()
+    , dirty_(false)
+{
+}
+
+PointMarkerRenderer::~PointMarkerRenderer() {
+    if (shader_ || vao_)
+        LWARNING("GL resources have not been released (deinitialize() not called)");
+}
+
+void PointMarkerRenderer::initialize(const std::string& header) {
+    shader_ = ShdrMgr.loadSeparate("pointmarker.vert", "", "pointmarker.frag", header, false);
+    if (!shader_) {
+        LERROR("Failed to load point marker shader");
+        return;
+    }
+
+    static const float corners[8] = { -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f };
+
+    glGenVertexArrays(1, &vao_);
+    glBindVertexArray(vao_);
+
+    glGenBuffers(1, &cornerBuffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, cornerBuffer_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    GLint cornerLocation = shader_->getAttributeLocation("corner_");
+    if (cornerLocation >= 0) {
+        glEnableVertexAttribArray(cornerLocation);
+        glVertexAttribPointer(cornerLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    }
+
+    glGenBuffers(1, &instanceBuffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+    GLint centerLocation = shader_->getAttributeLocation("center_");
+    if (centerLocation >= 0) {
+        glEnableVertexAttribArray(centerLocation);
+        glVertexAttribPointer(centerLocation, 3, GL_FLOAT, GL_FALSE, sizeof(tgt::vec3), 0);
+        glVertexAttribDivisor(centerLocation, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    LGL_ERROR;
+
+    bufferCapacity_ = 0;
+    dirty_ = true;
+}
+
+void PointMarkerRenderer::deinitialize() {
+    if (vao_)
+        glDeleteVertexArrays(1, &vao_);
+    if (cornerBuffer_)
+        glDeleteBuffers(1, &cornerBuffer_);
+    if (instanceBuffer_)
+        glDeleteBuffers(1, &instanceBuffer_);
+    vao_ = cornerBuffer_ = instanceBuffer_ = 0;
+    bufferCapacity_ = 0;
+
+    if (shader_)
+        ShdrMgr.dispose(shader_);
+    shader_ = 0;
+    LGL_ERROR;
+}
+
+void PointMarkerRenderer::setPoints(const std::vector<tgt::vec3>& points) {
+    if (points == points_)
+        return;
+    points_ = points;
+    dirty_ = true;
+}
+
+void PointMarkerRenderer::upload() {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+    // grow geometrically, so adding points one by one does not reallocate every frame
+    if (points_.size() > bufferCapacity_) {
+        bufferCapacity_ = std::max(points_.size(), 2 * bufferCapacity_);
+        glBufferData(GL_ARRAY_BUFFER, bufferCapacity_ * sizeof(tgt::vec3), 0, GL_DYNAMIC_DRAW);
+    }
+    if (!points_.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, 0, points_.size() * sizeof(tgt::vec3), points_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    LGL_ERROR;
+    dirty_ = false;
+}
+
+void PointMarkerRenderer::render(const tgt::mat4& viewMatrix, const tgt::mat4& projectionMatrix, float radius,
+                                 const tgt::vec4& color, const tgt::ImmediateMode::LightSource& lightSource,
+                                 const tgt::ImmediateMode::Material& material)
+{
+    if (!shader_ || !vao_)
+        return;
+    if (dirty_)
+        upload();
+    if (points_.empty())
+        return;
+
+    shader_->activate();
+    shader_->setIgnoreUniformLocationError(true);
+    shader_->setUniform("viewMatrix_", viewMatrix);
+    shader_->setUniform("projectionMatrix_", projectionMatrix);
+    shader_->setUniform("radius_", radius);
+    shader_->setUniform("color_", color);
+    shader_->setUniform("lightPosition_", lightSource.position);
+    shader_->setUniform("lightAmbient_", lightSource.ambientColor);
+    shader_->setUniform("lightDiffuse_", lightSource.diffuseColor);
+    shader_->setUniform("lightSpecular_", lightSource.specularColor);
+    shader_->setUniform("shininess_", material.shininess);
+    shader_->setIgnoreUniformLocationError(false);
+
+    glBindVertexArray(vao_);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(points_.size()));
+    glBindVertexArray(0);
+
+    shader_->deactivate();
+    LGL_ERROR;
+}
+
+} // namespace voreen
@@ -0,0 +1,69 @@
+#ifndef VRN_POITOOLS_POINTMARKERRENDERER_H
+#define VRN_POITOOLS_POINTMARKERRENDERER_H
+
+#include "tgt/immediatemode/immediatemode.h"
+#include "tgt/matrix.h"
+#include "tgt/shadermanager.h"
+#include "tgt/tgt_gl.h"
+#include "tgt/vector.h"
+
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Draws a list of points as lit spheres with a single instanced draw call.
+ *
+ * Every point is a camera facing quad (glsl/pointmarker.vert) on which the
+ * fragment shader ray casts the sphere and writes the correct depth
+ * (glsl/pointmarker.frag), so the cost per point is independent of any
+ * tessellation. The point positions are kept in an instance buffer that is
+ * only uploaded when the point list has changed.
+ *
+ * All methods except setPoints() have to be called with the processor's GL
+ * context being active.
+ */
+class PointMarkerRenderer {
+public:
+    PointMarkerRenderer();
+    ~PointMarkerRenderer();
+
+    /// Loads the shader and creates the buffers, header is the processor's shader header.
+    void initialize(const std::string& header);
+
+    /// Releases shader and buffers. Has to be called before the GL context is destroyed.
+    void deinitialize();
+
+    /// Sets the sphere centers (world coordinates), uploaded with the next render().
+    void setPoints(const std::vector<tgt::vec3>& points);
+
+    /**
+     * Renders all points into the currently active render target.
+     *
+     * @param lightSource light, position in eye space (as for IMode)
+     * @param material only the shininess is used, the ambient and diffuse
+     *      coefficients are those of the immediate mode
+     */
+    void render(const tgt::mat4& viewMatrix, const tgt::mat4& projectionMatrix, float radius,
+                const tgt::vec4& color, const tgt::ImmediateMode::LightSource& lightSource,
+                const tgt::ImmediateMode::Material& material);
+
+private:
+    void upload();
+
+    tgt::Shader* shader_;
+    GLuint vao_;
+    GLuint cornerBuffer_;       ///< the four corners of the billboard quad
+    GLuint instanceBuffer_;     ///< one sphere center per instance
+    size_t bufferCapacity_;     ///< number of centers the instance buffer can hold
+
+    std::vector<tgt::vec3> points_;
+    bool dirty_;                ///< points_ differ from the instance buffer
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_POINTMARKERRENDERER_H
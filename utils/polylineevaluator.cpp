@@ -0,0 +1,97 @@
+#include "polylineevaluator.h"
+
+#include "coreadapter.h"
+
+#include <algorithm>
+
+namespace voreen {
+
+PolylineEvaluator::PolylineEvaluator()
+    : numEvaluated_(0)
+{
+}
+
+void PolylineEvaluator::clear() {
+    entries_.clear();
+    numEvaluated_ = 0;
+}
+
+bool PolylineEvaluator::isUpToDate(const Entry& entry, const Segment& segment, const Settings& settings) const {
+    if (!entry.valid || !(entry.segment == segment) || entry.settings.geodesic != settings.geodesic)
+        return false;
+    if (settings.geodesic)
+        return entry.settings.engine == settings.engine && entry.settings.engineRevision == settings.engineRevision;
+    return entry.settings.bilinear == settings.bilinear && entry.settings.textureToWorld == settings.textureToWorld;
+}
+
+bool PolylineEvaluator::evaluate(const std::vector<Segment>& segments, const Settings& settings,
+                                 const std::function<bool()>& cancelled)
+{
+    // segments are identified by their position in the chain
+    entries_.resize(segments.size());
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (!isUpToDate(entries_[i], segments[i], settings))
+            dirty.push_back(i);
+    }
+    numEvaluated_ = 0;
+
+    poitools::ThreadPool& pool = poitools::ThreadPool::getShared();
+    queryStates_.resize(pool.getNumThreads());
+    pool.parallelFor(dirty.size(), [&](size_t item, size_t thread) {
+        if (cancelled && cancelled())
+            return;
+
+        Entry& entry = entries_[dirty[item]];
+        const Segment& segment = segments[dirty[item]];
+        entry.valid = false;
+
+        if (settings.geodesic) {
+            if (!settings.engine)
+                return;
+            float dist = settings.engine->query(queryStates_[thread], segment.start3D, segment.end3D, &entry.path, cancelled);
+            if (cancelled && cancelled())
+                return;
+            entry.length = std::max(dist, 0.0f);
+        } else {
+            // keeps the samples if only the end point has moved since the last time
+            if (entry.segment.fhp.getKey() != segment.fhp.getKey())
+                entry.sampler.invalidate();
+            entry.sampler.setBilinear(settings.bilinear);
+            entry.length = segment.fhp.update(entry.sampler, settings.textureToWorld,
+                                              toCore(segment.start2D), toCore(segment.end2D));
+            entry.path = toTgt(entry.sampler.getPath());
+        }
+        entry.segment = segment;
+        entry.settings = settings;
+        entry.valid = true;
+    });
+
+    for (size_t i = 0; i < dirty.size(); ++i) {
+        if (!entries_[dirty[i]].valid)
+            return false;
+        numEvaluated_++;
+    }
+    return true;
+}
+
+float PolylineEvaluator::getTotalLength() const {
+    float total = 0.0f;
+    for (size_t i = 0; i < entries_.size(); ++i)
+        total += entries_[i].length;
+    return total;
+}
+
+std::vector<tgt::vec3> PolylineEvaluator::getCombinedPath() const {
+    size_t size = 0;
+    for (size_t i = 0; i < entries_.size(); ++i)
+        size += entries_[i].path.size();
+
+    std::vector<tgt::vec3> path;
+    path.reserve(size);
+    for (size_t i = 0; i < entries_.size(); ++i)
+        path.insert(path.end(), entries_[i].path.begin(), entries_[i].path.end());
+    return path;
+}
+
+} // namespace voreen
@@ -0,0 +1,100 @@
+#ifndef VRN_POITOOLS_POLYLINEEVALUATOR_H
+#define VRN_POITOOLS_POLYLINEEVALUATOR_H
+
+#include "../core/measure.h"
+#include "../core/threadpool.h"
+#include "fhpsource.h"
+#include "geodesicengine.h"
+
+#include "tgt/vector.h"
+
+#include <functional>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Measures a chain of segments on a thread pool and keeps the results.
+ *
+ * Each segment remembers the data it has been measured on (end points,
+ * first-hit-points, matrix, distance mode), evaluate() only measures the
+ * segments for which any of these have changed. Screen space segments keep
+ * their PathSampler, so the segment being dragged is updated incrementally.
+ *
+ * Screen space segments carry the first-hit-points of the view they have been
+ * drawn in, later views do not change them.
+ */
+class PolylineEvaluator {
+public:
+    struct Segment {
+        tgt::ivec2 start2D;     ///< viewport positions, used in screen space mode
+        tgt::ivec2 end2D;
+        tgt::vec3 start3D;      ///< world positions, used in geodesic mode
+        tgt::vec3 end3D;
+        FhpSource fhp;          ///< first-hit-points the viewport positions refer to
+
+        bool operator==(const Segment& s) const {
+            return start2D == s.start2D && end2D == s.end2D && start3D == s.start3D && end3D == s.end3D
+                && fhp.getKey() == s.fhp.getKey();
+        }
+    };
+
+    /// Data the segments are measured on.
+    struct Settings {
+        Settings() : geodesic(false), bilinear(false), engine(0), engineRevision(0) {}
+
+        bool geodesic;
+        bool bilinear;                  ///< sub-pixel sampling of screen space segments
+        poitools::Mat4 textureToWorld;  ///< screen space mode
+        const GeodesicEngine* engine;   ///< geodesic mode, has to be built already
+        unsigned int engineRevision;    ///< GeodesicEngine::getRevision() of engine
+    };
+
+    PolylineEvaluator();
+
+    /**
+     * Measures all segments whose inputs differ from the previous call.
+     *
+     * @param cancelled polled between segments (and during geodesic queries)
+     * @return false if it has been cancelled, the finished segments are kept anyway
+     */
+    bool evaluate(const std::vector<Segment>& segments, const Settings& settings,
+                  const std::function<bool()>& cancelled = std::function<bool()>());
+
+    size_t getNumSegments() const { return entries_.size(); }
+    float getLength(size_t segment) const { return entries_[segment].length; }
+    float getTotalLength() const;
+    const std::vector<tgt::vec3>& getPath(size_t segment) const { return entries_[segment].path; }
+
+    /// Paths of all segments one after the other.
+    std::vector<tgt::vec3> getCombinedPath() const;
+
+    /// Number of segments measured by the last evaluate().
+    size_t getNumEvaluated() const { return numEvaluated_; }
+
+    /// Forgets all results.
+    void clear();
+
+private:
+    struct Entry {
+        Entry() : valid(false), length(0.0f) {}
+
+        bool valid;
+        Segment segment;
+        Settings settings;          ///< the segment has been measured with
+        poitools::PathSampler sampler;
+        float length;
+        std::vector<tgt::vec3> path;
+    };
+
+    bool isUpToDate(const Entry& entry, const Segment& segment, const Settings& settings) const;
+
+    std::vector<Entry> entries_;
+    size_t numEvaluated_;
+
+    std::vector<GeodesicEngine::QueryState> queryStates_;    ///< one per thread of the shared pool
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_POLYLINEEVALUATOR_H
@@ -0,0 +1,199 @@
+#include "screenoverlay.h"
+
+#include "tgt/logmanager.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace voreen {
+
+const std::string ScreenOverlay::loggerCat_("voreen.poitools.ScreenOverlay");
+
+const float ScreenOverlay::LINE_WIDTH = 2.0f;
+const float ScreenOverlay::DISC_RADIUS = 4.0f;
+const float ScreenOverlay::MIN_SPACING = 2.0f;
+const int ScreenOverlay::TILE_SIZE = 32;
+
+namespace {
+
+// vertex flags, see glsl/pointfitting.frag
+const float FLAG_DISC = 1.0f;
+const float FLAG_LINE = 2.0f;   ///< connected to the next vertex
+
+} // namespace
+
+ScreenOverlay::ScreenOverlay()
+    : depthTolerance_(0.0f)
+    , dirty_(false)
+    , projectedView_(tgt::mat4::identity)
+    , projectedViewport_(0)
+    , bounds_(0.0f)
+    , grid_(0)
+    , buffer_(0)
+    , texture_(0)
+    , tileBuffer_(0)
+    , tileTexture_(0)
+{
+}
+
+ScreenOverlay::~ScreenOverlay() {
+    if (buffer_ || texture_ || tileBuffer_ || tileTexture_)
+        LWARNING("GL resources have not been released (deinitialize() not called)");
+}
+
+void ScreenOverlay::deinitialize() {
+    if (texture_)
+        glDeleteTextures(1, &texture_);
+    if (buffer_)
+        glDeleteBuffers(1, &buffer_);
+    if (tileTexture_)
+        glDeleteTextures(1, &tileTexture_);
+    if (tileBuffer_)
+        glDeleteBuffers(1, &tileBuffer_);
+    texture_ = buffer_ = tileTexture_ = tileBuffer_ = 0;
+    dirty_ = true;
+    LGL_ERROR;
+}
+
+void ScreenOverlay::setPath(const std::vector<tgt::vec3>& path, float depthTolerance) {
+    path_ = path;
+    depthTolerance_ = depthTolerance;
+    dirty_ = true;
+}
+
+void ScreenOverlay::project(const tgt::Camera& camera, tgt::ivec2 viewport) {
+    tgt::mat4 viewProjection = camera.getProjectionMatrix(viewport) * camera.getViewMatrix();
+    tgt::vec3 eye = camera.getPosition();
+    tgt::vec2 lower(std::numeric_limits<float>::max());
+    tgt::vec2 upper(-std::numeric_limits<float>::max());
+
+    vertices_.clear();
+    for (size_t i = 0; i < path_.size(); ++i) {
+        // moved towards the camera, so the depth test accepts points slightly below the surface
+        tgt::vec3 p = path_[i];
+        float distance = tgt::length(eye - p);
+        if (distance > 0.0f)
+            p += (eye - p) * (std::min(depthTolerance_, 0.5f * distance) / distance);
+
+        tgt::vec4 clip = viewProjection * tgt::vec4(p, 1.0f);
+        if (clip.w <= 0.0f) {
+            // behind the camera, interrupts the line
+            if (!vertices_.empty())
+                vertices_.back().w = 0.0f;
+            continue;
+        }
+        tgt::vec3 ndc = clip.xyz() / clip.w;
+        tgt::vec4 vertex((ndc.x * 0.5f + 0.5f) * viewport.x, (ndc.y * 0.5f + 0.5f) * viewport.y, ndc.z * 0.5f + 0.5f, FLAG_LINE);
+
+        // dense paths (one vertex per pixel in screen space mode) are thinned out, the last vertex is kept
+        bool connected = !vertices_.empty() && vertices_.back().w == FLAG_LINE;
+        if (connected && i + 1 < path_.size() && tgt::distance(vertex.xy(), vertices_.back().xy()) < MIN_SPACING)
+            continue;
+
+        vertices_.push_back(vertex);
+        lower = tgt::min(lower, vertex.xy());
+        upper = tgt::max(upper, vertex.xy());
+    }
+
+    // discs mark both ends
+    if (!vertices_.empty()) {
+        vertices_.front().w = FLAG_DISC + FLAG_LINE;
+        vertices_.back().w = FLAG_DISC;
+        // vertices close to the camera may project far outside, the tiles only cover the viewport
+        float margin = std::max(DISC_RADIUS, LINE_WIDTH) + 1.0f;
+        bounds_ = tgt::vec4(tgt::max(lower - margin, tgt::vec2(0.0f)), tgt::min(upper + margin, tgt::vec2(viewport)));
+    }
+
+    projectedView_ = viewProjection;
+    projectedViewport_ = viewport;
+    dirty_ = false;
+
+    if (vertices_.empty())
+        return;
+    binTiles();
+    if (!buffer_) {
+        glGenBuffers(1, &buffer_);
+        glGenTextures(1, &texture_);
+        glGenBuffers(1, &tileBuffer_);
+        glGenTextures(1, &tileTexture_);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+    glBufferData(GL_TEXTURE_BUFFER, vertices_.size() * sizeof(tgt::vec4), vertices_.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, tileBuffer_);
+    glBufferData(GL_TEXTURE_BUFFER, tiles_.size() * sizeof(GLint), tiles_.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer_);
+    glBindTexture(GL_TEXTURE_BUFFER, tileTexture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, tileBuffer_);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    LGL_ERROR;
+}
+
+void ScreenOverlay::binTiles() {
+    const tgt::vec2 origin = bounds_.xy();
+    grid_ = tgt::max(tgt::ivec2(tgt::ceil((bounds_.zw() - origin) / static_cast<float>(TILE_SIZE))), tgt::ivec2(1));
+    const int tileCount = grid_.x * grid_.y;
+
+    // the box around the disc and the line to the next vertex, in tiles
+    const float margin = std::max(DISC_RADIUS, 0.5f * LINE_WIDTH) + 1.0f;
+    std::vector<tgt::ivec4> boxes(vertices_.size());
+    for (size_t i = 0; i < vertices_.size(); ++i) {
+        tgt::vec2 lower = vertices_[i].xy();
+        tgt::vec2 upper = lower;
+        if (vertices_[i].w >= FLAG_LINE && i + 1 < vertices_.size()) {
+            lower = tgt::min(lower, vertices_[i + 1].xy());
+            upper = tgt::max(upper, vertices_[i + 1].xy());
+        }
+        tgt::ivec2 first = tgt::ivec2(tgt::floor((lower - margin - origin) / static_cast<float>(TILE_SIZE)));
+        tgt::ivec2 last = tgt::ivec2(tgt::floor((upper + margin - origin) / static_cast<float>(TILE_SIZE)));
+        boxes[i] = tgt::ivec4(tgt::clamp(first, tgt::ivec2(0), grid_ - 1), tgt::clamp(last, tgt::ivec2(0), grid_ - 1));
+    }
+
+    // counted first, so every tile's indices are contiguous and in path order
+    tiles_.assign(tileCount + 1, 0);
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        for (int y = boxes[i].y; y <= boxes[i].w; ++y)
+            for (int x = boxes[i].x; x <= boxes[i].z; ++x)
+                tiles_[y * grid_.x + x + 1]++;
+    }
+    tiles_[0] = tileCount + 1;
+    for (int t = 0; t < tileCount; ++t)
+        tiles_[t + 1] += tiles_[t];
+
+    std::vector<GLint> next(tiles_.begin(), tiles_.end() - 1);
+    tiles_.resize(tiles_.back());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        for (int y = boxes[i].y; y <= boxes[i].w; ++y)
+            for (int x = boxes[i].x; x <= boxes[i].z; ++x)
+                tiles_[next[y * grid_.x + x]++] = static_cast<GLint>(i);
+    }
+}
+
+void ScreenOverlay::setUniforms(tgt::Shader* program, tgt::TextureUnit& unit, tgt::TextureUnit& tileUnit, const tgt::Camera& camera,
+                                tgt::ivec2 viewport, const tgt::vec4& color, bool visible)
+{
+    tgt::mat4 viewProjection = camera.getProjectionMatrix(viewport) * camera.getViewMatrix();
+    if (visible && (dirty_ || viewport != projectedViewport_ || viewProjection != projectedView_))
+        project(camera, viewport);
+
+    // the samplers are always bound, as samplers of different types must not share a unit
+    unit.activate();
+    glBindTexture(GL_TEXTURE_BUFFER, texture_);
+    tileUnit.activate();
+    glBindTexture(GL_TEXTURE_BUFFER, tileTexture_);
+    program->setIgnoreUniformLocationError(true);
+    program->setUniform("overlayTex_", unit.getUnitNumber());
+    program->setUniform("overlayTiles_", tileUnit.getUnitNumber());
+    program->setUniform("overlayCount_", visible ? static_cast<GLint>(vertices_.size()) : 0);
+    program->setUniform("overlayBounds_", bounds_);
+    program->setUniform("overlayGrid_", grid_);
+    program->setUniform("overlayTileSize_", static_cast<float>(TILE_SIZE));
+    program->setUniform("overlayLineWidth_", LINE_WIDTH);
+    program->setUniform("overlayDiscRadius_", DISC_RADIUS);
+    program->setUniform("overlayColor_", color);
+    program->setIgnoreUniformLocationError(false);
+    LGL_ERROR;
+}
+
+} // namespace voreen
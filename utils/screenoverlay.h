@@ -0,0 +1,86 @@
+#ifndef VRN_POITOOLS_SCREENOVERLAY_H
+#define VRN_POITOOLS_SCREENOVERLAY_H
+
+#include "tgt/camera.h"
+#include "tgt/matrix.h"
+#include "tgt/shadermanager.h"
+#include "tgt/textureunit.h"
+#include "tgt/tgt_gl.h"
+#include "tgt/vector.h"
+
+#include <string>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * A polyline on the surface, drawn by the compositing shader (glsl/pointfitting.frag)
+ * instead of a draw call of its own.
+ *
+ * The vertices are projected to window coordinates on the CPU, thinned out to
+ * a minimum spacing and uploaded to a texture buffer whenever the path or the
+ * view changes. The bounding box of the overlay is divided into tiles of
+ * TILE_SIZE pixels, and a second texture buffer lists the vertices whose
+ * segment or disc touches each tile. The fragment shader only tests the
+ * entries of its tile, and compares their depth with the depth of the
+ * composited image, so parts hidden by the surface are not drawn.
+ *
+ * All methods except setPath() have to be called with the processor's GL
+ * context being active.
+ */
+class ScreenOverlay {
+public:
+    ScreenOverlay();
+    ~ScreenOverlay();
+
+    /// Releases the buffers. Has to be called before the GL context is destroyed.
+    void deinitialize();
+
+    /**
+     * Sets the path in world coordinates, an empty path disables the overlay.
+     *
+     * @param depthTolerance world units the path may lie below the visible surface,
+     *      e.g. for paths on a coarser surface graph
+     */
+    void setPath(const std::vector<tgt::vec3>& path, float depthTolerance);
+
+    bool isEmpty() const { return path_.empty(); }
+
+    /**
+     * Projects and uploads the path for the view if necessary and sets the
+     * overlay uniforms of the compositing shader, binding the vertices to unit
+     * and the tiles to tileUnit. A hidden overlay only binds the buffers.
+     */
+    void setUniforms(tgt::Shader* program, tgt::TextureUnit& unit, tgt::TextureUnit& tileUnit, const tgt::Camera& camera,
+                     tgt::ivec2 viewport, const tgt::vec4& color, bool visible);
+
+private:
+    void project(const tgt::Camera& camera, tgt::ivec2 viewport);
+    void binTiles();    ///< fills tiles_ from vertices_ and bounds_
+
+    static const float LINE_WIDTH;      ///< pixels
+    static const float DISC_RADIUS;     ///< pixels, end points of the path
+    static const float MIN_SPACING;     ///< pixels between uploaded vertices
+    static const int TILE_SIZE;         ///< pixels per side of a tile
+
+    std::vector<tgt::vec3> path_;
+    float depthTolerance_;
+    bool dirty_;                        ///< path_ has changed since the last projection
+    tgt::mat4 projectedView_;           ///< view projection of the uploaded vertices
+    tgt::ivec2 projectedViewport_;
+
+    std::vector<tgt::vec4> vertices_;   ///< window x, y, depth and flags, see glsl/pointfitting.frag
+    tgt::vec4 bounds_;                  ///< lower left and upper right in window coordinates
+    tgt::ivec2 grid_;                   ///< tiles of bounds_ in x and y
+    std::vector<GLint> tiles_;          ///< grid_ x * y + 1 offsets into tiles_ of each tile's vertex indices, then the indices
+    GLuint buffer_;
+    GLuint texture_;
+    GLuint tileBuffer_;
+    GLuint tileTexture_;
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_SCREENOVERLAY_H
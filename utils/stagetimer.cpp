@@ -0,0 +1,168 @@
+#include "stagetimer.h"
+
+#include "tgt/logmanager.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace voreen {
+
+const std::string StageTimer::loggerCat_("voreen.poitools.StageTimer");
+
+StageTimer::Scope::Scope(StageTimer& timer, const char* stage, bool gpu)
+    : timer_(timer.isEnabled() ? &timer : 0)
+    , stage_(stage)
+{
+    queries_[0] = queries_[1] = 0;
+    if (!timer_)
+        return;
+
+    if (gpu) {
+        queries_[0] = timer_->acquireQuery();
+        queries_[1] = timer_->acquireQuery();
+        glQueryCounter(queries_[0], GL_TIMESTAMP);
+    }
+    start_ = std::chrono::steady_clock::now();
+}
+
+StageTimer::Scope::~Scope() {
+    if (!timer_)
+        return;
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    double startUs = std::chrono::duration<double, std::micro>(start_ - timer_->epoch_).count();
+    timer_->record(stage_, false, startUs, std::chrono::duration<double, std::micro>(end - start_).count());
+
+    if (queries_[0]) {
+        glQueryCounter(queries_[1], GL_TIMESTAMP);
+        PendingQuery pending;
+        pending.stage = stage_;
+        pending.queries[0] = queries_[0];
+        pending.queries[1] = queries_[1];
+        pending.startUs = startUs;
+        timer_->pending_.push_back(pending);
+    }
+}
+
+StageTimer::StageTimer(const std::string& name)
+    : name_(name)
+    , enabled_(false)
+    , epoch_(std::chrono::steady_clock::now())
+{
+}
+
+StageTimer::~StageTimer() {
+    if (!pending_.empty() || !freeQueries_.empty())
+        LWARNING("Timer queries have not been released (deinitialize() not called)");
+}
+
+void StageTimer::deinitialize() {
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        freeQueries_.push_back(pending_[i].queries[0]);
+        freeQueries_.push_back(pending_[i].queries[1]);
+    }
+    pending_.clear();
+    if (!freeQueries_.empty())
+        glDeleteQueries(static_cast<GLsizei>(freeQueries_.size()), freeQueries_.data());
+    freeQueries_.clear();
+    LGL_ERROR;
+    setTraceFile("");
+}
+
+void StageTimer::setEnabled(bool enabled) {
+    if (enabled == enabled_)
+        return;
+    enabled_ = enabled;
+    cpuStats_.clear();
+    gpuStats_.clear();
+}
+
+void StageTimer::setTraceFile(const std::string& path) {
+    if (path == tracePath_)
+        return;
+    if (trace_.is_open())
+        trace_.close();
+    tracePath_ = path;
+    if (path.empty())
+        return;
+
+    // the closing bracket is optional in the trace event format, so the file stays valid when appending
+    trace_.open(path.c_str(), std::ios::out | std::ios::trunc);
+    if (!trace_)
+        LERROR("Cannot write trace file " << path);
+    else
+        trace_ << "[\n";
+}
+
+GLuint StageTimer::acquireQuery() {
+    if (!freeQueries_.empty()) {
+        GLuint query = freeQueries_.back();
+        freeQueries_.pop_back();
+        return query;
+    }
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    return query;
+}
+
+void StageTimer::collect() {
+    // queries finish in issue order, so stop at the first one that is not available yet
+    size_t done = 0;
+    for (; done < pending_.size(); ++done) {
+        PendingQuery& pending = pending_[done];
+        GLint available = 0;
+        glGetQueryObjectiv(pending.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(pending.queries[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(pending.queries[1], GL_QUERY_RESULT, &end);
+        if (enabled_)
+            record(pending.stage, true, pending.startUs, static_cast<double>(end - begin) / 1000.0);
+
+        freeQueries_.push_back(pending.queries[0]);
+        freeQueries_.push_back(pending.queries[1]);
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + done);
+    LGL_ERROR;
+
+    if (trace_.is_open())
+        trace_.flush();
+}
+
+void StageTimer::record(const std::string& stage, bool gpu, double startUs, double durationUs) {
+    std::vector<std::pair<std::string, Stats> >& stats = gpu ? gpuStats_ : cpuStats_;
+    size_t i = 0;
+    while (i < stats.size() && stats[i].first != stage)
+        ++i;
+    if (i == stats.size()) {
+        Stats empty = { 0.0, 0.0, 0 };
+        stats.push_back(std::make_pair(stage, empty));
+    }
+
+    Stats& s = stats[i].second;
+    double ms = durationUs / 1000.0;
+    s.last = ms;
+    s.average = s.count == 0 ? ms : 0.9 * s.average + 0.1 * ms;
+    s.count++;
+
+    if (trace_.is_open()) {
+        trace_ << "{\"name\":\"" << stage << "\",\"cat\":\"" << name_ << (gpu ? ".gpu" : ".cpu")
+               << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (gpu ? 2 : 1)
+               << ",\"ts\":" << std::fixed << std::setprecision(3) << startUs
+               << ",\"dur\":" << durationUs << "},\n";
+    }
+}
+
+std::string StageTimer::getReport() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < cpuStats_.size(); ++i)
+        out << cpuStats_[i].first << " cpu: " << cpuStats_[i].second.last << " ms (avg " << cpuStats_[i].second.average << " ms)\n";
+    for (size_t i = 0; i < gpuStats_.size(); ++i)
+        out << gpuStats_[i].first << " gpu: " << gpuStats_[i].second.last << " ms (avg " << gpuStats_[i].second.average << " ms)\n";
+    return out.str();
+}
+
+} // namespace voreen
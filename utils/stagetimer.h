@@ -0,0 +1,92 @@
+#ifndef VRN_POITOOLS_STAGETIMER_H
+#define VRN_POITOOLS_STAGETIMER_H
+
+#include "tgt/tgt_gl.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Collects per-stage timings of a processor.
+ *
+ * Stages are timed with a Scope object. CPU time is taken from a monotonic
+ * clock, GPU stages additionally place GL timestamp queries around the stage
+ * whose results are fetched without stalling by collect() in a later frame.
+ * While the timer is disabled a Scope only tests a flag.
+ *
+ * Optionally, every measurement is appended to a Chrome trace file
+ * (chrome://tracing, Perfetto), CPU and GPU stages on separate tracks.
+ */
+class StageTimer {
+public:
+    class Scope {
+    public:
+        /// Times the lifetime of the scope as stage, gpu also times the GL commands issued meanwhile.
+        Scope(StageTimer& timer, const char* stage, bool gpu = false);
+        ~Scope();
+
+    private:
+        StageTimer* timer_;     ///< null if the timer is disabled
+        const char* stage_;
+        GLuint queries_[2];
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    /// @param name prefix of the trace categories, usually the processor's class name
+    explicit StageTimer(const std::string& name);
+    ~StageTimer();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled_; }
+
+    /// Appends all following measurements to path, an empty path stops tracing.
+    void setTraceFile(const std::string& path);
+
+    /// Fetches the results of finished GPU queries, never waits. Needs the GL context.
+    void collect();
+
+    /// Last and average duration of every stage in ms, one stage per line.
+    std::string getReport() const;
+
+    /// Releases the GL queries. Has to be called before the GL context is destroyed.
+    void deinitialize();
+
+private:
+    struct Stats {
+        double last;        ///< ms
+        double average;     ///< exponential moving average in ms
+        size_t count;
+    };
+
+    struct PendingQuery {
+        std::string stage;
+        GLuint queries[2];
+        double startUs;     ///< cpu time the stage started at, used to place it in the trace
+    };
+
+    void record(const std::string& stage, bool gpu, double startUs, double durationUs);
+    GLuint acquireQuery();
+
+    std::string name_;
+    bool enabled_;
+    std::chrono::steady_clock::time_point epoch_;
+
+    std::vector<std::pair<std::string, Stats> > cpuStats_;  ///< in order of first appearance
+    std::vector<std::pair<std::string, Stats> > gpuStats_;
+    std::vector<PendingQuery> pending_;
+    std::vector<GLuint> freeQueries_;
+
+    std::string tracePath_;
+    std::ofstream trace_;
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_STAGETIMER_H
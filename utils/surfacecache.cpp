@@ -0,0 +1,281 @@
+#include "surfacecache.h"
+
+#include "volumebrickreader.h"
+
+#include "tgt/logmanager.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+namespace voreen {
+
+const std::string SurfaceCache::loggerCat_("voreen.poitools.SurfaceCache");
+
+bool SurfaceCache::Key::operator<(const Key& other) const {
+    if (volume != other.volume)
+        return volume < other.volume;
+    if (kind != other.kind)
+        return kind < other.kind;
+    return parameters < other.parameters;
+}
+
+SurfaceCache::SurfaceCache(size_t memoryBudget)
+    : memoryBudget_(memoryBudget)
+    , memoryUsage_(0)
+    , useCounter_(0)
+{
+}
+
+SurfaceCache::~SurfaceCache() {
+    // deleted volumes have already been removed from observed_
+    for (std::set<const VolumeBase*>::const_iterator it = observed_.begin(); it != observed_.end(); ++it)
+        (*it)->removeObserver(this);
+}
+
+void SurfaceCache::setMemoryBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memoryBudget_ = budget;
+    evict();
+}
+
+size_t SurfaceCache::getMemoryBudget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memoryBudget_;
+}
+
+size_t SurfaceCache::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memoryUsage_;
+}
+
+std::shared_ptr<const VolumeBrickReader> SurfaceCache::pinVolume(const VolumeBase* volume, int stride, bool requireRam) {
+    std::shared_ptr<VolumeBrickReader> reader(new VolumeBrickReader(volume, stride, requireRam));
+    if (!volume)
+        return reader;
+    observe(volume);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    typedef std::multimap<const VolumeBase*, std::weak_ptr<VolumeBrickReader> >::iterator Iterator;
+    std::pair<Iterator, Iterator> range = pinned_.equal_range(volume);
+    for (Iterator it = range.first; it != range.second;) {
+        if (it->second.expired())
+            it = pinned_.erase(it);
+        else
+            ++it;
+    }
+    pinned_.insert(std::make_pair(volume, std::weak_ptr<VolumeBrickReader>(reader)));
+    return reader;
+}
+
+SurfaceCache::Request<GeodesicEngine> SurfaceCache::requestGeodesicEngine(const VolumeBase* volume, float isoValue, int stride,
+                                                                          size_t extractionBudget)
+{
+    std::ostringstream parameters;
+    parameters.precision(std::numeric_limits<float>::max_digits10);
+    parameters << isoValue << " " << stride;
+
+    Request<GeodesicEngine> request;
+    request.cache_ = this;
+    request.key_ = Key(volume, "geodesic", parameters.str());
+    request.data_ = find<GeodesicEngine>(request.key_);
+    if (request.data_ || !volume)
+        return request;
+
+    std::shared_ptr<const VolumeBrickReader> reader = pinVolume(volume, stride);
+    request.build_ = [this, volume, reader, isoValue, extractionBudget]() {
+        // the summary costs a pass over the data, which only pays off if reading is expensive
+        std::shared_ptr<const poitools::BrickSummary> summary;
+        if (reader->isOutOfCore())
+            summary = getBrickSummary(volume, *reader, extractionBudget);
+        GeodesicEngine* engine = new GeodesicEngine();
+        if (!engine->build(*reader, isoValue, extractionBudget, summary.get())) {
+            delete engine;
+            return static_cast<GeodesicEngine*>(0);
+        }
+        return engine;
+    };
+    request.memoryUsage_ = [](const GeodesicEngine& engine) { return engine.getMemoryUsage(); };
+    return request;
+}
+
+std::shared_ptr<const GeodesicEngine> SurfaceCache::getGeodesicEngine(const VolumeBase* volume, float isoValue, int stride,
+                                                                      size_t extractionBudget)
+{
+    return requestGeodesicEngine(volume, isoValue, stride, extractionBudget).get();
+}
+
+std::shared_ptr<const poitools::BrickSummary> SurfaceCache::getBrickSummary(const VolumeBase* volume, const VolumeBrickReader& reader,
+                                                                            size_t extractionBudget)
+{
+    const poitools::BrickLayout layout = reader.getLayout(extractionBudget);
+    std::ostringstream parameters;
+    parameters << reader.getStride() << " " << layout.brickSize;
+    return get<poitools::BrickSummary>(Key(volume, "bricks", parameters.str()),
+        [&reader, &layout]() {
+            poitools::BrickSummary* summary = new poitools::BrickSummary();
+            if (!reader.isValid() || !poitools::SurfaceNets::summarize(layout, reader.getReader(), *summary)) {
+                delete summary;
+                return static_cast<poitools::BrickSummary*>(0);
+            }
+            return summary;
+        },
+        [](const poitools::BrickSummary& summary) { return summary.getMemoryUsage(); });
+}
+
+SurfaceCache::Request<FhpRaycaster> SurfaceCache::requestRaycaster(const VolumeBase* volume, float isoValue) {
+    std::ostringstream parameters;
+    parameters.precision(std::numeric_limits<float>::max_digits10);
+    parameters << isoValue;
+
+    Request<FhpRaycaster> request;
+    request.cache_ = this;
+    request.key_ = Key(volume, "raycaster", parameters.str());
+    request.data_ = find<FhpRaycaster>(request.key_);
+    if (request.data_ || !volume)
+        return request;
+
+    std::shared_ptr<const VolumeBrickReader> reader = pinVolume(volume, 1, true);
+    request.build_ = [reader, isoValue]() {
+        FhpRaycaster* raycaster = new FhpRaycaster(reader, isoValue);
+        if (!raycaster->isValid()) {
+            delete raycaster;
+            return static_cast<FhpRaycaster*>(0);
+        }
+        return raycaster;
+    };
+    request.memoryUsage_ = [](const FhpRaycaster& raycaster) { return raycaster.getMemoryUsage(); };
+    return request;
+}
+
+std::shared_ptr<const FhpRaycaster> SurfaceCache::getRaycaster(const VolumeBase* volume, float isoValue) {
+    return requestRaycaster(volume, isoValue).get();
+}
+
+void SurfaceCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t budget = memoryBudget_;
+    memoryBudget_ = 0;
+    evict();
+    memoryBudget_ = budget;
+}
+
+void SurfaceCache::volumeDelete(const VolumeBase* source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropVolume(source);
+    observed_.erase(source);
+}
+
+void SurfaceCache::volumeChange(const VolumeBase* source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropVolume(source);
+}
+
+void SurfaceCache::observe(const VolumeBase* volume) {
+    bool added;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        added = volume && observed_.insert(volume).second;
+    }
+    // outside the lock, the volume notifies with its own lock held
+    if (added)
+        volume->addObserver(this);
+}
+
+std::shared_ptr<const void> SurfaceCache::getEntry(const Key& key, const Builder& build) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        std::map<Key, Entry>::iterator it = entries_.find(key);
+        if (it == entries_.end())
+            break;
+        if (!it->second.building) {
+            it->second.lastUse = ++useCounter_;
+            return it->second.data;
+        }
+        if (!build)
+            return std::shared_ptr<const void>();
+        // the entry may also be dropped meanwhile, it is built here then
+        built_.wait(lock);
+    }
+    if (!build)
+        return std::shared_ptr<const void>();
+
+    // the placeholder tells other threads to wait, lastUse identifies this build
+    Entry& placeholder = entries_[key];
+    placeholder.lastUse = ++useCounter_;
+    const unsigned long long buildId = placeholder.lastUse;
+    lock.unlock();
+
+    size_t bytes = 0;
+    std::shared_ptr<const void> data;
+    try {
+        data = build(bytes);
+    }
+    catch (...) {
+        lock.lock();
+        std::map<Key, Entry>::iterator it = entries_.find(key);
+        if (it != entries_.end() && it->second.building && it->second.lastUse == buildId)
+            entries_.erase(it);
+        built_.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    // a volume that changed while building has dropped the placeholder, the data is only returned then,
+    // failures are not stored, e.g. of a reader detached meanwhile
+    std::map<Key, Entry>::iterator it = entries_.find(key);
+    if (it != entries_.end() && it->second.building && it->second.lastUse == buildId) {
+        if (!data) {
+            entries_.erase(it);
+        } else {
+            it->second.data = data;
+            it->second.building = false;
+            it->second.memoryUsage = bytes;
+            memoryUsage_ += bytes;
+            evict();
+            LDEBUG("Built " << key.kind << " (" << bytes / 1024 << " KiB), " << memoryUsage_ / (1024 * 1024) << " MiB cached");
+        }
+    }
+    built_.notify_all();
+    return data;
+}
+
+void SurfaceCache::evict() {
+    while (memoryUsage_ > memoryBudget_) {
+        // only the cache refers to unused entries
+        std::map<Key, Entry>::iterator oldest = entries_.end();
+        for (std::map<Key, Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+            if (!it->second.building && it->second.data.use_count() <= 1
+                    && (oldest == entries_.end() || it->second.lastUse < oldest->second.lastUse))
+                oldest = it;
+        }
+        if (oldest == entries_.end())
+            break;
+        memoryUsage_ -= oldest->second.memoryUsage;
+        entries_.erase(oldest);
+    }
+}
+
+void SurfaceCache::dropVolume(const VolumeBase* volume) {
+    // builds reading the volume fail once the brick they read is done
+    typedef std::multimap<const VolumeBase*, std::weak_ptr<VolumeBrickReader> >::iterator Iterator;
+    std::pair<Iterator, Iterator> range = pinned_.equal_range(volume);
+    for (Iterator pin = range.first; pin != range.second; ++pin) {
+        if (std::shared_ptr<VolumeBrickReader> reader = pin->second.lock())
+            reader->detach();
+    }
+    pinned_.erase(range.first, range.second);
+
+    std::map<Key, Entry>::iterator it = entries_.begin();
+    while (it != entries_.end()) {
+        if (it->first.volume == volume) {
+            memoryUsage_ -= it->second.memoryUsage;
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    built_.notify_all();
+}
+
+} // namespace
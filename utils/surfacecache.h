@@ -0,0 +1,218 @@
+#ifndef VRN_POITOOLS_SURFACECACHE_H
+#define VRN_POITOOLS_SURFACECACHE_H
+
+#include "voreen/core/datastructures/volume/volumebase.h"
+
+#include "fhpraycaster.h"
+#include "geodesicengine.h"
+#include "volumebrickreader.h"
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace voreen {
+
+/**
+ * Data derived from volumes, shared by all processors of the module.
+ *
+ * A PointFitting and a SurfaceMeasure on the same volume need the same
+ * surface graph and ray casting hierarchy, which take seconds to build for
+ * large volumes. The cache is owned by the module (see PoiTools) and builds
+ * every entry once, on the thread that asks for it first. Threads asking for
+ * an entry that is being built wait for it.
+ *
+ * Entries are handed out as shared pointers to const data, i.e. they are
+ * reference counted and may be used concurrently. Entries that are not
+ * referenced by any processor are kept as long as the memory budget permits,
+ * the least recently used ones are dropped first. Entries in use are never
+ * dropped. All entries of a volume are dropped when it changes or is deleted.
+ * The budget is a setting of the module, see PoiTools.
+ *
+ * Only data of the volume alone is cached. The host copies of first-hit-point
+ * renderings change with every frame and stay with their processor (FhpCache).
+ *
+ * Volumes may only be touched on the thread owning them. Workers get a
+ * Request instead, which is looked up there and builds a missing entry from
+ * the data pinned by pinVolume().
+ */
+class SurfaceCache : public VolumeObserver {
+public:
+    struct Key {
+        Key() : volume(0) {}
+        Key(const VolumeBase* volume, const std::string& kind, const std::string& parameters)
+            : volume(volume), kind(kind), parameters(parameters) {}
+
+        bool operator<(const Key& other) const;
+
+        const VolumeBase* volume;
+        std::string kind;               ///< type of the data, e.g. "geodesic"
+        std::string parameters;         ///< everything else it depends on, e.g. the iso value
+    };
+
+    /**
+     * Entry looked up on the thread owning the volume and handed to a worker,
+     * which builds it if it does not exist yet. A missing entry is built from
+     * a pinned VolumeBrickReader, so the worker never touches the volume.
+     */
+    template<class T>
+    class Request {
+    public:
+        Request() : cache_(0) {}
+
+        /// True if the entry existed when it was requested, get() does not build then.
+        bool isReady() const { return static_cast<bool>(data_); }
+
+        /// Returns the entry, built on the calling thread if necessary, null if the volume has changed or is gone.
+        std::shared_ptr<const T> get() const;
+
+    private:
+        friend class SurfaceCache;
+
+        SurfaceCache* cache_;
+        Key key_;
+        std::shared_ptr<const T> data_;
+        std::function<T*()> build_;
+        std::function<size_t(const T&)> memoryUsage_;
+    };
+
+    static const size_t DEFAULT_BUDGET = size_t(1) << 30;
+
+    explicit SurfaceCache(size_t memoryBudget = DEFAULT_BUDGET);
+    ~SurfaceCache();
+
+    /// Drops unused entries until the cache fits into budget bytes.
+    void setMemoryBudget(size_t budget);
+    size_t getMemoryBudget() const;
+
+    /// Bytes of all entries, including those in use.
+    size_t getMemoryUsage() const;
+
+    /**
+     * Reader of volume for another thread. It is detached, i.e. reads fail,
+     * as soon as the volume changes or is deleted, see VolumeBrickReader.
+     *
+     * @param requireRam see VolumeBrickReader()
+     */
+    std::shared_ptr<const VolumeBrickReader> pinVolume(const VolumeBase* volume, int stride, bool requireRam = false);
+
+    /**
+     * Surface graph of volume, see GeodesicEngine::build(). Volumes on disk
+     * are read with the bricks of getBrickSummary() the surface crosses.
+     *
+     * @param extractionBudget bytes of volume data held at a time while the graph is built,
+     *      it does not change the graph, so graphs built with another budget are reused
+     */
+    Request<GeodesicEngine> requestGeodesicEngine(const VolumeBase* volume, float isoValue, int stride,
+                                                  size_t extractionBudget = GeodesicEngine::DEFAULT_EXTRACTION_BUDGET);
+
+    /// requestGeodesicEngine() built on the calling thread.
+    std::shared_ptr<const GeodesicEngine> getGeodesicEngine(const VolumeBase* volume, float isoValue, int stride,
+                                                            size_t extractionBudget = GeodesicEngine::DEFAULT_EXTRACTION_BUDGET);
+
+    /**
+     * Value ranges of the bricks the volume of reader is read in with this
+     * budget. They do not depend on the iso value, so a graph for another iso
+     * value skips the bricks the surface does not cross without reading them.
+     *
+     * @param volume only identifies the entry, the data is read through reader
+     * @return null if the volume cannot be read
+     */
+    std::shared_ptr<const poitools::BrickSummary> getBrickSummary(const VolumeBase* volume, const VolumeBrickReader& reader,
+                                                                  size_t extractionBudget);
+
+    /// Ray casting hierarchy of volume, views are passed to its const methods.
+    Request<FhpRaycaster> requestRaycaster(const VolumeBase* volume, float isoValue);
+
+    /// requestRaycaster() built on the calling thread.
+    std::shared_ptr<const FhpRaycaster> getRaycaster(const VolumeBase* volume, float isoValue);
+
+    /// Drops all entries that are not in use.
+    void clear();
+
+    // VolumeObserver
+    virtual void volumeDelete(const VolumeBase* source);
+    virtual void volumeChange(const VolumeBase* source);
+
+private:
+    struct Entry {
+        Entry() : building(true), memoryUsage(0), lastUse(0) {}
+
+        std::shared_ptr<const void> data;
+        bool building;                  ///< data is being built by another thread
+        size_t memoryUsage;
+        unsigned long long lastUse;
+    };
+
+    typedef std::function<std::shared_ptr<const void>(size_t&)> Builder;
+
+    /**
+     * Returns the entry for key, built by build if it does not exist yet.
+     * Null results are returned but not stored. The volume of key is not
+     * touched, it has to be observed already, see observe().
+     *
+     * @param memoryUsage bytes of the built data, counted against the budget
+     */
+    template<class T>
+    std::shared_ptr<const T> get(const Key& key, const std::function<T*()>& build, const std::function<size_t(const T&)>& memoryUsage);
+
+    /// Returns the entry for key if it has been built, without building it.
+    template<class T>
+    std::shared_ptr<const T> find(const Key& key);
+
+    /// Type independent part of get() and find(), build is null for find().
+    std::shared_ptr<const void> getEntry(const Key& key, const Builder& build);
+
+    /// Registers the cache at volume, on the thread owning it.
+    void observe(const VolumeBase* volume);
+
+    /// Drops unused entries, least recently used first, until the budget is met. Needs mutex_.
+    void evict();
+
+    /**
+     * Drops all entries of volume and detaches its pinned readers, builds in
+     * progress are returned to their caller but not stored. Needs mutex_.
+     */
+    void dropVolume(const VolumeBase* volume);
+
+    std::map<Key, Entry> entries_;
+    std::set<const VolumeBase*> observed_;  ///< volumes this is registered at
+    std::multimap<const VolumeBase*, std::weak_ptr<VolumeBrickReader> > pinned_;  ///< readers of pinVolume()
+    size_t memoryBudget_;
+    size_t memoryUsage_;
+    unsigned long long useCounter_;         ///< increased on every get(), orders the entries by last use
+    mutable std::mutex mutex_;
+    std::condition_variable built_;
+
+    static const std::string loggerCat_;
+};
+
+template<class T>
+std::shared_ptr<const T> SurfaceCache::Request<T>::get() const {
+    if (data_ || !cache_)
+        return data_;
+    return cache_->get<T>(key_, build_, memoryUsage_);
+}
+
+template<class T>
+std::shared_ptr<const T> SurfaceCache::find(const Key& key) {
+    return std::static_pointer_cast<const T>(getEntry(key, Builder()));
+}
+
+template<class T>
+std::shared_ptr<const T> SurfaceCache::get(const Key& key, const std::function<T*()>& build, const std::function<size_t(const T&)>& memoryUsage) {
+    std::shared_ptr<const void> data = getEntry(key, [&build, &memoryUsage](size_t& bytes) {
+        std::shared_ptr<const T> built(build());
+        bytes = built ? memoryUsage(*built) : 0;
+        return std::shared_ptr<const void>(built);
+    });
+    return std::static_pointer_cast<const T>(data);
+}
+
+} // namespace
+
+#endif // VRN_POITOOLS_SURFACECACHE_H
@@ -0,0 +1,129 @@
+#include "volumebrickreader.h"
+
+#include "tgt/logmanager.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace voreen {
+
+const std::string VolumeBrickReader::loggerCat_("voreen.poitools.VolumeBrickReader");
+
+VolumeBrickReader::Access::Access(const VolumeBrickReader& reader)
+    : reader_(reader)
+{
+    std::lock_guard<std::mutex> lock(reader_.accessMutex_);
+    granted_ = !reader_.detached_;
+    if (granted_)
+        ++reader_.numAccesses_;
+}
+
+VolumeBrickReader::Access::~Access() {
+    if (!granted_)
+        return;
+    std::lock_guard<std::mutex> lock(reader_.accessMutex_);
+    if (--reader_.numAccesses_ == 0)
+        reader_.released_.notify_all();
+}
+
+VolumeBrickReader::VolumeBrickReader(const VolumeBase* volume, int stride, bool requireRam)
+    : ram_(0)
+    , disk_(0)
+    , dims_(0)
+    , stride_(std::max(stride, 1))
+    , voxelToWorld_(tgt::mat4::identity)
+    , worldToVoxel_(tgt::mat4::identity)
+    , textureToWorld_(tgt::mat4::identity)
+    , worldToTexture_(tgt::mat4::identity)
+    , numAccesses_(0)
+    , detached_(false)
+{
+    if (!volume)
+        return;
+    dims_ = tgt::ivec3(volume->getDimensions());
+    voxelToWorld_ = volume->getVoxelToWorldMatrix();
+    worldToVoxel_ = volume->getWorldToVoxelMatrix();
+    textureToWorld_ = volume->getTextureToWorldMatrix();
+    worldToTexture_ = volume->getWorldToTextureMatrix();
+    if (volume->hasRepresentation<VolumeRAM>())
+        ram_ = volume->getRepresentation<VolumeRAM>();
+    else if (!requireRam && volume->hasRepresentation<VolumeDisk>())
+        disk_ = volume->getRepresentation<VolumeDisk>();
+    else
+        ram_ = volume->getRepresentation<VolumeRAM>();
+}
+
+void VolumeBrickReader::detach() {
+    std::unique_lock<std::mutex> lock(accessMutex_);
+    detached_ = true;
+    released_.wait(lock, [this]() { return numAccesses_ == 0; });
+}
+
+bool VolumeBrickReader::isDetached() const {
+    std::lock_guard<std::mutex> lock(accessMutex_);
+    return detached_;
+}
+
+poitools::IVec3 VolumeBrickReader::getGridDims() const {
+    return poitools::IVec3((dims_.x - 1) / stride_ + 1, (dims_.y - 1) / stride_ + 1, (dims_.z - 1) / stride_ + 1);
+}
+
+size_t VolumeBrickReader::getBytesPerSample() const {
+    // the voxels in between the samples are loaded as well
+    if (!disk_)
+        return 0;
+    return disk_->getBytesPerVoxel() * stride_ * stride_ * stride_;
+}
+
+poitools::BrickLayout VolumeBrickReader::getLayout(size_t memoryBudget) const {
+    poitools::SurfaceNets::Settings settings;
+    settings.memoryBudget = memoryBudget;
+    settings.readerBytesPerSample = getBytesPerSample();
+    return poitools::SurfaceNets::getLayout(getGridDims(), settings);
+}
+
+bool VolumeBrickReader::read(const poitools::IVec3& offset, const poitools::IVec3& size, float* values) const {
+    const Access access(*this);
+    if (!access)
+        return false;
+    const tgt::svec3 first(static_cast<size_t>(offset.x) * stride_, static_cast<size_t>(offset.y) * stride_,
+                           static_cast<size_t>(offset.z) * stride_);
+    if (ram_) {
+        for (int z = 0; z < size.z; ++z)
+            for (int y = 0; y < size.y; ++y)
+                for (int x = 0; x < size.x; ++x)
+                    *values++ = ram_->getVoxelNormalized(first.x + static_cast<size_t>(x) * stride_,
+                        first.y + static_cast<size_t>(y) * stride_, first.z + static_cast<size_t>(z) * stride_);
+        return true;
+    }
+    if (!disk_)
+        return false;
+
+    const tgt::svec3 extent(static_cast<size_t>(size.x - 1) * stride_ + 1, static_cast<size_t>(size.y - 1) * stride_ + 1,
+                            static_cast<size_t>(size.z - 1) * stride_ + 1);
+    std::unique_ptr<VolumeRAM> brick;
+    try {
+        std::lock_guard<std::mutex> lock(diskMutex_);
+        brick.reset(disk_->loadBrick(first, extent));
+    }
+    catch (tgt::Exception& e) {
+        LERROR("Failed to load brick at " << first << ": " << e.what());
+        return false;
+    }
+    if (!brick)
+        return false;
+    for (int z = 0; z < size.z; ++z)
+        for (int y = 0; y < size.y; ++y)
+            for (int x = 0; x < size.x; ++x)
+                *values++ = brick->getVoxelNormalized(static_cast<size_t>(x) * stride_, static_cast<size_t>(y) * stride_,
+                                                      static_cast<size_t>(z) * stride_);
+    return true;
+}
+
+poitools::BrickReader VolumeBrickReader::getReader() const {
+    return [this](const poitools::IVec3& offset, const poitools::IVec3& size, float* values) {
+        return read(offset, size, values);
+    };
+}
+
+} // namespace
@@ -0,0 +1,116 @@
+#ifndef VRN_POITOOLS_VOLUMEBRICKREADER_H
+#define VRN_POITOOLS_VOLUMEBRICKREADER_H
+
+#include "../core/surfacenets.h"
+
+#include "voreen/core/datastructures/volume/volumebase.h"
+#include "voreen/core/datastructures/volume/volumedisk.h"
+#include "voreen/core/datastructures/volume/volumeram.h"
+
+#include "tgt/matrix.h"
+#include "tgt/vector.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+namespace voreen {
+
+/**
+ * Reads bricks of the subsampled voxel grid of a volume for
+ * poitools::SurfaceNets, as normalized intensities.
+ *
+ * A volume that is in memory is read from its RAM representation. A volume
+ * that is only on disk, e.g. a micro-CT scan larger than the memory, is read
+ * brick by brick from its disk representation, so it is never loaded as a
+ * whole. Other volumes are converted to RAM first.
+ *
+ * The representation and the matrices are looked up in the constructor, on
+ * the thread owning the volume, so the reader can be handed to a worker that
+ * never touches the volume itself. The SurfaceCache detaches the readers it
+ * has handed out (see SurfaceCache::pinVolume()) when their volume changes or
+ * is deleted, later reads fail then.
+ */
+class VolumeBrickReader {
+public:
+    /**
+     * Keeps the data readable while it exists, evaluates to false if the
+     * reader has been detached. Code sampling getRam() directly holds one.
+     */
+    class Access {
+    public:
+        explicit Access(const VolumeBrickReader& reader);
+        ~Access();
+
+        Access(const Access&) = delete;
+        Access& operator=(const Access&) = delete;
+
+        explicit operator bool() const { return granted_; }
+
+    private:
+        const VolumeBrickReader& reader_;
+        bool granted_;
+    };
+
+    /**
+     * @param stride only every stride-th voxel is read, 1 means full resolution
+     * @param requireRam converts a volume that is only on disk to RAM, for getRam()
+     */
+    VolumeBrickReader(const VolumeBase* volume, int stride, bool requireRam = false);
+
+    bool isValid() const { return ram_ || disk_; }
+
+    /// RAM representation, null if the volume is read from disk, only to be sampled under an Access.
+    const VolumeRAM* getRam() const { return ram_; }
+
+    tgt::ivec3 getDimensions() const { return dims_; }
+    int getStride() const { return stride_; }
+    const tgt::mat4& getVoxelToWorldMatrix() const { return voxelToWorld_; }
+    const tgt::mat4& getWorldToVoxelMatrix() const { return worldToVoxel_; }
+    const tgt::mat4& getTextureToWorldMatrix() const { return textureToWorld_; }
+    const tgt::mat4& getWorldToTextureMatrix() const { return worldToTexture_; }
+
+    /// Waits for the reads in progress, later ones fail. Called when the volume is about to change or go away.
+    void detach();
+    bool isDetached() const;
+
+    /// True if the bricks are loaded from disk.
+    bool isOutOfCore() const { return disk_ != 0; }
+
+    /// Samples of the subsampled grid, (dims - 1) / stride + 1.
+    poitools::IVec3 getGridDims() const;
+
+    /// Memory read() needs per grid sample besides the values, see poitools::SurfaceNets::Settings.
+    size_t getBytesPerSample() const;
+
+    /// Bricks of the grid for reading at most memoryBudget bytes at a time, see poitools::SurfaceNets::getLayout().
+    poitools::BrickLayout getLayout(size_t memoryBudget) const;
+
+    /// See poitools::BrickReader, may be called concurrently.
+    bool read(const poitools::IVec3& offset, const poitools::IVec3& size, float* values) const;
+
+    /// read() bound to this, which must outlive it.
+    poitools::BrickReader getReader() const;
+
+private:
+    const VolumeRAM* ram_;
+    const VolumeDisk* disk_;
+    tgt::ivec3 dims_;
+    int stride_;
+    tgt::mat4 voxelToWorld_;
+    tgt::mat4 worldToVoxel_;
+    tgt::mat4 textureToWorld_;
+    tgt::mat4 worldToTexture_;
+    mutable std::mutex diskMutex_;     ///< disk representations need not be thread-safe
+
+    mutable std::mutex accessMutex_;
+    mutable std::condition_variable released_;
+    mutable int numAccesses_;          ///< Access objects in existence
+    bool detached_;
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_VOLUMEBRICKREADER_H
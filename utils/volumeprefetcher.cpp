@@ -0,0 +1,127 @@
+#include "volumeprefetcher.h"
+
+#include "voreen/core/datastructures/volume/volumelist.h"
+#include "voreen/core/datastructures/volume/volumeram.h"
+#include "voreen/core/io/volumeserializer.h"
+#include "voreen/core/io/volumeserializerpopulator.h"
+
+#include "tgt/logmanager.h"
+
+namespace voreen {
+
+const std::string VolumePrefetcher::loggerCat_("voreen.poitools.VolumePrefetcher");
+
+VolumePrefetcher::VolumePrefetcher() {
+}
+
+VolumePrefetcher::~VolumePrefetcher() {
+    clear();
+    reap(true);
+}
+
+void VolumePrefetcher::prefetch(const std::string& path) {
+    if (pending_.load && path_ == path)
+        return;
+    clear();
+    reap(false);
+    path_ = path;
+    pending_.load.reset(new Load());
+    pending_.thread = std::thread(&VolumePrefetcher::run, pending_.load, path);
+}
+
+VolumeBase* VolumePrefetcher::take(const std::string& path) {
+    if (pending_.load && path_ == path) {
+        std::shared_ptr<Load> load = pending_.load;
+        {
+            std::unique_lock<std::mutex> lock(load->mutex);
+            load->finished.wait(lock, [&load]() { return load->done; });
+        }
+        pending_.thread.join();
+        pending_.load.reset();
+        path_.clear();
+        return load->volume;
+    }
+    clear();
+    return load(path);
+}
+
+void VolumePrefetcher::clear() {
+    path_.clear();
+    if (!pending_.load)
+        return;
+
+    // a finished volume is freed here, an unfinished one by its thread
+    VolumeBase* volume = 0;
+    {
+        std::lock_guard<std::mutex> lock(pending_.load->mutex);
+        pending_.load->cancelled = true;
+        std::swap(volume, pending_.load->volume);
+    }
+    delete volume;
+    dropped_.push_back(std::move(pending_));
+    pending_ = Task();
+}
+
+void VolumePrefetcher::run(std::shared_ptr<Load> load, std::string path) {
+    VolumeBase* volume = VolumePrefetcher::load(path, &load->cancelled);
+    std::lock_guard<std::mutex> lock(load->mutex);
+    if (load->cancelled) {
+        delete volume;
+        volume = 0;
+    }
+    load->volume = volume;
+    load->done = true;
+    load->finished.notify_all();
+}
+
+void VolumePrefetcher::reap(bool wait) {
+    for (size_t i = 0; i < dropped_.size();) {
+        bool done = wait;
+        if (!done) {
+            std::lock_guard<std::mutex> lock(dropped_[i].load->mutex);
+            done = dropped_[i].load->done;
+        }
+        if (done) {
+            dropped_[i].thread.join();
+            dropped_.erase(dropped_.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+VolumeBase* VolumePrefetcher::load(const std::string& path, const std::atomic<bool>* cancelled) {
+    try {
+        VolumeSerializerPopulator populator;
+        VolumeList* list = populator.getVolumeSerializer()->read(path);
+        if (!list)
+            return 0;
+
+        VolumeBase* volume = list->empty() ? 0 : list->at(0);
+        for (size_t i = 1; i < list->size(); ++i)
+            delete list->at(i);
+        delete list;
+
+        // a dropped prefetch does not decode
+        if (volume && cancelled && *cancelled) {
+            delete volume;
+            return 0;
+        }
+
+        // decode on the loading thread as well
+        if (volume)
+            volume->getRepresentation<VolumeRAM>();
+        return volume;
+    }
+    catch (tgt::Exception& e) {
+        LERROR("Failed to load " << path << ": " << e.what());
+        return 0;
+    }
+    catch (std::exception& e) {
+        // e.g. out of memory, which must not escape the loading thread
+        LERROR("Failed to load " << path << ": " << e.what());
+        return 0;
+    }
+}
+
+} // namespace
@@ -0,0 +1,82 @@
+#ifndef VRN_POITOOLS_VOLUMEPREFETCHER_H
+#define VRN_POITOOLS_VOLUMEPREFETCHER_H
+
+#include "voreen/core/datastructures/volume/volumebase.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voreen {
+
+/**
+ * Loads the next of a sequence of volumes on a background thread, including
+ * its RAM representation, so it is ready once the current one is done.
+ *
+ * One volume is prefetched at a time. Prefetching another path drops the
+ * pending one without waiting for it: its thread skips the decoding, frees
+ * the volume and is joined once it has finished. Only the destructor waits.
+ */
+class VolumePrefetcher {
+public:
+    VolumePrefetcher();
+    ~VolumePrefetcher();
+
+    /// Starts loading path in the background, unless it is already being loaded.
+    void prefetch(const std::string& path);
+
+    /**
+     * Returns the volume stored at path, waits for its prefetch or loads it
+     * right away if a different path has been prefetched.
+     *
+     * @return the volume, owned by the caller, or null if it cannot be loaded
+     */
+    VolumeBase* take(const std::string& path);
+
+    /// Drops the pending volume, never blocks.
+    void clear();
+
+    /**
+     * Loads the first volume stored at path and creates its RAM representation.
+     *
+     * @param cancelled if set once the file has been read, the volume is freed without being decoded
+     * @return the volume or null on failure or cancellation
+     */
+    static VolumeBase* load(const std::string& path, const std::atomic<bool>* cancelled = 0);
+
+private:
+    /// State shared with the loading thread.
+    struct Load {
+        Load() : cancelled(false), done(false), volume(0) {}
+
+        std::atomic<bool> cancelled;
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done;
+        VolumeBase* volume;             ///< result, freed by the loading thread if it has been cancelled
+    };
+
+    struct Task {
+        std::shared_ptr<Load> load;
+        std::thread thread;
+    };
+
+    static void run(std::shared_ptr<Load> load, std::string path);
+
+    /// Joins the threads of dropped loads that have finished, all of them if wait is set.
+    void reap(bool wait);
+
+    std::string path_;                  ///< of the pending load
+    Task pending_;
+    std::vector<Task> dropped_;         ///< cancelled loads whose threads have not been joined yet
+
+    static const std::string loggerCat_;
+};
+
+} // namespace
+
+#endif // VRN_POITOOLS_VOLUMEPREFETCHER_H
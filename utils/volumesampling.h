@@ -0,0 +1,38 @@
+#ifndef VRN_POITOOLS_VOLUMESAMPLING_H
+#define VRN_POITOOLS_VOLUMESAMPLING_H
+
+#include "voreen/core/datastructures/volume/volumeram.h"
+
+#include "tgt/vector.h"
+
+namespace voreen {
+
+/**
+ * Trilinear normalized intensity of ram at pos (texture coordinates), like a
+ * GL texture lookup: voxel centers lie at (i + 0.5) / dims, positions beyond
+ * the outer voxel centers are clamped to them.
+ */
+inline float sampleTrilinear(const VolumeRAM* ram, const tgt::ivec3& dims, const tgt::vec3& pos) {
+    tgt::vec3 voxel = tgt::clamp(pos * tgt::vec3(dims) - 0.5f, tgt::vec3(0.0f), tgt::vec3(dims - 1));
+    tgt::ivec3 lower(static_cast<int>(voxel.x), static_cast<int>(voxel.y), static_cast<int>(voxel.z));
+    tgt::ivec3 upper = tgt::min(lower + 1, dims - 1);
+    tgt::vec3 t = voxel - tgt::vec3(lower);
+
+    float c[8];
+    for (int i = 0; i < 8; ++i) {
+        c[i] = ram->getVoxelNormalized(static_cast<size_t>((i & 1) ? upper.x : lower.x),
+                                       static_cast<size_t>((i & 2) ? upper.y : lower.y),
+                                       static_cast<size_t>((i & 4) ? upper.z : lower.z));
+    }
+    float c00 = c[0] + t.x * (c[1] - c[0]);
+    float c10 = c[2] + t.x * (c[3] - c[2]);
+    float c01 = c[4] + t.x * (c[5] - c[4]);
+    float c11 = c[6] + t.x * (c[7] - c[6]);
+    float c0 = c00 + t.y * (c10 - c00);
+    float c1 = c01 + t.y * (c11 - c01);
+    return c0 + t.z * (c1 - c0);
+}
+
+} // namespace
+
+#endif // VRN_POITOOLS_VOLUMESAMPLING_H